@@ -0,0 +1,562 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <unistd.h>
+
+#include <cxxopts.hpp>
+
+namespace Afina {
+namespace Bench {
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+std::vector<std::unique_ptr<Benchmark>> &Registry() {
+    static std::vector<std::unique_ptr<Benchmark>> benchmarks;
+    return benchmarks;
+}
+
+double ThreadCPUTime() {
+    struct timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+class FunctionFixture : public Fixture {
+public:
+    explicit FunctionFixture(const std::function<void(State &)> &function) : _function(function) {}
+    void Run(State &state) override { _function(state); }
+
+private:
+    std::function<void(State &)> _function;
+};
+
+} // namespace
+
+/**
+ * One measurement: given number of threads make the same number of iterations each. Time is taken from the
+ * moment all threads are ready till the last one is done
+ */
+class Run {
+public:
+    Run(const std::vector<int64_t> &args_p, size_t threads_p)
+        : args(args_p), threads(threads_p), arrived(0), go(false), cpu_time(0) {}
+
+    const std::vector<int64_t> &args;
+    const size_t threads;
+
+    std::atomic<size_t> arrived;
+    std::atomic<bool> go;
+    Clock::time_point start;
+
+    std::mutex lock;
+    Clock::time_point end;
+    double cpu_time;
+    std::string label;
+};
+
+State::State(Run &run, size_t thread_index, uint64_t iterations)
+    : _run(run), _thread_index(thread_index), _iterations(iterations), _left(iterations), _items(0),
+      _items_set(false), _started(false), _finished(false), _cpu_start(0) {}
+
+int64_t State::Range(size_t index) const {
+    if (index >= _run.args.size()) {
+        throw std::out_of_range("Benchmark has no argument " + std::to_string(index));
+    }
+    return _run.args[index];
+}
+
+size_t State::Threads() const { return _run.threads; }
+
+void State::SetLabel(const std::string &label) {
+    std::lock_guard<std::mutex> lock(_run.lock);
+    _run.label = label;
+}
+
+void State::_Start() {
+    _started = true;
+    if (_run.arrived.fetch_add(1) + 1 == _run.threads) {
+        _run.start = Clock::now();
+        _run.go.store(true, std::memory_order_release);
+    } else {
+        while (!_run.go.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+    _cpu_start = ThreadCPUTime();
+}
+
+void State::_Finish() {
+    if (_finished) {
+        return;
+    }
+    _finished = true;
+    Clock::time_point end = Clock::now();
+    double cpu_time = ThreadCPUTime() - _cpu_start;
+
+    std::lock_guard<std::mutex> lock(_run.lock);
+    _run.end = std::max(_run.end, end);
+    _run.cpu_time += cpu_time;
+}
+
+Benchmark::Benchmark(const std::string &name, Factory factory) : _name(name), _factory(factory), _min_time(0) {}
+
+std::string Benchmark::_RunName(const std::vector<int64_t> &args, size_t threads) const {
+    std::string name = _name;
+    for (int64_t arg : args) {
+        name += "/" + std::to_string(arg);
+    }
+    if (!_threads.empty()) {
+        name += "/threads:" + std::to_string(threads);
+    }
+    return name;
+}
+
+Benchmark *Benchmark::Arg(int64_t arg) { return Args({arg}); }
+
+Benchmark *Benchmark::Args(const std::vector<int64_t> &args) {
+    _args.push_back(args);
+    return this;
+}
+
+Benchmark *Benchmark::Threads(size_t threads) {
+    _threads.push_back(threads);
+    return this;
+}
+
+Benchmark *Benchmark::ThreadRange(size_t min, size_t max) {
+    for (size_t threads = min; threads <= max; threads *= 2) {
+        _threads.push_back(threads);
+    }
+    return this;
+}
+
+Benchmark *Benchmark::MinTime(double seconds) {
+    _min_time = seconds;
+    return this;
+}
+
+Benchmark *RegisterBenchmark(const std::string &name, std::function<void(State &)> function) {
+    return RegisterFixture(name, [function]() -> Fixture * { return new FunctionFixture(function); });
+}
+
+Benchmark *RegisterFixture(const std::string &name, Benchmark::Factory factory) {
+    Registry().emplace_back(new Benchmark(name, factory));
+    return Registry().back().get();
+}
+
+/**
+ * # Result of a measurement
+ * iterations - made by all threads together
+ * real_time - wall time of one iteration as seen by a thread, ns
+ * cpu_time - CPU time of the threads per iteration, ns
+ */
+struct Result {
+    std::string name;
+    std::string run_name;
+    std::string aggregate_name;
+    size_t threads;
+    size_t repetitions;
+    size_t repetition_index;
+    uint64_t iterations;
+    double real_time;
+    double cpu_time;
+    double items_per_second;
+    std::string label;
+};
+
+/**
+ * # Runs benchmarks and reports their results
+ * Number of iterations is chosen like Google Benchmark does: it grows until a measurement takes at least
+ * min_time, then the last measurement is reported. Runs made while looking for it warm caches and CPU frequency
+ * up. With several repetitions each of them is reported along with mean, median and standard deviation
+ */
+class Runner {
+public:
+    Runner(double min_time, size_t repetitions) : _min_time(min_time), _repetitions(repetitions) {}
+
+    std::vector<Result> RunBenchmark(Benchmark &benchmark, const std::vector<int64_t> &args, size_t threads) {
+        std::string run_name = benchmark._RunName(args, threads);
+        std::unique_ptr<Fixture> fixture(benchmark._factory());
+        fixture->SetUp(args, threads);
+
+        double min_time = (benchmark._min_time != 0) ? benchmark._min_time : _min_time;
+        uint64_t iterations = 1;
+        Result result = _Measure(*fixture, args, threads, iterations);
+        while (result.real_time * iterations * 1e-9 < min_time && iterations < _max_iterations) {
+            double elapsed = result.real_time * iterations * 1e-9;
+            double multiplier = (elapsed > min_time / 10) ? min_time * 1.4 / elapsed : 10;
+            iterations = std::max<uint64_t>(iterations + 1, std::min(multiplier, 10.0) * iterations);
+            iterations = std::min(iterations, _max_iterations);
+            result = _Measure(*fixture, args, threads, iterations);
+        }
+
+        std::vector<Result> results;
+        results.push_back(result);
+        for (size_t i = 1; i < _repetitions; i++) {
+            results.push_back(_Measure(*fixture, args, threads, iterations));
+        }
+        fixture->TearDown();
+
+        for (size_t i = 0; i < results.size(); i++) {
+            results[i].name = results[i].run_name = run_name;
+            results[i].repetitions = _repetitions;
+            results[i].repetition_index = i;
+        }
+        if (_repetitions > 1) {
+            _Aggregate(results);
+        }
+        return results;
+    }
+
+private:
+    static const uint64_t _max_iterations = 1000000000;
+
+    Result _Measure(Fixture &fixture, const std::vector<int64_t> &args, size_t threads, uint64_t iterations) {
+        Run run(args, threads);
+        std::vector<std::unique_ptr<State>> states;
+        for (size_t i = 0; i < threads; i++) {
+            states.emplace_back(new State(run, i, iterations));
+        }
+
+        // The calling thread is the first benchmark thread
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < threads; i++) {
+            State *state = states[i].get();
+            workers.emplace_back([&fixture, state]() { fixture.Run(*state); });
+        }
+        fixture.Run(*states[0]);
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        uint64_t items = 0;
+        for (auto &state : states) {
+            if (!state->_finished) {
+                throw std::logic_error("Benchmark body must loop until KeepRunning() returns false");
+            }
+            items += state->_items_set ? state->_items : iterations;
+        }
+
+        double elapsed = std::chrono::duration<double>(run.end - run.start).count();
+        Result result;
+        result.threads = threads;
+        result.iterations = iterations * threads;
+        result.real_time = elapsed * 1e9 / iterations;
+        result.cpu_time = run.cpu_time * 1e9 / result.iterations;
+        result.items_per_second = (elapsed > 0) ? items / elapsed : 0;
+        result.label = run.label;
+        return result;
+    }
+
+    static void _Aggregate(std::vector<Result> &results) {
+        std::vector<Result> repetitions(results);
+        auto aggregate = [&results, &repetitions](const std::string &name,
+                                                  std::function<double(std::vector<double>)> function) {
+            Result result = repetitions.front();
+            result.name = result.run_name + "_" + name;
+            result.aggregate_name = name;
+            std::vector<double> real_time, cpu_time, items;
+            for (const Result &r : repetitions) {
+                real_time.push_back(r.real_time);
+                cpu_time.push_back(r.cpu_time);
+                items.push_back(r.items_per_second);
+            }
+            result.real_time = function(real_time);
+            result.cpu_time = function(cpu_time);
+            result.items_per_second = function(items);
+            results.push_back(result);
+        };
+
+        auto mean = [](std::vector<double> values) {
+            double sum = 0;
+            for (double value : values) {
+                sum += value;
+            }
+            return sum / values.size();
+        };
+        auto median = [](std::vector<double> values) {
+            std::sort(values.begin(), values.end());
+            size_t middle = values.size() / 2;
+            return (values.size() % 2 != 0) ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+        };
+        auto stddev = [mean](std::vector<double> values) {
+            double average = mean(values), sum = 0;
+            for (double value : values) {
+                sum += (value - average) * (value - average);
+            }
+            return std::sqrt(sum / (values.size() - 1));
+        };
+
+        aggregate("mean", mean);
+        aggregate("median", median);
+        aggregate("stddev", stddev);
+    }
+
+    double _min_time;
+    size_t _repetitions;
+};
+
+const uint64_t Runner::_max_iterations;
+
+namespace {
+
+std::string Escape(const std::string &value) {
+    std::string result;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result;
+}
+
+class Reporter {
+public:
+    virtual ~Reporter() {}
+    virtual void Header() {}
+    virtual void Report(const Result &result) = 0;
+    virtual void Footer() {}
+};
+
+// Human readable table
+class ConsoleReporter : public Reporter {
+public:
+    explicit ConsoleReporter(std::ostream &out) : _out(out) {}
+
+    void Header() override {
+        _out << std::left << std::setw(_name_width) << "benchmark" << std::right << std::setw(14) << "real_ns"
+             << std::setw(14) << "cpu_ns" << std::setw(14) << "iterations" << std::setw(16) << "items/sec" << std::endl;
+    }
+
+    void Report(const Result &result) override {
+        _out << std::left << std::setw(_name_width) << result.name << std::right << std::fixed << std::setprecision(1)
+             << std::setw(14) << result.real_time << std::setw(14) << result.cpu_time << std::setw(14);
+        if (result.aggregate_name.empty()) {
+            _out << result.iterations;
+        } else {
+            _out << "";
+        }
+        _out << std::setprecision(0) << std::setw(16) << result.items_per_second << " " << result.label << std::endl;
+    }
+
+private:
+    static const int _name_width = 56;
+    std::ostream &_out;
+};
+
+// Same layout as benchmark_format=json of Google Benchmark, so its tools/compare.py could diff two runs
+class JSONReporter : public Reporter {
+public:
+    JSONReporter(std::ostream &out, const std::string &executable)
+        : _out(out), _executable(executable), _first(true) {}
+
+    void Header() override {
+        char host[256] = {0};
+        gethostname(host, sizeof(host) - 1);
+        std::time_t now = std::time(nullptr);
+        char date[64];
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+        _out << "{\n  \"context\": {\n";
+        _out << "    \"date\": \"" << date << "\",\n";
+        _out << "    \"host_name\": \"" << Escape(host) << "\",\n";
+        _out << "    \"executable\": \"" << Escape(_executable) << "\",\n";
+        _out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef NDEBUG
+        _out << "    \"library_build_type\": \"release\"\n";
+#else
+        _out << "    \"library_build_type\": \"debug\"\n";
+#endif
+        _out << "  },\n  \"benchmarks\": [";
+    }
+
+    void Report(const Result &result) override {
+        _out << (_first ? "\n" : ",\n") << "    {\n";
+        _first = false;
+        _out << "      \"name\": \"" << Escape(result.name) << "\",\n";
+        _out << "      \"run_name\": \"" << Escape(result.run_name) << "\",\n";
+        if (result.aggregate_name.empty()) {
+            _out << "      \"run_type\": \"iteration\",\n";
+        } else {
+            _out << "      \"run_type\": \"aggregate\",\n";
+            _out << "      \"aggregate_name\": \"" << result.aggregate_name << "\",\n";
+        }
+        _out << "      \"repetitions\": " << result.repetitions << ",\n";
+        _out << "      \"repetition_index\": " << result.repetition_index << ",\n";
+        _out << "      \"threads\": " << result.threads << ",\n";
+        _out << "      \"iterations\": " << result.iterations << ",\n";
+        _out << std::setprecision(10);
+        _out << "      \"real_time\": " << result.real_time << ",\n";
+        _out << "      \"cpu_time\": " << result.cpu_time << ",\n";
+        _out << "      \"time_unit\": \"ns\",\n";
+        _out << "      \"items_per_second\": " << result.items_per_second;
+        if (!result.label.empty()) {
+            _out << ",\n      \"label\": \"" << Escape(result.label) << "\"";
+        }
+        _out << "\n    }";
+    }
+
+    void Footer() override { _out << "\n  ]\n}" << std::endl; }
+
+private:
+    std::ostream &_out;
+    std::string _executable;
+    bool _first;
+};
+
+// Columns of benchmark_format=csv of Google Benchmark
+class CSVReporter : public Reporter {
+public:
+    explicit CSVReporter(std::ostream &out) : _out(out) {}
+
+    void Header() override {
+        _out << "name,iterations,real_time,cpu_time,time_unit,bytes_per_second,items_per_second,label,"
+                "error_occurred,error_message"
+             << std::endl;
+    }
+
+    void Report(const Result &result) override {
+        _out << "\"" << Escape(result.name) << "\"," << result.iterations << "," << std::setprecision(10)
+             << result.real_time << "," << result.cpu_time << ",ns,," << result.items_per_second << ",\""
+             << Escape(result.label) << "\",," << std::endl;
+    }
+
+private:
+    std::ostream &_out;
+};
+
+Reporter *MakeReporter(const std::string &format, std::ostream &out, const std::string &executable) {
+    if (format == "console") {
+        return new ConsoleReporter(out);
+    } else if (format == "json") {
+        return new JSONReporter(out, executable);
+    } else if (format == "csv") {
+        return new CSVReporter(out);
+    }
+    throw std::invalid_argument("Unknown format: " + format);
+}
+
+// Writes one stream to the buffer of another while alive
+class StreamRedirect {
+public:
+    StreamRedirect(std::ostream &from, std::ostream &to) : _from(from), _buffer(from.rdbuf(to.rdbuf())) {}
+    ~StreamRedirect() { _from.rdbuf(_buffer); }
+
+    StreamRedirect(const StreamRedirect &) = delete;
+    StreamRedirect &operator=(const StreamRedirect &) = delete;
+
+private:
+    std::ostream &_from;
+    std::streambuf *_buffer;
+};
+
+} // namespace
+
+int RunBenchmarks(int argc, char **argv) {
+    cxxopts::Options options(argv[0], "Benchmarks of thread pools, synchronization and storages");
+    options.add_options()("f,filter", "Regular expression benchmark names should match",
+                          cxxopts::value<std::string>()->default_value(".*"));
+    options.add_options()("format", "Format of stdout: console, json, csv",
+                          cxxopts::value<std::string>()->default_value("console"));
+    options.add_options()("o,out", "File to write results to as well", cxxopts::value<std::string>());
+    options.add_options()("out-format", "Format of --out file: console, json, csv",
+                          cxxopts::value<std::string>()->default_value("json"));
+    options.add_options()("min-time", "Seconds each measurement should take at least",
+                          cxxopts::value<double>()->default_value("0.5"));
+    options.add_options()("r,repetitions", "Measurements of each benchmark, aggregates are reported if above 1",
+                          cxxopts::value<size_t>()->default_value("1"));
+    options.add_options()("l,list", "Print names of benchmarks and exit");
+    options.add_options()("h,help", "Print usage info");
+
+    try {
+        options.parse(argc, argv);
+        if (options.count("help") > 0) {
+            std::cerr << options.help() << std::endl;
+            return 0;
+        }
+
+        // Library code prints diagnostics to std::cout (see afina/core/Debug.h). They are sent to stderr, so
+        // stdout holds nothing but results and could be parsed as json or csv
+        std::ostream results(std::cout.rdbuf());
+        StreamRedirect diagnostics(std::cout, std::cerr);
+
+        std::regex filter(options["filter"].as<std::string>());
+        size_t repetitions = std::max<size_t>(1, options["repetitions"].as<size_t>());
+        Runner runner(options["min-time"].as<double>(), repetitions);
+
+        std::vector<std::unique_ptr<Reporter>> reporters;
+        reporters.emplace_back(MakeReporter(options["format"].as<std::string>(), results, argv[0]));
+        std::ofstream out;
+        if (options.count("out") > 0) {
+            out.open(options["out"].as<std::string>());
+            if (!out) {
+                throw std::runtime_error("Cannot open " + options["out"].as<std::string>());
+            }
+            reporters.emplace_back(MakeReporter(options["out-format"].as<std::string>(), out, argv[0]));
+        }
+
+        if (options.count("list") == 0) {
+            for (auto &reporter : reporters) {
+                reporter->Header();
+            }
+        }
+        for (auto &benchmark : Registry()) {
+            std::vector<std::vector<int64_t>> args = benchmark->_args;
+            if (args.empty()) {
+                args.emplace_back();
+            }
+            std::vector<size_t> threads = benchmark->_threads;
+            if (threads.empty()) {
+                threads.push_back(1);
+            }
+
+            for (const auto &arg : args) {
+                for (size_t thread_count : threads) {
+                    std::string name = benchmark->_RunName(arg, thread_count);
+                    if (!std::regex_search(name, filter)) {
+                        continue;
+                    }
+                    if (options.count("list") > 0) {
+                        results << name << std::endl;
+                        continue;
+                    }
+
+                    for (const Result &result : runner.RunBenchmark(*benchmark, arg, thread_count)) {
+                        for (auto &reporter : reporters) {
+                            reporter->Report(result);
+                        }
+                    }
+                }
+            }
+        }
+        if (options.count("list") == 0) {
+            for (auto &reporter : reporters) {
+                reporter->Footer();
+            }
+        }
+    } catch (std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+} // namespace Bench
+} // namespace Afina
+
+int main(int argc, char **argv) { return Afina::Bench::RunBenchmarks(argc, argv); }
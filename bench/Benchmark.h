@@ -0,0 +1,149 @@
+#ifndef AFINA_BENCH_BENCHMARK_H
+#define AFINA_BENCH_BENCHMARK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Afina {
+namespace Bench {
+
+class Run;
+
+/**
+ * # State of one benchmark thread
+ * Benchmark body loops while KeepRunning() returns true. The first call waits for the other threads of the run,
+ * so whatever body does before the loop (per thread setup) isn't measured
+ */
+class State {
+public:
+    State(Run &run, size_t thread_index, uint64_t iterations);
+
+    bool KeepRunning() {
+        if (_left != 0) {
+            if (!_started) {
+                _Start();
+            }
+            _left--;
+            return true;
+        }
+        _Finish();
+        return false;
+    }
+
+    // Arguments the benchmark is registered with
+    int64_t Range(size_t index) const;
+
+    size_t Threads() const;
+    size_t ThreadIndex() const { return _thread_index; }
+    uint64_t Iterations() const { return _iterations; }
+
+    // Number of items (operations, bytes) this thread has processed, items_per_second is reported from it.
+    // Iterations are counted if not set
+    void SetItemsProcessed(uint64_t items) {
+        _items = items;
+        _items_set = true;
+    }
+
+    // Free form note printed next to the result, the last one set by any thread wins
+    void SetLabel(const std::string &label);
+
+private:
+    friend class Runner;
+
+    void _Start();
+    void _Finish();
+
+    Run &_run;
+    size_t _thread_index;
+    uint64_t _iterations;
+    uint64_t _left;
+    uint64_t _items;
+    bool _items_set;
+    bool _started;
+    bool _finished;
+    double _cpu_start;
+};
+
+/**
+ * # Benchmark with state shared by its threads
+ * Object is created for each set of arguments and number of threads. SetUp is called once before the first
+ * measurement from the main thread, then Run is called concurrently from every thread of each measurement
+ */
+class Fixture {
+public:
+    virtual ~Fixture() {}
+
+    virtual void SetUp(const std::vector<int64_t> & /* args */, size_t /* threads */) {}
+    virtual void TearDown() {}
+
+    virtual void Run(State &state) = 0;
+};
+
+/**
+ * # Registered benchmark
+ * Setters return this, so registration reads like in Google Benchmark:
+ *     RegisterBenchmark("name", function)->Arg(10)->ThreadRange(1, 64);
+ */
+class Benchmark {
+public:
+    typedef std::function<Fixture *()> Factory;
+
+    Benchmark(const std::string &name, Factory factory);
+
+    // Adds a set of arguments, each set is run separately
+    Benchmark *Arg(int64_t arg);
+    Benchmark *Args(const std::vector<int64_t> &args);
+
+    // Adds number of threads to run with, ThreadRange adds powers of two from min to max
+    Benchmark *Threads(size_t threads);
+    Benchmark *ThreadRange(size_t min, size_t max);
+
+    // Overrides minimal time of a measurement given by --min-time
+    Benchmark *MinTime(double seconds);
+
+    const std::string &Name() const { return _name; }
+
+private:
+    friend class Runner;
+    friend int RunBenchmarks(int argc, char **argv);
+
+    // Name of the run with given arguments and number of threads, like "name/16/threads:4"
+    std::string _RunName(const std::vector<int64_t> &args, size_t threads) const;
+
+    std::string _name;
+    Factory _factory;
+    std::vector<std::vector<int64_t>> _args;
+    std::vector<size_t> _threads;
+    double _min_time;
+};
+
+// Registers benchmark made of a plain function, all its state is local to the thread
+Benchmark *RegisterBenchmark(const std::string &name, std::function<void(State &)> function);
+
+// Registers fixture benchmark
+template <typename F> Benchmark *RegisterFixture(const std::string &name) {
+    return RegisterFixture(name, []() -> Fixture * { return new F(); });
+}
+Benchmark *RegisterFixture(const std::string &name, Benchmark::Factory factory);
+
+// Runs benchmarks selected by the command line options, returns process exit code
+int RunBenchmarks(int argc, char **argv);
+
+// Keeps compiler from optimizing out the value computed by the benchmark
+template <typename T> inline void DoNotOptimize(const T &value) { asm volatile("" : : "r,m"(value) : "memory"); }
+
+// Makes benchmark files register their benchmarks when the program starts
+#define AFINA_BENCH_CONCAT_(a, b) a##b
+#define AFINA_BENCH_CONCAT(a, b) AFINA_BENCH_CONCAT_(a, b)
+#define AFINA_BENCHMARK(registration)                                                                                \
+    static ::Afina::Bench::Benchmark *AFINA_BENCH_CONCAT(_afina_benchmark_, __LINE__) = (registration)
+
+} // namespace Bench
+} // namespace Afina
+
+#endif // AFINA_BENCH_BENCHMARK_H
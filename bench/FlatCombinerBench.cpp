@@ -0,0 +1,149 @@
+#include <array>
+#include <deque>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <core/multithreading/FlatCombined.h>
+#include <core/multithreading/FlatCombiner.hpp>
+
+#include "Benchmark.h"
+#include "Zipfian.h"
+
+/**
+ * # Flat combiner against mutex
+ * Threads update a shared std::map: each operation adds to the value of a random key. Critical section is short
+ * and the structure is touched by a single thread at a time in both cases, the difference is how the lock and
+ * the structure move between caches. Argument is number of keys
+ *
+ * Queue benchmarks push a value and pop one back, as producers and consumers of a task queue do
+ */
+
+using namespace Afina;
+using namespace Afina::Bench;
+
+namespace {
+
+typedef std::map<uint32_t, uint64_t> Counters;
+
+void FillCounters(Counters &counters, size_t keys) {
+    for (size_t i = 0; i < keys; i++) {
+        counters[i] = 0;
+    }
+}
+
+class MutexFixture : public Fixture {
+public:
+    void SetUp(const std::vector<int64_t> &args, size_t /* threads */) override { FillCounters(_counters, args[0]); }
+
+    void Run(State &state) override {
+        Random random(state.ThreadIndex() + 1);
+        uint32_t keys = state.Range(0);
+        while (state.KeepRunning()) {
+            uint32_t key = random.Next() % keys;
+            std::lock_guard<std::mutex> lock(_lock);
+            _counters[key]++;
+        }
+    }
+
+private:
+    std::mutex _lock;
+    Counters _counters;
+};
+
+// Park selects waiting of threads which aren't combiners: spin then sleep on futex, or spin then yield
+template <bool Park> class FlatCombinerFixture : public Fixture {
+public:
+    struct Operation {
+        uint32_t key;
+
+        // Sorted shot walks the map in order
+        bool operator<(const Operation &other) const { return key < other.key; }
+    };
+
+    typedef Core::FlatCombiner<Operation> Combiner;
+
+    void SetUp(const std::vector<int64_t> &args, size_t /* threads */) override {
+        FillCounters(_counters, args[0]);
+        _combiner.reset(new Combiner(std::bind(&FlatCombinerFixture::_Combine, this, std::placeholders::_1), 100000,
+                                     true, typename Combiner::WaitPolicy(512, Park)));
+    }
+
+    void TearDown() override { _combiner.reset(); }
+
+    void Run(State &state) override {
+        Random random(state.ThreadIndex() + 1);
+        uint32_t keys = state.Range(0);
+        typename Combiner::OperationWrapperPtr slot = _combiner->GetThreadSlotOperation();
+        while (state.KeepRunning()) {
+            Operation operation = {uint32_t(random.Next() % keys)};
+            slot->SetOperation(operation);
+            _combiner->ApplyThreadSlot();
+        }
+        // Benchmark thread is going to exit, its slot is purged by the next combiner
+        _combiner->DetachThread();
+    }
+
+private:
+    void _Combine(typename Combiner::FlatCombinerShotArrayType &shot) {
+        for (typename Combiner::OperationWrapperPtr operation : shot) {
+            if (operation == nullptr) {
+                break;
+            }
+            _counters[operation->GetData().key]++;
+            operation->OnExecutionComplete(nullptr);
+        }
+    }
+
+    Counters _counters;
+    std::unique_ptr<Combiner> _combiner;
+};
+
+class MutexQueueFixture : public Fixture {
+public:
+    void Run(State &state) override {
+        uint64_t value = state.ThreadIndex(), sum = 0;
+        while (state.KeepRunning()) {
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _queue.push_back(value);
+            }
+            std::lock_guard<std::mutex> lock(_lock);
+            sum += _queue.front();
+            _queue.pop_front();
+        }
+        DoNotOptimize(sum);
+    }
+
+private:
+    std::mutex _lock;
+    std::deque<uint64_t> _queue;
+};
+
+class FlatCombinedQueueFixture : public Fixture {
+public:
+    void Run(State &state) override {
+        uint64_t value = state.ThreadIndex(), sum = 0, popped;
+        while (state.KeepRunning()) {
+            _queue.Push(value);
+            _queue.TryPop(popped); // each thread pushes before it pops, queue isn't empty
+            sum += popped;
+        }
+        DoNotOptimize(sum);
+    }
+
+private:
+    Core::FlatCombinedQueue<uint64_t> _queue;
+};
+
+AFINA_BENCHMARK(RegisterFixture<MutexFixture>("Mutex/MapIncrement")->Arg(1024)->ThreadRange(1, 64));
+AFINA_BENCHMARK(RegisterFixture<FlatCombinerFixture<true>>("FlatCombiner/MapIncrement")->Arg(1024)->ThreadRange(1, 64));
+AFINA_BENCHMARK(
+    RegisterFixture<FlatCombinerFixture<false>>("FlatCombinerYield/MapIncrement")->Arg(1024)->ThreadRange(1, 64));
+AFINA_BENCHMARK(RegisterFixture<MutexQueueFixture>("Mutex/Queue")->ThreadRange(1, 64));
+AFINA_BENCHMARK(RegisterFixture<FlatCombinedQueueFixture>("FlatCombined/Queue")->ThreadRange(1, 64));
+
+} // namespace
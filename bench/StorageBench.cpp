@@ -0,0 +1,88 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+#include <storage/MapBasedFCImpl.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+#include <storage/MapBasedShardedFCImpl.h>
+#include <storage/MapBasedSharedNothingImpl.h>
+
+#include "Benchmark.h"
+#include "Zipfian.h"
+
+/**
+ * # Storage benchmarks
+ * Storage is filled with the given number of keys, then threads get and set them. Keys are chosen by Zipfian
+ * distribution as YCSB does, hot keys are scattered over the key space. Arguments are percent of gets, number of
+ * keys and Zipfian theta multiplied by 100
+ */
+
+using namespace Afina;
+using namespace Afina::Bench;
+
+namespace {
+
+const size_t value_size = 100;
+
+template <typename S> class StorageFixture : public Fixture {
+public:
+    void SetUp(const std::vector<int64_t> &args, size_t /* threads */) override {
+        size_t keys = args[1];
+        _zipfian.reset(new Zipfian(keys, args[2] / 100.0));
+
+        // Rank is mapped to the key by a multiplicative hash, so hot keys aren't neighbors in the map
+        _keys.clear();
+        for (size_t i = 0; i < keys; i++) {
+            _keys.push_back("key" + std::to_string((i * 2654435761u) % keys));
+        }
+
+        _storage.reset(new S());
+        _storage->Start();
+        std::string value(value_size, 'v');
+        for (const std::string &key : _keys) {
+            _storage->Put(key, value);
+        }
+    }
+
+    void TearDown() override {
+        _storage->Stop();
+        _storage.reset();
+    }
+
+    void Run(State &state) override {
+        Random random(state.ThreadIndex() + 1);
+        uint64_t gets = state.Range(0);
+        std::string value(value_size, 's'), result;
+        while (state.KeepRunning()) {
+            const std::string &key = _keys[_zipfian->Next(random)];
+            if (random.Next() % 100 < gets) {
+                _storage->Get(key, result);
+            } else {
+                _storage->Set(key, value);
+            }
+        }
+        DoNotOptimize(result);
+    }
+
+private:
+    std::unique_ptr<Storage> _storage;
+    std::unique_ptr<Zipfian> _zipfian;
+    std::vector<std::string> _keys;
+};
+
+// Read mostly and update heavy mixes of YCSB workloads B and A, and uniform keys for comparison
+template <typename S> Benchmark *RegisterStorage(const std::string &name) {
+    return RegisterFixture<StorageFixture<S>>(name)
+        ->Args({95, 100000, 99})
+        ->Args({50, 100000, 99})
+        ->Args({95, 100000, 0})
+        ->ThreadRange(1, 64);
+}
+
+AFINA_BENCHMARK(RegisterStorage<Backend::MapBasedGlobalLockImpl>("Storage/MapBasedGlobalLock"));
+AFINA_BENCHMARK(RegisterStorage<Backend::MapBasedFCImpl>("Storage/MapBasedFC"));
+AFINA_BENCHMARK(RegisterStorage<Backend::MapBasedShardedFCImpl>("Storage/MapBasedShardedFC"));
+AFINA_BENCHMARK(RegisterStorage<Backend::MapBasedSharedNothingImpl>("Storage/MapBasedSharedNothing"));
+
+} // namespace
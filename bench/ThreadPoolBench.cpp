@@ -0,0 +1,111 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <core/multithreading/ThreadPool.h>
+#include <core/multithreading/WorkStealingThreadPool.h>
+
+#include "Benchmark.h"
+
+/**
+ * # Thread pool benchmarks
+ * Submitting threads push batches of empty tasks and wait until the batch is done, so results include the way
+ * of a task through the queue, wake up of a worker and the completion back. Arguments are number of pool threads
+ * and tasks in a batch, benchmark threads are submitters
+ */
+
+using namespace Afina;
+using namespace Afina::Bench;
+
+namespace {
+
+// Counts tasks of one submitter, padded to keep submitters from sharing cache lines. Padding instead of alignas:
+// batches are allocated with new[], which does not honour extended alignment before C++17
+struct Batch {
+    std::atomic<uint64_t> done;
+    char _padding[64 - sizeof(std::atomic<uint64_t>)];
+};
+
+void Increment(Batch *batch) { batch->done.fetch_add(1, std::memory_order_release); }
+
+void WaitBatch(Batch &batch, uint64_t target) {
+    while (batch.done.load(std::memory_order_acquire) < target) {
+        std::this_thread::yield();
+    }
+}
+
+template <typename Pool> class PoolFixture : public Fixture {
+public:
+    void SetUp(const std::vector<int64_t> &args, size_t threads) override {
+        _pool.reset(new Pool());
+        _Start(*_pool, args[0]);
+        _batches.reset(new Batch[threads]);
+    }
+
+    void TearDown() override {
+        _pool->Stop(true);
+        _pool.reset();
+    }
+
+    void Run(State &state) override {
+        Batch &batch = _batches[state.ThreadIndex()];
+        batch.done.store(0);
+        uint64_t size = state.Range(1), submitted = 0;
+        while (state.KeepRunning()) {
+            for (uint64_t i = 0; i < size; i++) {
+                while (!_pool->Execute(Increment, &batch)) { // queue is full
+                    std::this_thread::yield();
+                }
+            }
+            submitted += size;
+            WaitBatch(batch, submitted);
+        }
+        state.SetItemsProcessed(submitted);
+    }
+
+private:
+    static void _Start(Core::ThreadPool &pool, size_t threads) { pool.Start(threads, threads, 4096); }
+    static void _Start(Core::WorkStealingThreadPool &pool, size_t threads) { pool.Start(threads, 4096); }
+
+    std::unique_ptr<Pool> _pool;
+    std::unique_ptr<Batch[]> _batches;
+};
+
+// Round trip of a single task through the future: latency rather than throughput
+class SubmitGetFixture : public Fixture {
+public:
+    void SetUp(const std::vector<int64_t> &args, size_t /* threads */) override {
+        _pool.reset(new Core::ThreadPool());
+        _pool->Start(args[0], args[0], 4096);
+    }
+
+    void TearDown() override {
+        _pool->Stop(true);
+        _pool.reset();
+    }
+
+    void Run(State &state) override {
+        int sum = 0;
+        while (state.KeepRunning()) {
+            sum += _pool->Submit([]() { return 1; }).Get(); // queue is far from full, task isn't rejected
+        }
+        DoNotOptimize(sum);
+    }
+
+private:
+    std::unique_ptr<Core::ThreadPool> _pool;
+};
+
+AFINA_BENCHMARK(RegisterFixture<PoolFixture<Core::ThreadPool>>("ThreadPool/Execute")
+                    ->Args({4, 1})
+                    ->Args({4, 64})
+                    ->ThreadRange(1, 8));
+
+AFINA_BENCHMARK(RegisterFixture<PoolFixture<Core::WorkStealingThreadPool>>("WorkStealingThreadPool/Execute")
+                    ->Args({4, 1})
+                    ->Args({4, 64})
+                    ->ThreadRange(1, 8));
+
+AFINA_BENCHMARK(RegisterFixture<SubmitGetFixture>("ThreadPool/SubmitGet")->Arg(1)->Arg(4)->ThreadRange(1, 8));
+
+} // namespace
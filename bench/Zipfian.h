@@ -0,0 +1,76 @@
+#ifndef AFINA_BENCH_ZIPFIAN_H
+#define AFINA_BENCH_ZIPFIAN_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace Afina {
+namespace Bench {
+
+// Fast pseudo random numbers (xorshift64*), every benchmark thread has its own
+class Random {
+public:
+    explicit Random(uint64_t seed) : _state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+    uint64_t Next() {
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state * 0x2545F4914F6CDD1Dull;
+    }
+
+    // Uniform in [0, 1)
+    double NextDouble() { return (Next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+    uint64_t _state;
+};
+
+/**
+ * # Zipfian distribution over [0, n)
+ * Rank i is chosen with probability proportional to 1 / (i + 1)^theta, theta in [0, 1). Generator follows
+ * J. Gray et al. "Quickly generating billion-record synthetic databases" as YCSB does: zeta(n) is computed once
+ * in O(n), then each number takes O(1). Zero theta gives uniform distribution, YCSB default is 0.99
+ *
+ * Object is immutable after construction and could be shared by threads, each passing its own Random
+ */
+class Zipfian {
+public:
+    Zipfian(size_t n, double theta) : _n(n), _theta(theta) {
+        double zeta2 = 1 + std::pow(0.5, theta);
+        _zetan = 0;
+        for (size_t i = 1; i <= n; i++) {
+            _zetan += 1 / std::pow(double(i), theta);
+        }
+        _alpha = 1 / (1 - theta);
+        _eta = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / _zetan);
+        _half_pow_theta = std::pow(0.5, theta);
+    }
+
+    size_t Next(Random &random) const {
+        double u = random.NextDouble();
+        double uz = u * _zetan;
+        if (uz < 1) {
+            return 0;
+        }
+        if (uz < 1 + _half_pow_theta) {
+            return 1;
+        }
+        size_t rank = size_t(_n * std::pow(_eta * u - _eta + 1, _alpha));
+        return (rank < _n) ? rank : _n - 1;
+    }
+
+private:
+    size_t _n;
+    double _theta;
+    double _zetan;
+    double _alpha;
+    double _eta;
+    double _half_pow_theta;
+};
+
+} // namespace Bench
+} // namespace Afina
+
+#endif // AFINA_BENCH_ZIPFIAN_H
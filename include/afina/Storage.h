@@ -1,6 +1,7 @@
 #ifndef AFINA_STORAGE_H
 #define AFINA_STORAGE_H
 
+#include <map>
 #include <string>
 
 namespace Afina {
@@ -84,6 +85,52 @@ public:
      * @param value output parameter to copy value to
      */
     virtual bool Get(const std::string &key, std::string &value) = 0;
+
+    /**
+     * Appends storage specific statistics to the given map, where key is a name of statistics and value is its
+     * current value. Statistics is reported to clients by "stats" command, so names should follow memcached
+     * conventions (lowercase words separated by underscore)
+     *
+     * @param stats output parameter to add statistics to
+     */
+    virtual void GetStatistics(std::map<std::string, std::string> & /* stats */) {}
+
+    /**
+     * Changes memory budget of the storage on the fly, in bytes. Growing takes effect immediately. On shrinking
+     * least recently used elements are evicted by small portions in the background, so budget goes down to the
+     * requested value gradually and clients don't see a latency spike
+     *
+     * Method returns false if storage doesn't support resizing
+     *
+     * @param max_size new budget in bytes
+     */
+    virtual bool SetMemoryLimit(size_t /* max_size */) { return false; }
+
+    /**
+     * Returns memory budget requested last time, in bytes. 0 if storage doesn't support resizing
+     */
+    virtual size_t GetMemoryLimit() { return 0; }
+
+    /**
+     * Changes configured memory limit of the storage, in bytes, and sets memory budget to it. Budget may be lowered
+     * later by SetMemoryLimit, e.g. under memory pressure, but shouldn't be raised above configured limit
+     *
+     * Method returns false if storage doesn't support resizing
+     *
+     * @param max_size new limit in bytes
+     */
+    virtual bool SetMaxMemoryLimit(size_t /* max_size */) { return false; }
+
+    /**
+     * Returns memory limit configured at startup or by SetMaxMemoryLimit, in bytes. 0 if storage doesn't support
+     * resizing
+     */
+    virtual size_t GetMaxMemoryLimit() { return 0; }
+
+    /**
+     * Returns bytes occupied by keys and values now
+     */
+    virtual size_t GetMemoryUsage() { return 0; }
 };
 
 } // namespace Afina
@@ -0,0 +1,79 @@
+#ifndef AFINA_CORE_EVENT_COUNT_H
+#define AFINA_CORE_EVENT_COUNT_H
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Core {
+
+/**
+ * # Event count
+ * Lets threads sleep until some condition over lock-free data becomes true, without a mutex on either side.
+ * Waiter announces itself, checks the condition once more and sleeps on futex only if it is still false:
+ *
+ *     while (!TryTake(task)) {
+ *         auto key = event.PrepareWait();
+ *         if (TryTake(task)) { event.CancelWait(); break; }
+ *         event.Wait(key);
+ *     }
+ *
+ * Producer changes data and calls Notify(), which costs a fence and a load while nobody waits. Either producer
+ * sees the waiter or waiter sees the change, so wakeup is never lost
+ */
+class EventCount {
+public:
+    typedef uint32_t Key;
+
+    EventCount() : _epoch(0), _waiters(0) {}
+
+    EventCount(const EventCount &) = delete;
+    EventCount &operator=(const EventCount &) = delete;
+
+    // Announces that caller is going to wait, condition must be checked after this call
+    Key PrepareWait() {
+        _waiters.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return _epoch.load(std::memory_order_acquire);
+    }
+
+    // Condition turned out to be true, caller doesn't wait
+    void CancelWait() { _waiters.fetch_sub(1, std::memory_order_relaxed); }
+
+    // Sleeps until notification which happened after PrepareWait() returned key
+    void Wait(Key key) {
+        while (_epoch.load(std::memory_order_acquire) == key) {
+            syscall(SYS_futex, reinterpret_cast<uint32_t *>(&_epoch), FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+        }
+        _waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void NotifyOne() { _Notify(1); }
+    void NotifyAll() { _Notify(INT_MAX); }
+
+private:
+    void _Notify(int count) {
+        // Pairs with the fence in PrepareWait(): changes made by the caller are visible to the waiter's check
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_waiters.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+
+        _epoch.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&_epoch), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+    }
+
+    // Futex word, changes on each notification that could have waiters
+    std::atomic<uint32_t> _epoch;
+    std::atomic<uint32_t> _waiters;
+};
+
+} // namespace Core
+} // namespace Afina
+
+#endif // AFINA_CORE_EVENT_COUNT_H
@@ -0,0 +1,118 @@
+#ifndef AFINA_CORE_MPMC_QUEUE_H
+#define AFINA_CORE_MPMC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace Afina {
+namespace Core {
+
+/**
+ * # Bounded multi-producer multi-consumer queue
+ * Ring of cells each with a sequence number telling whether the cell is free for the producer of the given lap
+ * or filled for the consumer of it (D. Vyukov's bounded MPMC queue). Producers and consumers synchronize on the
+ * cell only, so push and pop take a single CAS on their own position unless queue is full or empty.
+ *
+ * T must be default constructible and movable
+ */
+template <typename T> class MPMCQueue {
+public:
+    // capacity is rounded up to the power of two
+    explicit MPMCQueue(size_t capacity) : _enqueue_position(0), _dequeue_position(0) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        _mask = size - 1;
+        _cells = new Cell[size];
+        for (size_t i = 0; i < size; i++) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~MPMCQueue() { delete[] _cells; }
+
+    MPMCQueue(const MPMCQueue &) = delete;
+    MPMCQueue &operator=(const MPMCQueue &) = delete;
+
+    // Returns false if queue is full, value is left untouched then
+    bool TryPush(T &value) {
+        size_t position = _enqueue_position.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &_cells[position & _mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false; // cell still keeps value of the previous lap
+            } else {
+                position = _enqueue_position.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = std::move(value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false if queue is empty
+    bool TryPop(T &value) {
+        size_t position = _dequeue_position.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &_cells[position & _mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (difference == 0) {
+                if (_dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false; // producer of this lap hasn't filled the cell yet
+            } else {
+                position = _dequeue_position.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->data);
+        cell->sequence.store(position + _mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate number of elements
+    size_t Size() const {
+        size_t enqueue = _enqueue_position.load(std::memory_order_relaxed);
+        size_t dequeue = _dequeue_position.load(std::memory_order_relaxed);
+        return (enqueue > dequeue) ? enqueue - dequeue : 0;
+    }
+
+    size_t Capacity() const { return _mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    Cell *_cells;
+    size_t _mask;
+
+    // Producers and consumers update different positions, keep them in different cache lines, see
+    // WorkStealingDeque.h about padding
+    char _padding0[64];
+    std::atomic<size_t> _enqueue_position;
+    char _padding1[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> _dequeue_position;
+    char _padding2[64 - sizeof(std::atomic<size_t>)];
+};
+
+} // namespace Core
+} // namespace Afina
+
+#endif // AFINA_CORE_MPMC_QUEUE_H
@@ -0,0 +1,51 @@
+#ifndef AFINA_CORE_SPIN_LOCK_H
+#define AFINA_CORE_SPIN_LOCK_H
+
+#include <atomic>
+
+namespace Afina {
+namespace Core {
+
+// Pause instruction in busy-wait loops: lets sibling hyperthread run and saves power
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/**
+ * # Test and test-and-set spin lock
+ * For critical sections of a few instructions only, where parking a thread costs more than waiting. Satisfies
+ * Lockable, so works with std::lock_guard
+ */
+class SpinLock {
+public:
+    SpinLock() : _locked(false) {}
+
+    SpinLock(const SpinLock &) = delete;
+    SpinLock &operator=(const SpinLock &) = delete;
+
+    void lock() {
+        while (_locked.exchange(true, std::memory_order_acquire)) {
+            while (_locked.load(std::memory_order_relaxed)) {
+                CpuRelax();
+            }
+        }
+    }
+
+    bool try_lock() {
+        return !_locked.load(std::memory_order_relaxed) && !_locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() { _locked.store(false, std::memory_order_release); }
+
+private:
+    std::atomic<bool> _locked;
+};
+
+} // namespace Core
+} // namespace Afina
+
+#endif // AFINA_CORE_SPIN_LOCK_H
@@ -0,0 +1,145 @@
+#ifndef AFINA_CORE_WORK_STEALING_DEQUE_H
+#define AFINA_CORE_WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Afina {
+namespace Core {
+
+/**
+ * # Chase-Lev work stealing deque
+ * Lock-free deque with a single owner thread pushing and popping at the bottom and any number of thieves
+ * taking elements from the top. Owner works without atomic read-modify-write operations except when it
+ * competes with thieves for the last element. Memory orders follow "Correct and Efficient Work-Stealing
+ * for Weak Memory Models" (Le, Pop, Cohen, Zappa Nardelli, 2013).
+ *
+ * Buffer grows when full. Old buffers could still be read by thieves, so they are kept until the deque is
+ * destroyed; each is half of the next one, so they take no more memory than the current buffer.
+ *
+ * T must be trivially copyable, pointers are the intended use
+ */
+template <typename T> class WorkStealingDeque {
+public:
+    // capacity is rounded up to the power of two
+    explicit WorkStealingDeque(size_t capacity = 64) : _top(0), _bottom(0) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        _array.store(new Array(size), std::memory_order_relaxed);
+    }
+
+    ~WorkStealingDeque() {
+        delete _array.load(std::memory_order_relaxed);
+        for (Array *array : _retired) {
+            delete array;
+        }
+    }
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // Owner only: adds element to the bottom
+    void Push(T value) {
+        int64_t bottom = _bottom.load(std::memory_order_relaxed);
+        int64_t top = _top.load(std::memory_order_acquire);
+        Array *array = _array.load(std::memory_order_relaxed);
+        if (bottom - top > static_cast<int64_t>(array->size) - 1) {
+            array = _Grow(array, top, bottom);
+        }
+
+        array->Put(bottom, value);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only: takes the most recently pushed element, false if deque is empty
+    bool Pop(T &value) {
+        int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+        Array *array = _array.load(std::memory_order_relaxed);
+        _bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = _top.load(std::memory_order_relaxed);
+
+        bool result = true;
+        if (top <= bottom) {
+            value = array->Get(bottom);
+            if (top == bottom) {
+                // The last element, thieves could take it as well
+                result = _top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                      std::memory_order_relaxed);
+                _bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+        } else {
+            result = false;
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    /**
+     * Any thread: takes the oldest element. Returns false if deque is empty or another thread has taken
+     * the element first
+     */
+    bool Steal(T &value) {
+        int64_t top = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = _bottom.load(std::memory_order_acquire);
+        if (top >= bottom) {
+            return false;
+        }
+
+        Array *array = _array.load(std::memory_order_acquire);
+        value = array->Get(top);
+        return _top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // Any thread: approximate number of elements
+    size_t Size() const {
+        int64_t bottom = _bottom.load(std::memory_order_relaxed);
+        int64_t top = _top.load(std::memory_order_relaxed);
+        return (bottom > top) ? static_cast<size_t>(bottom - top) : 0;
+    }
+
+    bool Empty() const { return Size() == 0; }
+
+private:
+    struct Array {
+        size_t size;
+        std::atomic<T> *items;
+
+        explicit Array(size_t size_p) : size(size_p), items(new std::atomic<T>[size_p]) {}
+        ~Array() { delete[] items; }
+
+        T Get(int64_t index) const { return items[index & (size - 1)].load(std::memory_order_relaxed); }
+        void Put(int64_t index, T value) { items[index & (size - 1)].store(value, std::memory_order_relaxed); }
+    };
+
+    Array *_Grow(Array *array, int64_t top, int64_t bottom) {
+        Array *bigger = new Array(array->size * 2);
+        for (int64_t i = top; i < bottom; i++) {
+            bigger->Put(i, array->Get(i));
+        }
+        _retired.push_back(array);
+        _array.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    // Thieves and owner update different ends, keep them in different cache lines. Padding instead of alignas:
+    // C++11 operator new doesn't respect extended alignment
+    std::atomic<int64_t> _top;
+    char _padding[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> _bottom;
+    std::atomic<Array *> _array;
+
+    // Owner only
+    std::vector<Array *> _retired;
+};
+
+} // namespace Core
+} // namespace Afina
+
+#endif // AFINA_CORE_WORK_STEALING_DEQUE_H
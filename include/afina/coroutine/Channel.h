@@ -0,0 +1,175 @@
+#ifndef AFINA_COROUTINE_CHANNEL_H
+#define AFINA_COROUTINE_CHANNEL_H
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "Sync.h"
+
+namespace Afina {
+namespace Coroutine {
+
+/**
+ * # Bounded channel between coroutines
+ * Any number of senders and receivers (so it serves MPSC case as well). Sender is parked while the channel is
+ * full, receiver while it is empty; value is handed over directly to a parked receiver, bypassing the buffer.
+ *
+ * send() and receive() must be called from coroutines, try_* and close() could be called from any thread.
+ * T must be default constructible and move assignable
+ */
+template <typename T> class Channel {
+public:
+    explicit Channel(size_t capacity) : _buffer(capacity), _head(0), _size(0), _closed(false) {
+        ASSERT(capacity > 0);
+    }
+
+    Channel(const Channel &) = delete;
+    Channel &operator=(const Channel &) = delete;
+
+    // Parks while channel is full. Returns false if channel is closed, value isn't sent then
+    bool send(T value) {
+        _guard.lock();
+        if (_TrySend(value)) {
+            return true; // guard is released by _TrySend
+        }
+        if (_closed) {
+            _guard.unlock();
+            return false;
+        }
+
+        // Receiver moves the value into the buffer and sets result, close() leaves it false
+        WaitQueue::Waiter waiter(&value);
+        WaitQueue::Wait(_guard, _senders, waiter);
+        return waiter.result;
+    }
+
+    // Value is moved out only if it is sent
+    bool try_send(T &value) {
+        _guard.lock();
+        if (_TrySend(value)) {
+            return true;
+        }
+        _guard.unlock();
+        return false;
+    }
+
+    // Parks while channel is empty. Returns false once channel is closed and drained
+    bool receive(T &value) {
+        _guard.lock();
+        if (_TryReceive(value)) {
+            return true;
+        }
+        if (_closed) {
+            _guard.unlock();
+            return false;
+        }
+
+        WaitQueue::Waiter waiter(&value);
+        WaitQueue::Wait(_guard, _receivers, waiter);
+        return waiter.result;
+    }
+
+    bool try_receive(T &value) {
+        _guard.lock();
+        if (_TryReceive(value)) {
+            return true;
+        }
+        _guard.unlock();
+        return false;
+    }
+
+    // Wakes all waiters: senders fail, receivers get the rest of the buffer and then fail
+    void close() {
+        _guard.lock();
+        _closed = true;
+        WaitQueue woken;
+        for (WaitQueue::Waiter *waiter = _senders.Pop(); waiter != nullptr; waiter = _senders.Pop()) {
+            woken.Push(waiter);
+        }
+        for (WaitQueue::Waiter *waiter = _receivers.Pop(); waiter != nullptr; waiter = _receivers.Pop()) {
+            woken.Push(waiter);
+        }
+        _guard.unlock();
+
+        for (WaitQueue::Waiter *waiter = woken.Pop(); waiter != nullptr; waiter = woken.Pop()) {
+            Engine::unpark(waiter->routine);
+        }
+    }
+
+    bool closed() {
+        std::lock_guard<Core::SpinLock> guard(_guard);
+        return _closed;
+    }
+
+    size_t size() {
+        std::lock_guard<Core::SpinLock> guard(_guard);
+        return _size;
+    }
+
+    size_t capacity() const { return _buffer.size(); }
+
+private:
+    Core::SpinLock _guard;
+
+    // Ring buffer
+    std::vector<T> _buffer;
+    size_t _head;
+    size_t _size;
+    bool _closed;
+
+    WaitQueue _senders;
+    WaitQueue _receivers;
+
+    // Both are called under the guard and release it on success, waiter is unparked after that
+    bool _TrySend(T &value) {
+        if (_closed) {
+            return false;
+        }
+
+        WaitQueue::Waiter *receiver = _receivers.Pop();
+        if (receiver != nullptr) {
+            *static_cast<T *>(receiver->data) = std::move(value);
+            receiver->result = true;
+            _guard.unlock();
+            Engine::unpark(receiver->routine);
+            return true;
+        }
+
+        if (_size == _buffer.size()) {
+            return false;
+        }
+        _buffer[(_head + _size) % _buffer.size()] = std::move(value);
+        _size++;
+        _guard.unlock();
+        return true;
+    }
+
+    bool _TryReceive(T &value) {
+        if (_size == 0) {
+            return false;
+        }
+        value = std::move(_buffer[_head]);
+        _head = (_head + 1) % _buffer.size();
+        _size--;
+
+        // Place freed, the first parked sender completes its send
+        WaitQueue::Waiter *sender = _senders.Pop();
+        if (sender != nullptr) {
+            _buffer[(_head + _size) % _buffer.size()] = std::move(*static_cast<T *>(sender->data));
+            _size++;
+            sender->result = true;
+        }
+        _guard.unlock();
+
+        if (sender != nullptr) {
+            Engine::unpark(sender->routine);
+        }
+        return true;
+    }
+};
+
+} // namespace Coroutine
+} // namespace Afina
+
+#endif // AFINA_COROUTINE_CHANNEL_H
@@ -2,25 +2,94 @@
 #define AFINA_COROUTINE_ENGINE_H
 
 #include "../core/Debug.h"
+#include "../core/SpinLock.h"
+#include "../core/WorkStealingDeque.h"
+#include "StackPool.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <map>
+#include <new>
 #include <setjmp.h>
 #include <tuple>
+#include <utility>
+#include <vector>
+
+// Separate stacks are switched by a few lines of assembly on x86_64 and by ucontext elsewhere (or if
+// AFINA_COROUTINE_UCONTEXT is defined explicitly)
+#if !defined(__x86_64__) && !defined(AFINA_COROUTINE_UCONTEXT)
+#define AFINA_COROUTINE_UCONTEXT
+#endif
+#ifdef AFINA_COROUTINE_UCONTEXT
+#include <ucontext.h>
+#endif
 
 namespace Afina {
 namespace Coroutine {
 
+class Scheduler;
+
 /**
  * # Entry point of coroutine library
- * Allows to run coroutine and schedule its execution. Not threadsafe
+ * Allows to run coroutine and schedule its execution. Not threadsafe, except when engine is a part of Scheduler:
+ * see Scheduler.h
  */
 class Engine final {
+    friend class Scheduler;
+
+public:
+    enum class StackMode {
+        // Coroutines run on the stack of the thread called start(), live part of the stack is copied out on each
+        // switch and back on resume. Switch costs O(stack depth), but there is no limit on coroutine stack size
+        Copy,
+
+        // Each coroutine owns mmap'd stack of the fixed size protected by a guard page, switch saves and restores
+        // only callee-saved registers
+        Separate
+    };
+
+    // Stack size of a coroutine in Separate mode, guard page is not included
+    static const size_t default_stack_size = 128 * 1024;
+
+    typedef std::chrono::steady_clock clock;
+
 private:
     // 0 - not init yet, >0 from higher to lower, <0 - from lower to higher
     static int _stack_direction;
 
+    // Position in the timer heap of routine without deadline
+    static const size_t no_timer = static_cast<size_t>(-1);
+
+    // Index sequence to unpack arguments stored in tuple (C++11 has no std::index_sequence)
+    template <std::size_t... I> struct _Indexes {};
+    template <std::size_t N, std::size_t... I> struct _MakeIndexes : _MakeIndexes<N - 1, N - 1, I...> {};
+    template <std::size_t... I> struct _MakeIndexes<0, I...> { typedef _Indexes<I...> type; };
+
+    /**
+     * Function with arguments to run in a coroutine with separate stack. Object is placed at the top of the
+     * coroutine stack, so creation of a coroutine doesn't allocate anything except the stack itself
+     */
+    struct _Task {
+        virtual ~_Task() {}
+        virtual void Run() = 0;
+    };
+
+    template <typename... Ta> struct _FunctionTask : public _Task {
+        void (*func)(Ta...);
+
+        // References are kept as references, values are moved in, the same way as copy mode passes them
+        std::tuple<Ta...> args;
+
+        _FunctionTask(void (*func_p)(Ta...), Ta &&... args_p) : func(func_p), args(std::forward<Ta>(args_p)...) {}
+
+        void Run() override { _Call(typename _MakeIndexes<sizeof...(Ta)>::type()); }
+
+        template <std::size_t... I> void _Call(_Indexes<I...>) { func(std::forward<Ta>(std::get<I>(args))...); }
+    };
+
     /**
      * A single coroutine instance which could be scheduled for execution
      * should be allocated on heap
@@ -54,8 +123,9 @@ private:
             }
         }
 
-        // coroutine stack copy buffer
+        // coroutine stack copy buffer, reused while stack fits into it
         char *Stack = nullptr;
+        size_t StackCapacity = 0;
 
         // Saved coroutine context (registers)
         jmp_buf Environment;
@@ -66,14 +136,54 @@ private:
 
         void RemoveStack() {
             if (Stack != nullptr) {
-                free((void *)Stack); // because calloc was used
+                free((void *)Stack); // because malloc was used
                 Stack = nullptr;
+                StackCapacity = 0;
             }
         }
 
+        // Separate mode: own stack got from the pool, nullptr for the idle context which runs on the thread stack.
+        // Context itself is placed at the top of this stack
+        char *OwnStack = nullptr;
+
+        // Pool stack was got from, coroutine could finish on another engine of the scheduler
+        StackPool *Pool = nullptr;
+
+        // Separate mode: function to run, placed on OwnStack just below the context
+        _Task *Task = nullptr;
+
+        // Separate mode: saved stack pointer, registers are on the stack below it
+        void *StackPointer = nullptr;
+
+        // Separate mode: descriptor coroutine waits for in wait_fd() and events got for it, 0 if wait was interrupted
+        int WaitFd = -1;
+        uint32_t WaitEvents = 0;
+
+        // Separate mode: engine routine was parked on, see park()
+        Engine *ParkedOn = nullptr;
+
+        // Separate mode: when sleep or wait_fd() ends and position in the timer heap, no_timer if there is no deadline
+        clock::time_point Deadline;
+        size_t TimerIndex = no_timer;
+
+#ifdef AFINA_COROUTINE_UCONTEXT
+        ucontext_t Ucontext;
+#endif
+
         ~context() { RemoveStack(); }
     } context;
 
+    StackMode _mode;
+
+    // Separate mode: stacks of coroutines
+    StackPool _stack_pool;
+
+    /**
+     * Separate mode: coroutine which has finished, but whose stack can't be released yet as it was running
+     * on it. Released by idle context
+     */
+    context *_zombie;
+
     /**
      * Where coroutines stack begins
      */
@@ -89,11 +199,65 @@ private:
      */
     context *alive;
 
+    /**
+     * Separate mode: routines suspended in wait_fd(), they get back into alive list once descriptor is ready
+     */
+    context *blocked;
+
     /**
      * Context to be returned finally
      */
     context *idle_ctx;
 
+    // Separate mode: epoll instance descriptors of blocked coroutines are registered in and eventfd that
+    // interrupts waits
+    int _epoll_fd;
+    int _interrupt_fd;
+
+    // Busy coroutines could yield to each other forever without returning to idle context, so ready descriptors
+    // are checked once per this number of yields
+    static const size_t _poll_interval = 64;
+    size_t _yields_since_poll;
+
+    /**
+     * Scheduler mode: engine this one belongs to and its index there. Runnable coroutines are not in alive list,
+     * but in the deque, where other engines could steal them from
+     */
+    Scheduler *_scheduler;
+    size_t _index;
+    Core::WorkStealingDeque<context *> _ready;
+
+    /**
+     * Scheduler mode: coroutine which has yielded. It is published in the deque only after switch is done,
+     * otherwise other engine could steal and resume it while its registers are still being saved
+     */
+    context *_yielded;
+
+    // Separate mode: eventfd to wake engine sleeping in epoll when there is work for it, and sleeping flag
+    int _notify_fd;
+    std::atomic<bool> _sleeping;
+
+    // Separate mode: lock park() releases once the parked routine is switched out
+    Core::SpinLock *_unlock_after_switch;
+
+    // Separate mode: routines parked on this engine, engine doesn't stop while there are any
+    std::atomic<size_t> _parked;
+
+    // Separate mode: routines unparked by threads which have no engine of the same scheduler
+    Core::SpinLock _remote_lock;
+    std::vector<context *> _remote;
+    std::atomic<bool> _remote_pending;
+
+    /**
+     * Separate mode: min-heap of routines with deadline ordered by it, routine knows its position, so timer is
+     * cancelled in O(log n) once descriptor gets ready before the deadline. Routine waiting for descriptor is in
+     * blocked list as well, sleeping one is only here
+     */
+    std::vector<context *> _timers;
+
+    // Engine running on the current thread
+    static thread_local Engine *_current;
+
 protected:
     /**
      * Save stack of the current coroutine in the given context
@@ -110,7 +274,114 @@ protected:
      */
     void _Rewind(context &new_ctx);
 
-    static void _SetStackDirection(char *caller_addr) {
+    /**
+     * Separate mode: allocates stack for the new coroutine, places task on its top and makes coroutine ready to
+     * be scheduled
+     */
+    context *_CreateSeparate(size_t task_size, size_t task_align, void *&task_place);
+    void _PrepareSeparate(context *pc);
+
+    // Separate mode: saves registers of the current coroutine and passes control to the given one
+    void _Switch(context &from, context &to);
+
+    // Separate mode: first function called on the new stack
+    static void _SeparateEntry(Engine *engine);
+#ifdef AFINA_COROUTINE_UCONTEXT
+    static void _UcontextEntry(int engine_high, int engine_low);
+#endif
+
+    // Separate mode: body of start() after main coroutine is created
+    void _StartSeparate(void *main);
+
+    // Unlinks coroutine from the given list (alive or blocked)
+    void _Unlink(context *pc) { _Unlink(alive, pc); }
+    static void _Unlink(context *&list, context *pc);
+    static void _Link(context *&list, context *pc);
+
+    // Separate mode: creates epoll instance for wait_fd()
+    void _InitPoller();
+
+    /**
+     * Reads _current. Coroutine could continue on other thread after any switch, but compiler is allowed to keep
+     * address of thread local variable computed before the switch, so it is read by function which is not inlined
+     */
+    static Engine *_Current();
+
+    // Engine methods should work on: in scheduler mode coroutine could hold reference to another engine
+    Engine &_Self() { return (_scheduler == nullptr) ? *this : *_Current(); }
+
+    // Scheduler mode: joins scheduler, engine should not run yet
+    void _Attach(Scheduler *scheduler, size_t index);
+
+    // Separate mode: makes created or woken up coroutine runnable
+    void _MakeReady(context *pc);
+
+    // Scheduler mode: takes coroutine from own deque, then from the other engines if steal is set
+    context *_TakeReady(bool steal);
+
+    // Scheduler mode: called after each switch on the new stack to finish what previous context couldn't
+    void _AfterSwitch();
+
+    // Scheduler mode: the same as yield() for engine of the current thread
+    void _ScheduledYield();
+
+    // Separate mode: releases finished coroutine
+    void _FreeZombie();
+
+    // Scheduler mode: body of the engine thread, runs until all coroutines of the scheduler are done
+    void _RunScheduled();
+
+    // Scheduler mode: wakes engine if it is sleeping, returns false if it wasn't
+    bool _Wake();
+
+    // Separate mode: threadsafe, passes unparked routine to the engine and decrements the parked counter
+    void _RemoteReady(context *pc);
+
+    // Separate mode: makes routines passed by _RemoteReady() runnable
+    void _DrainRemote();
+
+    // Separate mode: takes _remote_lock on the engine side, yielding to the unparking thread which holds it
+    void _LockRemote();
+
+    // Separate mode: sleeps in epoll unless there is remote work, to be called when no routine is runnable
+    void _Sleep();
+
+    /**
+     * Separate mode: waits for events for up to timeout milliseconds (-1 - infinitely) and moves coroutines which
+     * descriptors are ready from blocked list back to alive. Wait ends not later than the earliest deadline,
+     * routines whose deadline has passed are woken up as well
+     */
+    void _Poll(int timeout);
+
+    // Separate mode: there are routines waiting for descriptor or deadline
+    bool _HasWaiters() const { return blocked != nullptr || !_timers.empty(); }
+
+    // Separate mode: passes control from the current routine, which is already out of alive list, to the next
+    // runnable one or to idle context if there is none
+    void _Suspend(context *pc);
+
+    // Separate mode: body of wait_fd() and wait_fd_until(), deadline is nullptr for infinite wait
+    uint32_t _WaitFd(int fd, uint32_t events, const clock::time_point *deadline);
+
+    // Separate mode: timer heap operations
+    void _TimerAdd(context *pc, clock::time_point deadline);
+    void _TimerRemove(context *pc);
+    void _TimerUp(size_t index);
+    void _TimerDown(size_t index);
+    void _TimerSwap(size_t a, size_t b);
+
+    // Separate mode: milliseconds to wait for the earliest deadline, but not longer than timeout (-1 - infinitely)
+    int _TimerTimeout(int timeout) const;
+
+    // Separate mode: moves routines from the heap to woken list, all if expired_only isn't set
+    void _TimerExpire(context *&woken, bool expired_only);
+
+    // Destroys context, in separate mode returns its stack to the pool
+    void _DeleteContext(context *pc);
+
+    // Not inlined: local of the caller must be in another frame, otherwise compiler is free to place both
+    // variables in any order
+    __attribute__((noinline)) static void _SetStackDirection(char *caller_addr) {
         if (_stack_direction != 0) {
             return;
         }
@@ -120,9 +391,16 @@ protected:
     }
 
 public:
-    Engine() : StackBottom(0), cur_routine(nullptr), alive(nullptr) {
+    Engine(StackMode mode = StackMode::Copy, size_t stack_size = default_stack_size)
+        : _mode(mode), _stack_pool(stack_size), _zombie(nullptr), StackBottom(0), cur_routine(nullptr), alive(nullptr),
+          blocked(nullptr), idle_ctx(nullptr), _epoll_fd(-1), _interrupt_fd(-1), _yields_since_poll(0),
+          _scheduler(nullptr), _index(0), _yielded(nullptr), _notify_fd(-1), _sleeping(false),
+          _unlock_after_switch(nullptr), _parked(0), _remote_pending(false) {
         char stack_position = 0;
         _SetStackDirection(&stack_position);
+        if (_mode == StackMode::Separate) {
+            _InitPoller();
+        }
     }
 
     Engine(Engine &&) = delete;
@@ -130,6 +408,12 @@ public:
 
     ~Engine();
 
+    // Stacks of coroutines in separate mode
+    const StackPool &stack_pool() const { return _stack_pool; }
+
+    // Engine running on the calling thread, nullptr if there is none
+    static Engine *current() { return _Current(); }
+
     /**
      * Gives up current routine execution and let engine to schedule other one. It is not defined when
      * routine will get execution back, for example if there are no other coroutines then executing could
@@ -146,9 +430,69 @@ public:
      *
      * If routine to pass execution to is not specified runtime will try to transfer execution back to caller
      * of the current routine, if there is no caller then this method has same semantics as yield
+     *
+     * Not available in scheduler mode: the routine could be running on other engine at the moment
      */
     void sched(void *routine);
 
+    /**
+     * Separate mode only. Suspends current routine until descriptor gets ready for one of the given epoll events
+     * (EPOLLIN, EPOLLOUT, ...) and lets engine run other routines meanwhile. Once all routines are either done
+     * or blocked, engine sleeps in epoll_wait. Descriptor is registered in engine's epoll instance on the first
+     * wait and stays there until it is closed, so only one routine could wait for a particular descriptor.
+     *
+     * Returns events happened (EPOLLERR and EPOLLHUP are reported even if not requested) or 0 if the wait was
+     * interrupted, see interrupt()
+     */
+    uint32_t wait_fd(int fd, uint32_t events) { return _WaitFd(fd, events, nullptr); }
+
+    // The same as wait_fd(), but gives up once deadline is reached and returns 0 as well
+    uint32_t wait_fd_until(int fd, uint32_t events, clock::time_point deadline) {
+        return _WaitFd(fd, events, &deadline);
+    }
+
+    template <typename Rep, typename Period>
+    uint32_t wait_fd(int fd, uint32_t events, const std::chrono::duration<Rep, Period> &timeout) {
+        return wait_fd_until(fd, events, clock::now() + std::chrono::duration_cast<clock::duration>(timeout));
+    }
+
+    /**
+     * Separate mode only. Suspends current routine until deadline, other routines run meanwhile. Engine sleeping
+     * in epoll_wait wakes up on the earliest deadline. Sleep ends earlier if engine is interrupted
+     */
+    void sleep_until(clock::time_point deadline);
+
+    template <typename Rep, typename Period> void sleep_for(const std::chrono::duration<Rep, Period> &duration) {
+        sleep_until(clock::now() + std::chrono::duration_cast<clock::duration>(duration));
+    }
+
+    /**
+     * Separate mode only, low level API for synchronization primitives (see Sync.h). Suspends current routine
+     * until unpark() is called for it. Given lock must be held by the caller, it is released once the routine is
+     * switched out: whoever takes the lock to find a routine to wake up never sees it half suspended. Engine
+     * doesn't stop while it has parked routines
+     */
+    void park(Core::SpinLock &lock);
+
+    /**
+     * Threadsafe, could be called from any thread including ones without engine. Makes routine suspended in
+     * park() runnable again
+     */
+    static void unpark(void *routine);
+
+    // Routine running on the engine of the calling thread, nullptr if there is none
+    void *current_routine() {
+        Engine &self = _Self();
+        return (self.cur_routine == self.idle_ctx) ? nullptr : self.cur_routine;
+    }
+
+    /**
+     * Threadsafe. Wakes up all routines blocked in wait_fd() or sleeping, waits get 0 as result. If no routine is
+     * blocked at the moment, then the next wait returns immediately. Used to stop engine running from the other
+     * thread
+     */
+    void interrupt();
+
     /**
      * Entry point into the engine. Prepare all internal mechanics and starts given function which is
      * considered as main.
@@ -160,6 +504,14 @@ public:
      * @param arguments to be passed to the main coroutine
      */
     template <typename... Ta> void start(void (*main)(Ta...), Ta &&... args) {
+        ASSERT(_scheduler == nullptr); // scheduler starts its engines itself
+        if (_mode == StackMode::Separate) {
+            idle_ctx = new context();
+            cur_routine = idle_ctx;
+            _StartSeparate(run(main, std::forward<Ta>(args)...));
+            return;
+        }
+
         // To acquire stack begin, create variable on stack and remember its address
         char StackStartsHere = 0;
         this->StackBottom = &StackStartsHere;
@@ -190,8 +542,18 @@ public:
 public:
     // Wrapper of _run. Allows to save coroutine bottom address
     template <typename... Ta> void *run(void (*func)(Ta...), Ta &&... args) {
+        if (_mode == StackMode::Separate) {
+            typedef _FunctionTask<Ta...> TaskType;
+            Engine &self = _Self();
+            void *task_place = nullptr;
+            context *pc = self._CreateSeparate(sizeof(TaskType), alignof(TaskType), task_place);
+            pc->Task = new (task_place) TaskType(func, std::forward<Ta>(args)...);
+            self._PrepareSeparate(pc);
+            return pc;
+        }
+
         char coroutine_start = 0;
-        _run(&coroutine_start, func, std::forward<Ta>(args)...);
+        return _run(&coroutine_start, func, std::forward<Ta>(args)...);
     }
 
 protected:
@@ -223,22 +585,11 @@ protected:
             // to pass control after that. We never want to go backward by stack as that would mean to go backward in
             // time. Function run() has already return once (when setjmp returns 0), so return second return from run
             // would looks a bit awkward
-            if (pc->prev != nullptr) {
-                pc->prev->next = pc->next;
-            }
-
-            if (pc->next != nullptr) {
-                pc->next->prev = pc->prev;
-            }
-
-            if (alive == cur_routine) {
-                alive = alive->next;
-            }
+            _Unlink(pc);
 
             // current coroutine finished, and the pointer is not relevant now
             cur_routine = nullptr;
-            pc->prev = pc->next = nullptr;
-            delete pc;
+            _DeleteContext(pc);
 
             // We cannot return here, as this function "returned" once already, so here we must select some other
             // coroutine to run. As current coroutine is completed and can't be scheduled anymore, it is safe to
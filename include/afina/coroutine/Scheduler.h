@@ -0,0 +1,79 @@
+#ifndef AFINA_COROUTINE_SCHEDULER_H
+#define AFINA_COROUTINE_SCHEDULER_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Engine.h"
+
+namespace Afina {
+namespace Coroutine {
+
+/**
+ * # M:N coroutine scheduler
+ * Runs coroutines on a number of threads, each thread has own engine in separate stack mode. Runnable coroutines
+ * of an engine are kept in the lock-free work stealing deque: engine takes them from there in FIFO order, and
+ * engines that have nothing to run steal from the others, so a flood of work created on one thread spreads
+ * over all of them. Engine without work sleeps in epoll_wait together with its blocked coroutines and is woken
+ * up through eventfd once work appears.
+ *
+ * Coroutine could continue on another thread after any suspension point (yield, wait_fd). Engine methods could
+ * be called on any engine of the scheduler, they act on the engine of the calling thread; sched() is not
+ * available. Coroutines should not keep thread local state across suspension points
+ */
+class Scheduler {
+public:
+    // threads - number of engines, 0 means one per core
+    Scheduler(size_t threads = 0, size_t stack_size = Engine::default_stack_size);
+    ~Scheduler();
+
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    /**
+     * Starts main coroutine and runs engines: the first one on the calling thread, others on new threads.
+     * Returns once all coroutines are done
+     */
+    template <typename... Ta> void start(void (*main)(Ta...), Ta &&... args) {
+        Engine *previous = Engine::_current;
+        Engine::_current = _engines[0].get();
+        _engines[0]->run(main, std::forward<Ta>(args)...);
+        Engine::_current = previous;
+        _Run();
+    }
+
+    // Threadsafe. Interrupts waits of all engines, see Engine::interrupt()
+    void interrupt();
+
+    size_t size() const { return _engines.size(); }
+    Engine &engine(size_t index) { return *_engines[index]; }
+
+private:
+    friend class Engine;
+
+    std::vector<std::unique_ptr<Engine>> _engines;
+
+    // Coroutines created and not finished yet, engines exit once there are none
+    std::atomic<size_t> _live;
+
+    // Engines announced they are going to sleep
+    std::atomic<size_t> _sleepers;
+
+    void _Run();
+
+    // Takes runnable coroutine from some engine other then thief
+    Engine::context *_Steal(Engine *thief);
+
+    // Engine has pushed work: wakes one sleeping engine to steal it
+    void _Notify(Engine *pusher);
+
+    // Wakes all engines to check if coroutines are over
+    void _WakeAll();
+};
+
+} // namespace Coroutine
+} // namespace Afina
+
+#endif // AFINA_COROUTINE_SCHEDULER_H
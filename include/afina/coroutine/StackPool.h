@@ -0,0 +1,74 @@
+#ifndef AFINA_COROUTINE_STACK_POOL_H
+#define AFINA_COROUTINE_STACK_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace Afina {
+namespace Coroutine {
+
+/**
+ * # Pool of coroutine stacks
+ * Hands out fixed size stacks, each is a separate mapping with PROT_NONE guard page at the bottom, so overflow
+ * crashes instead of corrupting a neighbour. Released stacks are kept for reuse, so in steady state creation of
+ * a coroutine doesn't call mmap/munmap at all.
+ *
+ * The last hot_stacks released stacks are kept as is. Stacks idle for longer are madvise(MADV_DONTNEED)'d once, when
+ * they leave the hot part: mapping stays, but physical pages go back to the system and are faulted in (zeroed) on the
+ * next use.
+ *
+ * Not threadsafe, except for Mapped() which could be read and changed by Adopt() of another pool
+ */
+class StackPool {
+public:
+    // stack_size - usable size, rounded up to pages; guard page is added on top of it
+    StackPool(size_t stack_size, size_t hot_stacks = 64);
+    ~StackPool();
+
+    StackPool(const StackPool &) = delete;
+    StackPool &operator=(const StackPool &) = delete;
+
+    /**
+     * Returns lowest address of the stack mapping (the guard page), stack itself spans
+     * [Acquire() + GuardSize(), Acquire() + MappingSize())
+     */
+    char *Acquire();
+
+    // Returns stack got from Acquire() back to the pool
+    void Release(char *stack);
+
+    // Takes stack acquired from the other pool, which could be used by another thread at the moment
+    void Adopt(char *stack, StackPool &owner);
+
+    // Unmaps all stacks kept in the pool
+    void Trim();
+
+    size_t StackSize() const { return _stack_size; }
+    size_t GuardSize() const { return _page_size; }
+    size_t MappingSize() const { return _stack_size + _page_size; }
+
+    // Stacks mapped now: in use and kept in the pool
+    size_t Mapped() const { return _mapped.load(std::memory_order_relaxed); }
+    size_t Idle() const { return _free.size(); }
+
+    // Idle stacks whose pages are given back to the system
+    size_t Discarded() const { return _discarded; }
+
+private:
+    size_t _page_size;
+    size_t _stack_size;
+    size_t _hot_stacks;
+    std::atomic<size_t> _mapped;
+
+    // Released stacks, the most recent one at the back
+    std::vector<char *> _free;
+
+    // Number of stacks at the front of _free which are discarded already
+    size_t _discarded;
+};
+
+} // namespace Coroutine
+} // namespace Afina
+
+#endif // AFINA_COROUTINE_STACK_POOL_H
@@ -0,0 +1,123 @@
+#ifndef AFINA_COROUTINE_SYNC_H
+#define AFINA_COROUTINE_SYNC_H
+
+#include <cstddef>
+
+#include "../core/SpinLock.h"
+#include "Engine.h"
+
+namespace Afina {
+namespace Coroutine {
+
+/**
+ * # Routines parked on a synchronization primitive
+ * FIFO of waiters, each waiter lives on the stack of its parked routine, so waiting allocates nothing.
+ * Protected by the lock of the primitive
+ */
+class WaitQueue {
+public:
+    struct Waiter {
+        void *routine;
+        Waiter *next;
+
+        // Primitive specific: channel passes pointer to the value and tells routine if operation succeeded
+        void *data;
+        bool result;
+
+        explicit Waiter(void *data_p = nullptr);
+    };
+
+    WaitQueue() : _head(nullptr), _tail(nullptr) {}
+
+    bool Empty() const { return _head == nullptr; }
+    void Push(Waiter *waiter);
+    Waiter *Pop();
+
+    /**
+     * Puts current routine into the queue and parks it, lock must be held by the caller and is released. Once
+     * waiter is popped and unparked, routine continues without the lock. Must be called from a coroutine of
+     * separate stack mode engine or scheduler
+     */
+    static void Wait(Core::SpinLock &lock, WaitQueue &queue, Waiter &waiter);
+
+private:
+    Waiter *_head;
+    Waiter *_tail;
+};
+
+/**
+ * # Coroutine mutex
+ * Routine waiting for the mutex is parked and takes no CPU time. Ownership is handed over to the waiters in FIFO
+ * order, so the mutex is fair. Could be unlocked by any thread, including ones without engine
+ */
+class Mutex {
+public:
+    Mutex() : _locked(false) {}
+
+    Mutex(const Mutex &) = delete;
+    Mutex &operator=(const Mutex &) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+private:
+    Core::SpinLock _guard;
+    bool _locked;
+    WaitQueue _waiters;
+};
+
+/**
+ * # Coroutine condition variable
+ * Works together with Mutex. Notification without waiters is lost, so the condition must be checked under the
+ * mutex, the same way as with std::condition_variable. There are no spurious wake ups
+ */
+class ConditionVariable {
+public:
+    ConditionVariable() {}
+
+    ConditionVariable(const ConditionVariable &) = delete;
+    ConditionVariable &operator=(const ConditionVariable &) = delete;
+
+    // mutex must be locked by the caller, it is unlocked while routine waits
+    void wait(Mutex &mutex);
+
+    template <typename Predicate> void wait(Mutex &mutex, Predicate predicate) {
+        while (!predicate()) {
+            wait(mutex);
+        }
+    }
+
+    void notify_one();
+    void notify_all();
+
+private:
+    Core::SpinLock _guard;
+    WaitQueue _waiters;
+};
+
+/**
+ * # Coroutine counting semaphore
+ * Released units go to the waiters first in FIFO order
+ */
+class Semaphore {
+public:
+    explicit Semaphore(size_t count = 0) : _count(count) {}
+
+    Semaphore(const Semaphore &) = delete;
+    Semaphore &operator=(const Semaphore &) = delete;
+
+    void acquire();
+    bool try_acquire();
+    void release(size_t count = 1);
+
+private:
+    Core::SpinLock _guard;
+    size_t _count;
+    WaitQueue _waiters;
+};
+
+} // namespace Coroutine
+} // namespace Afina
+
+#endif // AFINA_COROUTINE_SYNC_H
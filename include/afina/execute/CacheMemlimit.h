@@ -0,0 +1,41 @@
+#ifndef AFINA_EXECUTE_CACHE_MEMLIMIT_H
+#define AFINA_EXECUTE_CACHE_MEMLIMIT_H
+
+#include <cstdint>
+#include <string>
+
+#include "Command.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Change memory limit of the storage
+ * Admin command "cache_memlimit <megabytes> [noreply]" resizes the cache without restart. Growing takes effect
+ * immediately, on shrinking least recently used items are evicted in the background, see Storage::SetMaxMemoryLimit.
+ * Memory pressure monitor keeps budget of the storage under the new limit
+ *
+ * Command must write result to the output, which could be:
+ * - "OK" to indicate success
+ * - "MEMLIMIT_TOO_SMALL" if the limit is below 1 megabyte
+ * - "CLIENT_ERROR" if the limit in bytes doesn't fit size_t
+ * - "SERVER_ERROR ..." if storage could not be resized
+ */
+class CacheMemlimit : public Command {
+private:
+    uint64_t _megabytes;
+
+public:
+    CacheMemlimit() : _megabytes(0) {}
+
+    bool ExtractArguments(std::string &args_str) override;
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) const override;
+
+    uint64_t megabytes() const { return _megabytes; }
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_CACHE_MEMLIMIT_H
@@ -1,7 +1,9 @@
 #ifndef AFINA_NETWORK_SERVER_H
 #define AFINA_NETWORK_SERVER_H
 
+#include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace Afina {
@@ -40,6 +42,14 @@ public:
      */
     virtual void Join() = 0;
 
+    /**
+     * Appends server specific statistics to the given map, such as state of the thread pool running connections
+     * or commands. Names follow the same conventions as Storage::GetStatistics
+     *
+     * @param stats output parameter to add statistics to
+     */
+    virtual void GetStatistics(std::map<std::string, std::string> & /* stats */) {}
+
 protected:
     /**
      * Instance of backing storeage on which current server should execute
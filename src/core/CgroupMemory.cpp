@@ -0,0 +1,135 @@
+#include "CgroupMemory.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Core {
+
+CgroupMemory::CgroupMemory() {
+    // Line of mountinfo: id parent major:minor root mount_point options [optional fields] - fstype source options
+    std::ifstream mountinfo("/proc/self/mountinfo");
+    std::string line;
+    while (_root.empty() && std::getline(mountinfo, line)) {
+        std::stringstream stream(line);
+        std::string field;
+        std::vector<std::string> fields;
+        while (stream >> field) {
+            fields.push_back(field);
+        }
+
+        auto separator = std::find(fields.begin(), fields.end(), "-");
+        if (fields.size() > 4 && separator != fields.end() && separator + 1 != fields.end() &&
+            *(separator + 1) == "cgroup2") {
+            _root = fields[4];
+        }
+    }
+
+    // Line of cgroup v2 hierarchy is "0::/path"
+    std::ifstream cgroup("/proc/self/cgroup");
+    while (!_root.empty() && std::getline(cgroup, line)) {
+        if (line.compare(0, 3, "0::") == 0) {
+            _path = _root + line.substr(3);
+            break;
+        }
+    }
+
+    while (_path.size() > 1 && _path.back() == '/') {
+        _path.pop_back();
+    }
+    CURRENT_PROCESS_DEBUG("cgroup: " << (IsAvailable() ? _path : "memory controller is not available"));
+}
+
+CgroupMemory::CgroupMemory(const std::string &path) : _path(path), _root(path) {}
+
+bool CgroupMemory::_ReadValue(const std::string &file, size_t &value) {
+    std::ifstream input(file);
+    std::string word;
+    if (!(input >> word)) {
+        return false;
+    }
+
+    if (word == "max") {
+        value = unlimited;
+    } else {
+        value = std::stoull(word);
+    }
+    return true;
+}
+
+bool CgroupMemory::IsAvailable() const {
+    size_t value;
+    return !_path.empty() && _ReadValue(_path + "/memory.current", value);
+}
+
+size_t CgroupMemory::Current() const {
+    size_t value = 0;
+    _ReadValue(_path + "/memory.current", value);
+    return value;
+}
+
+size_t CgroupMemory::InactiveFile() const {
+    std::ifstream stat(_path + "/memory.stat");
+    std::string name;
+    size_t value;
+    while (stat >> name >> value) {
+        if (name == "inactive_file") {
+            return value;
+        }
+    }
+    return 0;
+}
+
+size_t CgroupMemory::Limit() const {
+    size_t result = unlimited;
+    std::string path = _path;
+    while (!path.empty()) {
+        size_t value;
+        if (_ReadValue(path + "/memory.max", value)) {
+            result = std::min(result, value);
+        }
+        if (_ReadValue(path + "/memory.high", value)) {
+            result = std::min(result, value);
+        }
+
+        if (path.size() <= _root.size()) {
+            break;
+        }
+        path.resize(path.rfind('/'));
+    }
+    return result;
+}
+
+double CgroupMemory::Pressure() const {
+    // First line: some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    std::ifstream pressure(_path + "/memory.pressure");
+    std::string kind, avg10;
+    if (!(pressure >> kind >> avg10) || kind != "some" || avg10.compare(0, 6, "avg10=") != 0) {
+        return -1;
+    }
+    return std::stod(avg10.substr(6));
+}
+
+int CgroupMemory::OpenPressureTrigger(size_t stall_us, size_t window_us) const {
+    int fd = open((_path + "/memory.pressure").c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // Trigger is registered by writing its definition including terminating zero
+    std::string trigger = "some " + std::to_string(stall_us) + " " + std::to_string(window_us);
+    if (write(fd, trigger.c_str(), trigger.size() + 1) < 0) {
+        CURRENT_PROCESS_DEBUG("PSI trigger is not available: " << std::strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+} // namespace Core
+} // namespace Afina
@@ -0,0 +1,68 @@
+#ifndef AFINA_CGROUP_MEMORY_H
+#define AFINA_CGROUP_MEMORY_H
+
+#include <cstddef>
+#include <string>
+
+#include <afina/core/Debug.h>
+
+namespace Afina {
+namespace Core {
+
+/**
+ * # Memory controller of cgroup v2
+ * Reads memory accounting of the cgroup the process belongs to. Files are read on every call, nothing is cached,
+ * so values are always up to date. If process is not in cgroup v2 with memory controller enabled then
+ * IsAvailable() returns false and limits are reported as unlimited
+ */
+class CgroupMemory {
+public:
+    static const size_t unlimited = static_cast<size_t>(-1);
+
+    // Finds cgroup of the current process through /proc/self/mountinfo and /proc/self/cgroup
+    CgroupMemory();
+
+    // Uses given cgroup directory, its parents are not taken into account
+    explicit CgroupMemory(const std::string &path);
+
+    bool IsAvailable() const;
+    const std::string &Path() const { return _path; }
+
+    // memory.current: all memory charged to the cgroup, including page cache
+    size_t Current() const;
+
+    // inactive_file from memory.stat: page cache kernel reclaims first, 0 if not available
+    size_t InactiveFile() const;
+
+    /**
+     * The lowest of memory.max and memory.high over the cgroup and its parents, that is the point
+     * where kernel starts to throttle or kill the process. unlimited if there are no limits
+     */
+    size_t Limit() const;
+
+    /**
+     * "some avg10" from memory.pressure: percentage of the last 10 seconds some tasks were stalled
+     * waiting for memory. Negative if PSI is not available
+     */
+    double Pressure() const;
+
+    /**
+     * Registers PSI trigger: returned descriptor gets POLLPRI once tasks of the cgroup are stalled
+     * for more then stall_us during window_us. Caller owns descriptor. Returns -1 if triggers are not
+     * supported or not permitted
+     */
+    int OpenPressureTrigger(size_t stall_us, size_t window_us) const;
+
+private:
+    // Directory of the cgroup and mount point of cgroup2 filesystem, the last one is not looked above
+    std::string _path;
+    std::string _root;
+
+    // Reads the first word of the file, "max" is returned as unlimited. false if file can't be read
+    static bool _ReadValue(const std::string &file, size_t &value);
+};
+
+} // namespace Core
+} // namespace Afina
+
+#endif // AFINA_CGROUP_MEMORY_H
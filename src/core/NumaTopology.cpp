@@ -0,0 +1,143 @@
+#include "NumaTopology.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Memory policies from linux/mempolicy.h, libnuma is not required
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+
+namespace Afina {
+namespace Core {
+
+const NumaTopology &NumaTopology::Instance() {
+    static NumaTopology topology;
+    return topology;
+}
+
+NumaTopology::NumaTopology() {
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string nodes_list;
+    if (online.is_open() && std::getline(online, nodes_list)) {
+        for (int id : ParseList(nodes_list)) {
+            std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string cpus;
+            std::getline(cpulist, cpus);
+
+            _node_ids.push_back(id);
+            _cpus.push_back(ParseList(cpus));
+        }
+    }
+
+    if (_node_ids.empty()) { // No sysfs: all CPUs on the single node
+        _node_ids.push_back(0);
+        _cpus.emplace_back();
+        for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_ONLN); cpu++) {
+            _cpus.back().push_back(cpu);
+        }
+    }
+
+    CURRENT_PROCESS_DEBUG("NUMA nodes found: " << _node_ids.size());
+}
+
+std::vector<int> NumaTopology::ParseList(const std::string &list) {
+    std::vector<int> result;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.find_first_not_of(" \t\r\n") == std::string::npos) {
+            continue;
+        }
+
+        size_t dash = range.find('-');
+        int from = std::stoi(range.substr(0, dash));
+        int to = (dash == std::string::npos) ? from : std::stoi(range.substr(dash + 1));
+        for (int i = from; i <= to; i++) {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+bool NumaTopology::PinCurrentThread(size_t node) const {
+    if (!IsNuma()) {
+        return false;
+    }
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int cpu : Cpus(node)) {
+        CPU_SET(cpu, &cpuset);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0;
+}
+
+bool NumaTopology::PinCurrentThreadToCpu(int cpu) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0;
+}
+
+std::vector<int> NumaTopology::AllowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (sched_getaffinity(0, sizeof(cpuset), &cpuset) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &cpuset)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    if (cpus.empty()) {
+        for (long cpu = 0; cpu < sysconf(_SC_NPROCESSORS_ONLN); cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+bool NumaTopology::BindMemory(void *addr, size_t len, size_t node) const {
+    if (!IsNuma()) {
+        return false;
+    }
+    return _SetPolicy(addr, len, MPOL_BIND, std::vector<int>(1, _node_ids.at(node)));
+}
+
+bool NumaTopology::InterleaveMemory(void *addr, size_t len) const {
+    if (!IsNuma()) {
+        return false;
+    }
+    return _SetPolicy(addr, len, MPOL_INTERLEAVE, _node_ids);
+}
+
+bool NumaTopology::_SetPolicy(void *addr, size_t len, int policy, const std::vector<int> &node_ids) const {
+    const size_t bits_per_word = sizeof(unsigned long) * 8;
+    int max_id = *std::max_element(_node_ids.begin(), _node_ids.end());
+    std::vector<unsigned long> mask(max_id / bits_per_word + 1, 0);
+    for (int id : node_ids) {
+        mask[id / bits_per_word] |= 1UL << (id % bits_per_word);
+    }
+
+    // Kernel reads maxnode - 1 bits of the mask
+    long result = syscall(SYS_mbind, addr, len, policy, mask.data(), mask.size() * bits_per_word + 1, 0);
+    if (result != 0) {
+        CURRENT_PROCESS_DEBUG("mbind failed: " << std::strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+} // namespace Core
+} // namespace Afina
@@ -0,0 +1,77 @@
+#ifndef AFINA_NUMA_TOPOLOGY_H
+#define AFINA_NUMA_TOPOLOGY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <afina/core/Debug.h>
+
+namespace Afina {
+namespace Core {
+
+/**
+ * # NUMA nodes of the machine
+ * Topology is read once from sysfs (/sys/devices/system/node). If it is not available then machine
+ * is considered to be a single node one and all methods changing placement are no-op.
+ *
+ * Nodes are addressed by index in [0, NodesCount()), not by kernel node id (they could be sparse)
+ */
+class NumaTopology {
+public:
+    static const NumaTopology &Instance();
+
+    size_t NodesCount() const { return _node_ids.size(); }
+    bool IsNuma() const { return _node_ids.size() > 1; }
+
+    // CPUs belonging to the node
+    const std::vector<int> &Cpus(size_t node) const { return _cpus.at(node); }
+
+    /**
+     * Pins calling thread to CPUs of the node, so memory it touches first is allocated locally. Returns false
+     * if machine has the only node (nothing to do) or kernel refuses affinity change
+     */
+    bool PinCurrentThread(size_t node) const;
+
+    /**
+     * Pins calling thread to the single CPU. Returns false if kernel refuses affinity change
+     */
+    static bool PinCurrentThreadToCpu(int cpu);
+
+    /**
+     * CPUs the process is allowed to run on (a container could be limited to a part of them), ascending. If kernel
+     * doesn't tell, all online CPUs
+     */
+    static std::vector<int> AllowedCpus();
+
+    /**
+     * Asks kernel to allocate not yet touched pages of the region on the given node. Region must be page aligned.
+     * Returns false on single node machine or if mbind fails
+     */
+    bool BindMemory(void *addr, size_t len, size_t node) const;
+
+    /**
+     * Asks kernel to interleave not yet touched pages of the region over all nodes, that is the best placement for
+     * data shared by threads of all nodes. Returns false on single node machine or if mbind fails
+     */
+    bool InterleaveMemory(void *addr, size_t len) const;
+
+    /**
+     * Parses sysfs lists like "0-3,8,10-11", empty list or trailing newline give no ids. Throws
+     * std::invalid_argument on malformed list
+     */
+    static std::vector<int> ParseList(const std::string &list);
+
+private:
+    NumaTopology();
+
+    bool _SetPolicy(void *addr, size_t len, int policy, const std::vector<int> &node_ids) const;
+
+    std::vector<int> _node_ids;
+    std::vector<std::vector<int>> _cpus;
+};
+
+} // namespace Core
+} // namespace Afina
+
+#endif // AFINA_NUMA_TOPOLOGY_H
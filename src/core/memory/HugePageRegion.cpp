@@ -0,0 +1,229 @@
+#include "HugePageRegion.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+namespace Afina {
+namespace Core {
+
+static const size_t _huge_2mb = size_t(2) << 20;
+static const size_t _huge_1gb = size_t(1) << 30;
+
+static size_t _RoundUp(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+HugePageRegion::HugePageRegion(size_t size, HugePagesMode mode) : _base(nullptr), _size(0), _mode(mode) {
+    if (size == 0) {
+        throw std::invalid_argument("HugePageRegion cannot be empty");
+    }
+
+    if (mode == HugePagesMode::Explicit1GB || mode == HugePagesMode::Explicit2MB) {
+        _size = _RoundUp(size, PageSize(mode));
+        _base = _MapExplicit(_size, mode);
+        if (_base == nullptr && mode == HugePagesMode::Explicit1GB) {
+            CURRENT_PROCESS_DEBUG("No free 1GB huge pages, falling back to 2MB pages");
+            _mode = mode = HugePagesMode::Explicit2MB;
+            _size = _RoundUp(size, PageSize(mode));
+            _base = _MapExplicit(_size, mode);
+        }
+        if (_base == nullptr) {
+            CURRENT_PROCESS_DEBUG("No free explicit huge pages, falling back to transparent huge pages");
+            _mode = mode = HugePagesMode::Transparent;
+        }
+    }
+
+    if (_base == nullptr && mode == HugePagesMode::Transparent) {
+        bool advised = false;
+        _size = _RoundUp(size, _huge_2mb);
+        _base = _MapTransparent(_size, advised);
+        if (!advised) {
+            CURRENT_PROCESS_DEBUG("Transparent huge pages are disabled, region uses regular pages");
+            _mode = HugePagesMode::None;
+        }
+    }
+
+    if (_base == nullptr) {
+        _mode = HugePagesMode::None;
+        _size = _RoundUp(size, PageSize(_mode));
+        void *result = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        VALIDATE_CONDITION(result != MAP_FAILED);
+        _base = result;
+    }
+}
+
+HugePageRegion::~HugePageRegion() { _Release(); }
+
+HugePageRegion::HugePageRegion(HugePageRegion &&other) : _base(other._base), _size(other._size), _mode(other._mode) {
+    other._base = nullptr;
+    other._size = 0;
+}
+
+HugePageRegion &HugePageRegion::operator=(HugePageRegion &&other) {
+    if (this != &other) {
+        _Release();
+        _base = other._base;
+        _size = other._size;
+        _mode = other._mode;
+
+        other._base = nullptr;
+        other._size = 0;
+    }
+    return *this;
+}
+
+void HugePageRegion::_Release() {
+    if (_base != nullptr) {
+        VALIDATE_SYSTEM_FUNCTION(munmap(_base, _size));
+        _base = nullptr;
+        _size = 0;
+    }
+}
+
+void *HugePageRegion::_MapExplicit(size_t size, HugePagesMode mode) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+    flags |= (mode == HugePagesMode::Explicit1GB) ? MAP_HUGE_1GB : MAP_HUGE_2MB;
+
+    void *result = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (result == MAP_FAILED) {
+        return nullptr;
+    }
+    return result;
+}
+
+void *HugePageRegion::_MapTransparent(size_t size, bool &advised) {
+    // Kernel collapses only 2MB aligned ranges, so map more and trim unaligned head and tail
+    size_t mapped_size = size + _huge_2mb;
+    void *mapped = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    VALIDATE_CONDITION(mapped != MAP_FAILED);
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(mapped);
+    uintptr_t aligned = _RoundUp(start, _huge_2mb);
+    if (aligned != start) {
+        VALIDATE_SYSTEM_FUNCTION(munmap(mapped, aligned - start));
+    }
+    size_t tail = (start + mapped_size) - (aligned + size);
+    if (tail != 0) {
+        VALIDATE_SYSTEM_FUNCTION(munmap(reinterpret_cast<void *>(aligned + size), tail));
+    }
+
+    void *result = reinterpret_cast<void *>(aligned);
+    advised = (madvise(result, size, MADV_HUGEPAGE) == 0);
+    return result;
+}
+
+size_t HugePageRegion::HugeBytes() const {
+    HugePageUsage usage;
+    usage.Add(*this);
+    return usage.Bytes();
+}
+
+size_t HugePageRegion::PageSize(HugePagesMode mode) {
+    switch (mode) {
+    case HugePagesMode::Explicit1GB:
+        return _huge_1gb;
+    case HugePagesMode::Explicit2MB:
+    case HugePagesMode::Transparent:
+        return _huge_2mb;
+    default:
+        return sysconf(_SC_PAGESIZE);
+    }
+}
+
+HugePagesMode HugePageRegion::ParseMode(const std::string &name) {
+    if (name == "none") {
+        return HugePagesMode::None;
+    } else if (name == "thp") {
+        return HugePagesMode::Transparent;
+    } else if (name == "2mb") {
+        return HugePagesMode::Explicit2MB;
+    } else if (name == "1gb") {
+        return HugePagesMode::Explicit1GB;
+    }
+    throw std::invalid_argument("Unknown huge pages mode: " + name);
+}
+
+std::string HugePageRegion::ModeName(HugePagesMode mode) {
+    switch (mode) {
+    case HugePagesMode::Transparent:
+        return "thp";
+    case HugePagesMode::Explicit2MB:
+        return "2mb";
+    case HugePagesMode::Explicit1GB:
+        return "1gb";
+    default:
+        return "none";
+    }
+}
+
+void HugePageUsage::Add(const HugePageRegion &region) {
+    if (region.Get() == nullptr || region.GetMode() == HugePagesMode::None) {
+        return;
+    }
+    if (region.GetMode() != HugePagesMode::Transparent) {
+        _explicit_bytes += region.Size();
+        return;
+    }
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(region.Get());
+    _transparent.emplace_back(start, start + region.Size());
+}
+
+size_t HugePageUsage::Bytes() const {
+    if (_transparent.empty()) {
+        return _explicit_bytes;
+    }
+
+    std::ifstream smaps("/proc/self/smaps");
+    if (!smaps.is_open()) {
+        return _explicit_bytes;
+    }
+
+    // Regions don't intersect, so once sorted by start they are sorted by end as well
+    std::vector<std::pair<uintptr_t, uintptr_t>> regions(_transparent);
+    std::sort(regions.begin(), regions.end());
+
+    // Sum AnonHugePages of all mappings intersecting regions. Mapping could be merged with the
+    // neighbour one, so result is limited by intersection size
+    size_t result = _explicit_bytes;
+    size_t overlap = 0;
+    std::string line;
+    while (std::getline(smaps, line)) {
+        unsigned long vma_start = 0, vma_end = 0;
+        if (std::sscanf(line.c_str(), "%lx-%lx ", &vma_start, &vma_end) == 2) {
+            overlap = 0;
+            auto it = std::lower_bound(regions.begin(), regions.end(), uintptr_t(vma_start),
+                                       [](const std::pair<uintptr_t, uintptr_t> &region, uintptr_t address) {
+                                           return region.second <= address;
+                                       });
+            for (; it != regions.end() && it->first < vma_end; ++it) {
+                overlap += std::min<uintptr_t>(vma_end, it->second) - std::max<uintptr_t>(vma_start, it->first);
+            }
+            continue;
+        }
+
+        size_t kbytes = 0;
+        if (overlap != 0 && std::sscanf(line.c_str(), "AnonHugePages: %zu kB", &kbytes) == 1) {
+            result += std::min(kbytes * 1024, overlap);
+        }
+    }
+
+    return result;
+}
+
+} // namespace Core
+} // namespace Afina
@@ -0,0 +1,99 @@
+#ifndef AFINA_HUGE_PAGE_REGION_H
+#define AFINA_HUGE_PAGE_REGION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <afina/core/Debug.h>
+
+namespace Afina {
+namespace Core {
+
+/**
+ * Kind of pages the memory region should be backed with. Explicit modes use hugetlbfs pages (MAP_HUGETLB) that
+ * must be reserved by administrator (vm.nr_hugepages), transparent mode asks kernel to collapse region into huge
+ * pages (madvise(MADV_HUGEPAGE))
+ */
+enum class HugePagesMode { None, Transparent, Explicit2MB, Explicit1GB };
+
+/**
+ * # Anonymous memory region, possibly backed by huge pages
+ * Region tries requested mode and falls back to the weaker one if kernel refuses it:
+ * 1GB/2MB explicit pages -> transparent huge pages -> regular pages. Mode that was actually used
+ * could be checked by GetMode()
+ */
+class HugePageRegion {
+public:
+    // size is rounded up to the page size of requested mode
+    HugePageRegion(size_t size, HugePagesMode mode);
+    ~HugePageRegion();
+
+    // No-copiable
+    HugePageRegion(const HugePageRegion &) = delete;
+    HugePageRegion &operator=(const HugePageRegion &) = delete;
+
+    // Movable
+    HugePageRegion(HugePageRegion &&other);
+    HugePageRegion &operator=(HugePageRegion &&other);
+
+    void *Get() const { return _base; }
+    size_t Size() const { return _size; }
+
+    // Mode that was actually applied to the region (after all fallbacks)
+    HugePagesMode GetMode() const { return _mode; }
+
+    /**
+     * Returns count of bytes of the region which are really backed by huge pages now. For explicit modes it is
+     * the whole region, for transparent mode kernel statistics (/proc/self/smaps) is used, so method is slow
+     */
+    size_t HugeBytes() const;
+
+    // Size of the page for mode (4K for HugePagesMode::None)
+    static size_t PageSize(HugePagesMode mode);
+
+    // Converts "none", "thp", "2mb", "1gb" strings to mode. Throws std::invalid_argument for unknown name
+    static HugePagesMode ParseMode(const std::string &name);
+    static std::string ModeName(HugePagesMode mode);
+
+private:
+    void *_base;
+    size_t _size;
+    HugePagesMode _mode;
+
+    void _Release();
+
+    // Maps region with explicit huge pages, returns nullptr if kernel has no free huge pages
+    static void *_MapExplicit(size_t size, HugePagesMode mode);
+    // Maps region aligned to the 2MB boundary and marks it with MADV_HUGEPAGE
+    static void *_MapTransparent(size_t size, bool &advised);
+};
+
+/**
+ * # Huge pages of a set of regions
+ * Regions are collected first and then counted by a single pass over kernel statistics. Only address ranges are
+ * kept, so regions could be collected under a lock and counted after it is released, while regions are alive
+ */
+class HugePageUsage {
+public:
+    HugePageUsage() : _explicit_bytes(0) {}
+
+    void Add(const HugePageRegion &region);
+
+    // Sum of HugePageRegion::HugeBytes over all added regions, slow if some of them are in transparent mode
+    size_t Bytes() const;
+
+private:
+    // Regions with explicit huge pages are backed by them entirely
+    size_t _explicit_bytes;
+
+    // [start, end) of regions in transparent mode
+    std::vector<std::pair<uintptr_t, uintptr_t>> _transparent;
+};
+
+} // namespace Core
+} // namespace Afina
+
+#endif // AFINA_HUGE_PAGE_REGION_H
@@ -0,0 +1,89 @@
+#include "SlabPool.h"
+
+#include <algorithm>
+
+#include "./../NumaTopology.h"
+
+namespace Afina {
+namespace Core {
+
+static const size_t _min_slab_size = size_t(2) << 20;
+
+SlabPool::SlabPool(size_t object_size, const MemoryPlacement &placement, size_t slab_size)
+    : _mode(placement.hugepages), _numa_interleave(placement.numa_interleave), _bump(nullptr), _bump_end(nullptr),
+      _free_list(nullptr), _used(0) {
+    // Each object must be able to hold free list node and keep alignment of the next one
+    const size_t alignment = alignof(std::max_align_t);
+    _object_size = std::max(object_size, sizeof(FreeNode));
+    _object_size = (_object_size + alignment - 1) / alignment * alignment;
+
+    if (slab_size == 0) {
+        slab_size = std::max(HugePageRegion::PageSize(_mode), _min_slab_size);
+    }
+    _slab_size = std::max(slab_size, _object_size);
+}
+
+void *SlabPool::Allocate() {
+    void *result = nullptr;
+    if (_free_list != nullptr) {
+        result = _free_list;
+        _free_list = _free_list->next;
+    } else {
+        if (_bump + _object_size > _bump_end) {
+            _AddSlab();
+        }
+        result = _bump;
+        _bump += _object_size;
+    }
+
+    ++_used;
+    return result;
+}
+
+void SlabPool::Free(void *object) {
+    if (object == nullptr) {
+        return;
+    }
+
+    FreeNode *node = static_cast<FreeNode *>(object);
+    node->next = _free_list;
+    _free_list = node;
+    --_used;
+}
+
+void SlabPool::_AddSlab() {
+    std::unique_lock<std::mutex> lock(_slabs_mutex);
+    _slabs.emplace_back(_slab_size, _mode);
+    lock.unlock();
+
+    // Kernel could refuse huge pages, then keep asking only for what it has given
+    _mode = _slabs.back().GetMode();
+    _slab_size = _slabs.back().Size();
+
+    // Policy must be set before the first touch of the slab pages
+    if (_numa_interleave) {
+        _numa_interleave = NumaTopology::Instance().InterleaveMemory(_slabs.back().Get(), _slab_size);
+    }
+
+    _bump = static_cast<char *>(_slabs.back().Get());
+    _bump_end = _bump + _slab_size;
+}
+
+size_t SlabPool::MappedBytes() const {
+    std::lock_guard<std::mutex> lock(_slabs_mutex);
+    size_t result = 0;
+    for (auto &slab : _slabs) {
+        result += slab.Size();
+    }
+    return result;
+}
+
+void SlabPool::GetHugePageUsage(HugePageUsage &usage) const {
+    std::lock_guard<std::mutex> lock(_slabs_mutex);
+    for (auto &slab : _slabs) {
+        usage.Add(slab);
+    }
+}
+
+} // namespace Core
+} // namespace Afina
@@ -0,0 +1,94 @@
+#ifndef AFINA_SLAB_POOL_H
+#define AFINA_SLAB_POOL_H
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "HugePageRegion.h"
+
+namespace Afina {
+namespace Core {
+
+/**
+ * Where memory of the pool should be placed
+ */
+struct MemoryPlacement {
+    // Pages to back memory with
+    HugePagesMode hugepages;
+
+    // Spread pages over all NUMA nodes. Useful for data shared by threads of all nodes, no-op on a single node box
+    bool numa_interleave;
+
+    MemoryPlacement(HugePagesMode hugepages_p = HugePagesMode::None, bool numa_interleave_p = false)
+        : hugepages(hugepages_p), numa_interleave(numa_interleave_p) {}
+};
+
+/**
+ * # Pool of fixed size objects
+ * Carves objects out of big regions (slabs) that could be backed by huge pages, so objects that
+ * are accessed together share a few TLB entries. Freed objects are kept in the intrusive free list
+ * and reused, memory is returned to the system only on pool destruction.
+ *
+ * Not threadsafe, except for MappedBytes and GetHugePageUsage, which could be called while pool is used
+ */
+class SlabPool {
+public:
+    // slab_size = 0 means page size of the requested huge pages mode (but not less then 2MB)
+    SlabPool(size_t object_size, const MemoryPlacement &placement = MemoryPlacement(), size_t slab_size = 0);
+    ~SlabPool() {}
+
+    SlabPool(const SlabPool &) = delete;
+    SlabPool &operator=(const SlabPool &) = delete;
+
+    // Returns uninitialized memory for a single object
+    void *Allocate();
+
+    // Returns memory got from Allocate() back to the pool
+    void Free(void *object);
+
+    size_t ObjectSize() const { return _object_size; }
+
+    // Count of objects allocated now
+    size_t Used() const { return _used; }
+
+    // Bytes mapped for all slabs
+    size_t MappedBytes() const;
+
+    // Adds slabs to usage, bytes that are really backed by huge pages are counted by HugePageUsage::Bytes later
+    void GetHugePageUsage(HugePageUsage &usage) const;
+
+    // Mode that was applied to the last slab (kernel could refuse huge pages at any time)
+    HugePagesMode GetMode() const { return _mode; }
+
+    bool IsNumaInterleaved() const { return _numa_interleave; }
+
+private:
+    struct FreeNode {
+        FreeNode *next;
+    };
+
+    size_t _object_size;
+    size_t _slab_size;
+    HugePagesMode _mode;
+    bool _numa_interleave;
+
+    std::vector<HugePageRegion> _slabs;
+
+    // Guards _slabs against reading by statistics while new slab is added
+    mutable std::mutex _slabs_mutex;
+
+    // Not yet used tail of the last slab
+    char *_bump;
+    char *_bump_end;
+
+    FreeNode *_free_list;
+    size_t _used;
+
+    void _AddSlab();
+};
+
+} // namespace Core
+} // namespace Afina
+
+#endif // AFINA_SLAB_POOL_H
@@ -0,0 +1,270 @@
+#ifndef AFINA_FLAT_COMBINED_H
+#define AFINA_FLAT_COMBINED_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "FlatCombiner.hpp"
+
+namespace Afina {
+namespace Core {
+
+/**
+ * # Base of containers protected by flat combiner
+ * Threads publish operations in their slots, and whoever takes the combiner lock applies all pending ones in a
+ * single pass while the container stays in its cache. Derived class applies an operation in _Apply(). Operations
+ * refer to arguments and results of the calling thread by pointers, which stay valid while the thread waits, so
+ * values aren't copied through the slot and could be move-only.
+ *
+ * Operations keep the order they were published in: combiner doesn't sort them
+ */
+template <typename Operation> class _FlatCombined {
+public:
+    _FlatCombined() : _combiner(std::bind(&_FlatCombined::_Combine, this, std::placeholders::_1), 100000, false) {}
+    virtual ~_FlatCombined() { _combiner.DestroyCombiner(); }
+
+    _FlatCombined(const _FlatCombined &) = delete;
+    _FlatCombined &operator=(const _FlatCombined &) = delete;
+
+protected:
+    typedef FlatCombiner<Operation> Combiner;
+
+    // Applies operation to the container, called by the combining thread
+    virtual void _Apply(Operation &operation) = 0;
+
+    // Passes operation to the combiner and waits until it is applied, rethrows exception of _Apply()
+    Operation _Perform(const Operation &operation) {
+        typename Combiner::OperationWrapperPtr slot = _combiner.GetThreadSlotOperation();
+        slot->SetOperation(operation);
+        _combiner.ApplyThreadSlot();
+        if (slot->GetException() != nullptr) {
+            std::rethrow_exception(slot->GetException());
+        }
+        return slot->GetData();
+    }
+
+private:
+    void _Combine(typename Combiner::FlatCombinerShotArrayType &shot) {
+        for (typename Combiner::OperationWrapperPtr operation : shot) {
+            if (operation == nullptr) {
+                break;
+            }
+
+            std::exception_ptr error = nullptr;
+            try {
+                _Apply(operation->GetData());
+            } catch (...) {
+                error = std::current_exception();
+            }
+            operation->OnExecutionComplete(error);
+        }
+    }
+
+    Combiner _combiner;
+};
+
+// Operation of a container, FlatCombiner needs operator< even if it doesn't sort
+template <typename Kind, typename Value> struct _ContainerOperation {
+    Kind kind;
+    Value *value;
+    const Value *bound;
+    std::vector<Value> *values;
+    bool result;
+
+    bool operator<(const _ContainerOperation &) const { return false; }
+};
+
+enum class _QueueOperationKind { kPush, kPop, kPopBefore };
+
+/**
+ * # FIFO queue protected by flat combiner
+ * Alternative to a queue under mutex with many producers and consumers, such as task queue of a thread pool.
+ * T could be move-only
+ */
+template <typename T>
+class FlatCombinedQueue : private _FlatCombined<_ContainerOperation<_QueueOperationKind, T>> {
+public:
+    FlatCombinedQueue() : _size(0) {}
+
+    void Push(T &&value) { this->_Perform(_Operation(_QueueOperationKind::kPush, &value)); }
+    void Push(const T &value) { Push(T(value)); }
+
+    // Returns false if queue is empty, value is left untouched then
+    bool TryPop(T &value) { return this->_Perform(_Operation(_QueueOperationKind::kPop, &value)).result; }
+
+    // Approximate number of elements, doesn't go through the combiner
+    size_t Size() const { return _size.load(std::memory_order_relaxed); }
+
+private:
+    typedef _ContainerOperation<_QueueOperationKind, T> Operation;
+
+    static Operation _Operation(_QueueOperationKind kind, T *value) {
+        Operation operation = {kind, value, nullptr, nullptr, false};
+        return operation;
+    }
+
+    void _Apply(Operation &operation) override {
+        if (operation.kind == _QueueOperationKind::kPush) {
+            _queue.push_back(std::move(*operation.value));
+        } else if (!_queue.empty()) {
+            *operation.value = std::move(_queue.front());
+            _queue.pop_front();
+            operation.result = true;
+        }
+        _size.store(_queue.size(), std::memory_order_relaxed);
+    }
+
+    std::deque<T> _queue;
+    std::atomic<size_t> _size;
+};
+
+/**
+ * # Priority queue protected by flat combiner
+ * Top is the greatest element by Compare, as in std::priority_queue. PopBefore() takes all elements from the top
+ * down to the bound in one combiner pass: for a TTL queue ordered by the nearest deadline (std::greater on
+ * deadline) it takes everything expired by the given time
+ */
+template <typename T, typename Compare = std::less<T>>
+class FlatCombinedPriorityQueue : private _FlatCombined<_ContainerOperation<_QueueOperationKind, T>> {
+public:
+    explicit FlatCombinedPriorityQueue(const Compare &compare = Compare()) : _compare(compare), _size(0) {}
+
+    void Push(T &&value) { this->_Perform(_Operation(_QueueOperationKind::kPush, &value)); }
+    void Push(const T &value) { Push(T(value)); }
+
+    // Takes the top, returns false if queue is empty
+    bool TryPop(T &value) { return this->_Perform(_Operation(_QueueOperationKind::kPop, &value)).result; }
+
+    /**
+     * Appends to values elements which don't go after bound in the queue order, top first. Returns number of
+     * elements taken
+     */
+    size_t PopBefore(const T &bound, std::vector<T> &values) {
+        size_t before = values.size();
+        Operation operation = _Operation(_QueueOperationKind::kPopBefore, nullptr);
+        operation.bound = &bound;
+        operation.values = &values;
+        this->_Perform(operation);
+        return values.size() - before;
+    }
+
+    // Approximate number of elements, doesn't go through the combiner
+    size_t Size() const { return _size.load(std::memory_order_relaxed); }
+
+private:
+    typedef _ContainerOperation<_QueueOperationKind, T> Operation;
+
+    static Operation _Operation(_QueueOperationKind kind, T *value) {
+        Operation operation = {kind, value, nullptr, nullptr, false};
+        return operation;
+    }
+
+    void _Apply(Operation &operation) override {
+        switch (operation.kind) {
+        case _QueueOperationKind::kPush:
+            _heap.push_back(std::move(*operation.value));
+            std::push_heap(_heap.begin(), _heap.end(), _compare);
+            break;
+
+        case _QueueOperationKind::kPop:
+            if (!_heap.empty()) {
+                std::pop_heap(_heap.begin(), _heap.end(), _compare);
+                *operation.value = std::move(_heap.back());
+                _heap.pop_back();
+                operation.result = true;
+            }
+            break;
+
+        case _QueueOperationKind::kPopBefore:
+            while (!_heap.empty() && !_compare(_heap.front(), *operation.bound)) {
+                std::pop_heap(_heap.begin(), _heap.end(), _compare);
+                operation.values->push_back(std::move(_heap.back()));
+                _heap.pop_back();
+            }
+            break;
+        }
+        _size.store(_heap.size(), std::memory_order_relaxed);
+    }
+
+    Compare _compare;
+    std::vector<T> _heap;
+    std::atomic<size_t> _size;
+};
+
+enum class _StatisticsOperationKind { kAdd, kSet, kRead };
+
+struct _StatisticsOperation {
+    _StatisticsOperationKind kind;
+    const std::string *name;
+    int64_t value;
+    std::vector<std::pair<std::string, int64_t>> *counters;
+
+    bool operator<(const _StatisticsOperation &) const { return false; }
+};
+
+/**
+ * # Named counters shared by threads
+ * Registry of statistics updated from many threads at once, such as commands executed by network workers. Names
+ * follow Storage::GetStatistics conventions. Updates of different threads are applied by the combiner in one
+ * pass, instead of each thread taking a lock and pulling the map into its cache
+ */
+class FlatCombinedStatistics : private _FlatCombined<_StatisticsOperation> {
+public:
+    void Add(const std::string &name, int64_t delta = 1) {
+        _Perform(_Operation(_StatisticsOperationKind::kAdd, name, delta));
+    }
+
+    void Set(const std::string &name, int64_t value) {
+        _Perform(_Operation(_StatisticsOperationKind::kSet, name, value));
+    }
+
+    // Appends all counters to the map, names are given the prefix
+    void Append(std::map<std::string, std::string> &stats, const std::string &prefix = "") {
+        std::vector<std::pair<std::string, int64_t>> counters;
+        Operation operation = _Operation(_StatisticsOperationKind::kRead, prefix, 0);
+        operation.counters = &counters;
+        _Perform(operation);
+        for (auto &counter : counters) {
+            stats[prefix + counter.first] = std::to_string(counter.second);
+        }
+    }
+
+private:
+    typedef _StatisticsOperation Operation;
+
+    static Operation _Operation(_StatisticsOperationKind kind, const std::string &name, int64_t value) {
+        Operation operation = {kind, &name, value, nullptr};
+        return operation;
+    }
+
+    void _Apply(Operation &operation) override {
+        switch (operation.kind) {
+        case _StatisticsOperationKind::kAdd:
+            _counters[*operation.name] += operation.value;
+            break;
+
+        case _StatisticsOperationKind::kSet:
+            _counters[*operation.name] = operation.value;
+            break;
+
+        case _StatisticsOperationKind::kRead:
+            operation.counters->assign(_counters.begin(), _counters.end());
+            break;
+        }
+    }
+
+    std::map<std::string, int64_t> _counters;
+};
+
+} // namespace Core
+} // namespace Afina
+
+#endif // AFINA_FLAT_COMBINED_H
@@ -7,6 +7,13 @@
 #include <thread>
 #include <array>
 #include <algorithm>
+#include <cstdint>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <afina/core/SpinLock.h>
 
 #include "ThreadLocalPointer.hpp"
 
@@ -26,46 +33,92 @@ class FlatCombiner {
 		class OperationWrapper
 		{
 			private:
-				enum class State {
-					READY_FOR_EXECUTE,
-					EXECUTION,
-					COMPLETE
-				};
+				//State word is also a futex the owner thread sleeps on. PARKED bit is set on top of
+				//READY_FOR_EXECUTE or EXECUTION while the owner sleeps or is going to, COMPLETE clears it
+				static const uint32_t READY_FOR_EXECUTE = 0;
+				static const uint32_t EXECUTION = 1;
+				static const uint32_t COMPLETE = 2;
+				static const uint32_t PARKED = 4;
 
 			private:
-				std::atomic<State> _state;
+				std::atomic<uint32_t> _state;
 				std::exception_ptr _exc;
 				T _data_for_operation;
 
+				//Number of parked owners of the combiner, it runs one more pass while there are any
+				std::atomic<int32_t>* _parked;
+
 			public:
-				OperationWrapper() : _state(State::COMPLETE), _exc(nullptr) {}
+				explicit OperationWrapper(std::atomic<int32_t>* parked = nullptr) : _state(COMPLETE), _exc(nullptr), _parked(parked) {}
 		
 				bool IsExecutable() const {
-					return _state.load(std::memory_order_relaxed) == State::READY_FOR_EXECUTE;
+					return (_state.load(std::memory_order_relaxed) & ~PARKED) == READY_FOR_EXECUTE;
 				}
 
 				//No memory guarantee! If true, needs memory_order_acquire fence
 				bool IsComplete() const {
-					return _state.load(std::memory_order_relaxed) == State::COMPLETE;
+					return _state.load(std::memory_order_relaxed) == COMPLETE;
 				}
 
 				void SetOperation(const T& data) {
-					State expected = State::COMPLETE;
+					uint32_t expected = COMPLETE;
 					_data_for_operation = data; //Writed from one thread
-					ASSERT(_state.compare_exchange_strong(expected, State::READY_FOR_EXECUTE, std::memory_order_release));
+					ASSERT(_state.compare_exchange_strong(expected, READY_FOR_EXECUTE, std::memory_order_release));
 				}
 
 				void OnExecutionStart() {
-					State expected = State::READY_FOR_EXECUTE;
-					if (!_state.compare_exchange_strong(expected, State::EXECUTION, std::memory_order_acquire)) {
-						ASSERT(expected == State::EXECUTION); //for case if this method will be called from combiner
-					}
+					uint32_t current = _state.load(std::memory_order_acquire);
+					do {
+						if ((current & ~PARKED) == EXECUTION) { return; } //for case if this method will be called from combiner
+						ASSERT((current & ~PARKED) == READY_FOR_EXECUTE);
+					} while (!_state.compare_exchange_weak(current, (current & PARKED) | EXECUTION, std::memory_order_acquire));
 				}
 
 				void OnExecutionComplete(std::exception_ptr exc) {
 					_exc = exc;
-					State expected = State::EXECUTION;
-					ASSERT(_state.compare_exchange_strong(expected, State::COMPLETE, std::memory_order_release)); //saves changes and _exc
+					uint32_t previous = _state.exchange(COMPLETE, std::memory_order_release); //saves changes and _exc
+					ASSERT((previous & ~PARKED) == EXECUTION);
+
+					//Slot stays in the queue while owner is parked, so it can't be deleted under our feet even if
+					//owner wakes up spuriously and leaves
+					if (previous & PARKED) {
+						_parked->fetch_sub(1, std::memory_order_relaxed);
+						syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+					}
+				}
+
+				/**
+				 * Owner announces it is going to sleep. Returns false if operation is complete already. Operation
+				 * stays announced after spurious wakeup until it completes or parking is cancelled
+				 */
+				bool PrepareParking() {
+					uint32_t current = _state.load(std::memory_order_relaxed);
+					if (current & PARKED) { return true; }
+
+					_parked->fetch_add(1, std::memory_order_relaxed);
+					do {
+						if (current == COMPLETE) {
+							_parked->fetch_sub(1, std::memory_order_relaxed);
+							return false;
+						}
+					} while (!_state.compare_exchange_weak(current, current | PARKED, std::memory_order_relaxed));
+					return true;
+				}
+
+				//Returns false if combiner has taken operation already, owner has to wait for completion then
+				bool CancelParking() {
+					uint32_t expected = READY_FOR_EXECUTE | PARKED;
+					if (!_state.compare_exchange_strong(expected, READY_FOR_EXECUTE, std::memory_order_relaxed)) { return false; }
+					_parked->fetch_sub(1, std::memory_order_relaxed);
+					return true;
+				}
+
+				//Sleeps until OnExecutionComplete(), could return spuriously
+				void Park() {
+					uint32_t current = _state.load(std::memory_order_relaxed);
+					if (current & PARKED) {
+						syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_state), FUTEX_WAIT_PRIVATE, current, nullptr, nullptr, 0);
+					}
 				}
 
 				T& GetData() {
@@ -112,7 +165,7 @@ class FlatCombiner {
 				std::atomic<uint64_t> last_active;
 				OperationWrapper operation;
 
-				OpNode() : _next_and_alive(_ALIVE_MASK), last_active(0) {}
+				explicit OpNode(std::atomic<int32_t>* parked = nullptr) : _next_and_alive(_ALIVE_MASK), last_active(0), operation(parked) {}
 
 				/**
 				* Remove alive bit from the next_and_alive pointer and return
@@ -130,8 +183,7 @@ class FlatCombiner {
 					size_t curr_val = _next_and_alive.load(std::memory_order_relaxed);
 					size_t current_mask = curr_val & _ALIVE_MASK;
 
-					if (!allow_invalidated_change) { ASSERT(current_mask == _ALIVE_MASK); }
-					ASSERT(current_mask == _ALIVE_MASK); //We cannot purge invalidated element
+					if (!allow_invalidated_change) { ASSERT(current_mask == _ALIVE_MASK); } //We cannot purge invalidated element
 
 					size_t new_val = ((size_t) node) | current_mask;
 					return _next_and_alive.compare_exchange_strong(curr_val, new_val, std::memory_order_relaxed);
@@ -164,7 +216,7 @@ class FlatCombiner {
 				}
 
 				bool IsAlive() const {
-					_CheckValueForAvaliability(_next_and_alive.load(std::memory_order_relaxed));
+					return _CheckValueForAvaliability(_next_and_alive.load(std::memory_order_relaxed));
 				}
 		};
 
@@ -172,13 +224,36 @@ class FlatCombiner {
 		// Maximum number of pernding operations could be passed to a single Combine call
 		static const std::size_t max_call_size = QMS;
 		using FlatCombinerShotArrayType = std::array<OperationWrapperPtr, QMS>;
+
+		/**
+		 * How a thread waits while another one combines its operation: spins with pause instruction checking
+		 * completion and the lock, then sleeps on futex of its slot until the combiner wakes it. Without parking
+		 * thread yields after spinning, which keeps it on CPU under load.
+		 *
+		 * By default thread spins and parks on multi-core machines only: on a single CPU combiner can't run while
+		 * thread spins, and wake up on futex costs more than yield
+		 */
+		struct WaitPolicy {
+			uint32_t spin_count;
+			bool park;
+
+			WaitPolicy() : WaitPolicy(512, true) {
+				if (std::thread::hardware_concurrency() == 1) {
+					spin_count = 0;
+					park = false;
+				}
+			}
+			WaitPolicy(uint32_t spin_count, bool park = true) : spin_count(spin_count), park(park) {}
+		};
     
 		/**
 		 * @param Combine function that aplly pending operations onto some data structure. It accepts array
 		 * of pending ops and allowed to modify it in any way except delete pointers
 		 */
-		FlatCombiner(const std::function<void(FlatCombinerShotArrayType&)>& combiner, uint64_t saving_time = 100000, bool need_sort_shot = true) :
-			_slot(nullptr, _OrphanSlot), _technical_element(new OpNode), _lock(1), _saving_time(saving_time), _combiner(combiner), _is_alive(true)
+		FlatCombiner(const std::function<void(FlatCombinerShotArrayType&)>& combiner, uint64_t saving_time = 100000, bool need_sort_shot = true,
+			     const WaitPolicy& wait = WaitPolicy()) :
+			_lock(1), _is_alive(true), _combiner(combiner), _need_sort_shot(need_sort_shot), _technical_element(new OpNode),
+			_slot(nullptr, _OrphanSlot), _saving_time(saving_time), _parked(0), _wait(wait)
 		{
 			_queue.store(_technical_element, std::memory_order_relaxed);
 		}
@@ -227,8 +302,15 @@ class FlatCombiner {
 			// TODO: call Combine function
 			// TODO: unlock
 			// TODO: if lock fails, do thread_yeild and goto 3 TODO
+			//SetOperation should be called before apply. Slot which is already in the queue could be taken
+			//(or even completed) by the combiner running in another thread at any moment after that, so
+			//operation state isn't checked here
 			OpNode* curr_slot = _slot.get();
-			ASSERT(curr_slot->operation.IsExecutable()); //SetOperation should be called before apply. 
+			ASSERT(curr_slot != nullptr);
+
+			//Operation is visible to executors that take the lock after this point, see _Wait()
+			if (_wait.park) { std::atomic_thread_fence(std::memory_order_seq_cst); }
+			uint64_t published = _lock.load(std::memory_order_acquire);
 
 			while (true) {
 				ASSERT(curr_slot->IsAlive());
@@ -238,6 +320,7 @@ class FlatCombiner {
 					if (curr_slot->Next() == nullptr) { _InsertSlot(curr_slot); } //We have full control, so this check will be reliable
 					_ExecutorFunction(epoch);
 					_Unlock();
+					_ServeParked();
 					break;
 				}
 				else {
@@ -252,7 +335,7 @@ class FlatCombiner {
 							_InsertSlot(curr_slot);
 						}
 						else {
-							std::this_thread::yield();
+							_Wait(curr_slot, published);
 						}
 					}
 				}
@@ -281,20 +364,74 @@ class FlatCombiner {
 		OpNode* _GetThreadSlot() {
 			OpNode* result = _slot.get();
 			if (result == nullptr) {
-				result = new OpNode; //Usage bit has been already set in constructor
+				result = new OpNode(&_parked); //Usage bit has been already set in constructor
 				_slot.set(result);
 			}
 
 			return result;
 		}
 
-		void _ExecutorFunction(uint64_t epoch) {
+		/**
+		 * Waits while another thread is the executor, returns once operation completes or the lock gets
+		 * released. Slot must be in the queue, published is the lock value read after operation was set
+		 */
+		void _Wait(OpNode* slot, uint64_t published) {
+			OperationWrapper& operation = slot->operation;
+			for (uint32_t i = 0; i < _wait.spin_count; i++) {
+				if (operation.IsComplete() || !_IsLocked()) { return; }
+				CpuRelax();
+			}
+
+			if (!_wait.park) {
+				std::this_thread::yield();
+				return;
+			}
+
+			//Executor running when operation was published could have seen the slot idle and be removing it from
+			//the queue: nobody would find the parked thread then. Later executors see the operation, so thread
+			//parks once that pass is over and the slot is still in the queue
+			if ((published & _LCK_BIT_MASK) && ((_lock.load(std::memory_order_acquire) ^ published) & _GEN_VAL_MASK) == 0) {
+				std::this_thread::yield();
+				return;
+			}
+			if (slot->Next() == nullptr) { return; }
+
+			if (!operation.PrepareParking()) { return; }
+			//Pairs with the fence in _ServeParked(): either executor releasing the lock sees this thread parked,
+			//or this thread sees the lock released and tries to take it itself
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!_IsLocked() && operation.CancelParking()) { return; }
+			operation.Park();
+		}
+
+		/**
+		 * Parked threads don't try the lock, so whoever releases it runs more passes while any of them waits.
+		 * Operation of a parked thread could be published after the executor has passed its slot
+		 */
+		void _ServeParked() {
+			while (_wait.park) {
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (_parked.load(std::memory_order_relaxed) <= 0) { return; }
+
+				uint64_t epoch = _TryLock();
+				if (epoch == 0) {
+					if (_IsLocked()) { return; } //current executor serves them
+					continue;
+				}
+				size_t executed = _ExecutorFunction(epoch);
+				_Unlock();
+				if (executed == 0) { std::this_thread::yield(); } //parked thread is between announce and sleep
+			}
+		}
+
+		//Returns number of executed operations
+		size_t _ExecutorFunction(uint64_t epoch) {
 			OpNode* curr_element = _queue.load(std::memory_order_relaxed);
 			OpNode* parent = nullptr;
 
 			FlatCombinerShotArrayType combine_shot;
 			combine_shot.fill(nullptr);
-			size_t position = 0;
+			size_t position = 0, executed = 0;
 			while (curr_element != _technical_element) {
 				if (!curr_element->IsAlive() || (epoch - curr_element->last_active.load(std::memory_order_relaxed) > _saving_time && 
 						                 !curr_element->operation.IsExecutable())) {
@@ -313,6 +450,7 @@ class FlatCombiner {
 				if (position == QMS) {
 					if (_need_sort_shot) { std::sort(combine_shot.begin(), combine_shot.end(), _CompareOperationWrapperPointers); }
 					_combiner(combine_shot);
+					executed += position;
 					position = 0;
 					combine_shot.fill(nullptr);
 				}
@@ -322,9 +460,10 @@ class FlatCombiner {
 			}
 
 			if (position != 0) {
-				std::sort(combine_shot.begin(), combine_shot.end(), _CompareOperationWrapperPointers);
+				if (_need_sort_shot) { std::sort(combine_shot.begin(), combine_shot.end(), _CompareOperationWrapperPointers); }
 				_combiner(combine_shot);
 			}
+			return executed + position;
 		}
 
 		/**
@@ -353,7 +492,7 @@ class FlatCombiner {
 		void _Unlock() {
 			uint64_t curr_val = _lock.load(std::memory_order_relaxed);
 			ASSERT(curr_val & _LCK_BIT_MASK); //check if locked
-			ASSERT(_lock.compare_exchange_strong(curr_val, _GEN_VAL_MASK & (curr_val + 1), std::memory_order_relaxed));
+			ASSERT(_lock.compare_exchange_strong(curr_val, _GEN_VAL_MASK & (curr_val + 1), std::memory_order_release)); //publishes dequeued slots, see _Wait()
 		}
 
 		bool _IsLocked() const {
@@ -389,8 +528,6 @@ class FlatCombiner {
 			ASSERT(slot2remove->Next() != nullptr);
 			ASSERT(parent != slot2remove);
 
-			CURRENT_PROCESS_DEBUG("Delete slot from flat combiner: " << "parent = " << parent << "; slot2remove: " << slot2remove << "; head = " << _queue.load() << std::endl);
-
 			//purging the head of queue in destructor
 			if (parent == nullptr && _queue.load(std::memory_order_relaxed) == nullptr) {
 				if (!slot2remove->TryPurge()) {
@@ -406,6 +543,7 @@ class FlatCombiner {
 					current = _queue.load(std::memory_order_relaxed);
 					while (current->Next() != slot2remove) {
 						ASSERT(current->Next() != _technical_element); //slot2remove should be in queue
+						current = current->Next();
 					}
 					_DequeueSlot(current, slot2remove);
 					return;
@@ -469,6 +607,10 @@ class FlatCombiner {
 
 		//Count of epochs before purging
 		uint64_t _saving_time;
+
+		//Threads sleeping on their slots until operation completes
+		std::atomic<int32_t> _parked;
+		WaitPolicy _wait;
 };
 
 } //namespace Core
@@ -0,0 +1,265 @@
+#ifndef AFINA_FUTURE_H
+#define AFINA_FUTURE_H
+
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "Task.h"
+
+namespace Afina {
+namespace Core {
+
+template <typename T> class Future;
+template <typename T> class Promise;
+
+// Result of the asynchronous operation, void specialization keeps nothing
+template <typename T> class _FutureValue {
+public:
+    _FutureValue() : _has_value(false) {}
+    ~_FutureValue() {
+        if (_has_value) {
+            reinterpret_cast<T *>(&_storage)->~T();
+        }
+    }
+
+    template <typename V> void Set(V &&value) {
+        new (&_storage) T(std::forward<V>(value));
+        _has_value = true;
+    }
+
+    T Take() { return std::move(*reinterpret_cast<T *>(&_storage)); }
+
+private:
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type _storage;
+    bool _has_value;
+};
+
+template <> class _FutureValue<void> {
+public:
+    void Set() {}
+    void Take() {}
+};
+
+// State shared by promise and its future
+template <typename T> struct _FutureState {
+    _FutureState() : ready(false) {}
+
+    std::mutex lock;
+    std::condition_variable ready_condition;
+    bool ready;
+
+    _FutureValue<T> value;
+    std::exception_ptr error;
+
+    // Runs once state is ready, by the thread which made it ready
+    Task continuation;
+};
+
+/**
+ * Calls function and stores its result or exception into the promise
+ */
+template <typename T, typename F>
+typename std::enable_if<!std::is_void<T>::value>::type Fulfill(Promise<T> &promise, F &function) {
+    try {
+        promise.SetValue(function());
+    } catch (...) {
+        promise.SetException(std::current_exception());
+    }
+}
+
+template <typename T, typename F>
+typename std::enable_if<std::is_void<T>::value>::type Fulfill(Promise<T> &promise, F &function) {
+    try {
+        function();
+        promise.SetValue();
+    } catch (...) {
+        promise.SetException(std::current_exception());
+    }
+}
+
+/**
+ * # Result of the asynchronous operation
+ * Unlike std::future allows to attach continuation that runs once result is ready, so the caller doesn't have to
+ * block on Get(). Result could be taken only once, either by Get() or by the continuation.
+ */
+template <typename T> class Future {
+public:
+    Future() {}
+
+    Future(Future &&) = default;
+    Future &operator=(Future &&) = default;
+
+    Future(const Future &) = delete;
+    Future &operator=(const Future &) = delete;
+
+    // Future is bound to some promise
+    bool Valid() const { return _state != nullptr; }
+
+    // Result or exception is available, Get() won't block
+    bool Ready() const {
+        std::unique_lock<std::mutex> lock(_state->lock);
+        return _state->ready;
+    }
+
+    void Wait() const {
+        std::unique_lock<std::mutex> lock(_state->lock);
+        while (!_state->ready) {
+            _state->ready_condition.wait(lock);
+        }
+    }
+
+    /**
+     * Waits for the result and returns it, rethrows exception if operation failed. Future becomes invalid after
+     * the call
+     */
+    T Get() {
+        Wait();
+        std::shared_ptr<_FutureState<T>> state = std::move(_state);
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+        return state->value.Take();
+    }
+
+    /**
+     * Attaches function to be called with the ready future: in the thread which fulfills promise or right here if
+     * the result is already there. Returns future of the function result, this one becomes invalid.
+     *
+     * Function must not block, it delays everything else the fulfilling thread is doing
+     */
+    template <typename F>
+    Future<typename std::result_of<typename std::decay<F>::type(Future<T>)>::type> Then(F &&function) {
+        typedef typename std::result_of<typename std::decay<F>::type(Future<T>)>::type Result;
+        if (!_state) {
+            throw std::future_error(std::future_errc::no_state);
+        }
+
+        Promise<Result> promise;
+        Future<Result> result = promise.GetFuture();
+        std::shared_ptr<_FutureState<T>> state = _state;
+        Task continuation = Task::Bind(_Continuation<Result, typename std::decay<F>::type>(
+            std::move(promise), std::forward<F>(function), std::move(*this)));
+
+        std::unique_lock<std::mutex> lock(state->lock);
+        if (state->continuation) {
+            throw std::future_error(std::future_errc::future_already_retrieved);
+        }
+        if (!state->ready) {
+            state->continuation = std::move(continuation);
+            return result;
+        }
+        lock.unlock();
+        continuation();
+        return result;
+    }
+
+private:
+    friend class Promise<T>;
+
+    explicit Future(const std::shared_ptr<_FutureState<T>> &state) : _state(state) {}
+
+    // Continuation keeps future it was attached to, so state lives until the continuation is done
+    template <typename R, typename F> struct _Continuation {
+        template <typename Fa>
+        _Continuation(Promise<R> &&promise_p, Fa &&function_p, Future<T> &&future_p)
+            : promise(std::move(promise_p)), function(std::forward<Fa>(function_p)), future(std::move(future_p)) {}
+
+        struct _Invoke {
+            _Continuation *self;
+            R operator()() { return self->function(std::move(self->future)); }
+        };
+
+        void operator()() {
+            _Invoke invoke = {this};
+            Fulfill(promise, invoke);
+        }
+
+        Promise<R> promise;
+        F function;
+        Future<T> future;
+    };
+
+    std::shared_ptr<_FutureState<T>> _state;
+};
+
+/**
+ * # Producer side of the future
+ * Promise destroyed without result breaks its future: std::future_error with broken_promise code is stored
+ * instead
+ */
+template <typename T> class Promise {
+public:
+    Promise() : _state(std::make_shared<_FutureState<T>>()) {}
+
+    Promise(Promise &&) = default;
+    Promise &operator=(Promise &&other) {
+        _Break();
+        _state = std::move(other._state);
+        return *this;
+    }
+
+    Promise(const Promise &) = delete;
+    Promise &operator=(const Promise &) = delete;
+
+    ~Promise() { _Break(); }
+
+    Future<T> GetFuture() { return Future<T>(_state); }
+
+    // Stores result, argument is omitted for Promise<void>
+    template <typename... V> void SetValue(V &&... value) {
+        std::unique_lock<std::mutex> lock(_state->lock);
+        _CheckNotReady();
+        _state->value.Set(std::forward<V>(value)...);
+        _MakeReady(lock);
+    }
+
+    void SetException(std::exception_ptr error) {
+        std::unique_lock<std::mutex> lock(_state->lock);
+        _CheckNotReady();
+        _state->error = error;
+        _MakeReady(lock);
+    }
+
+private:
+    void _CheckNotReady() {
+        if (_state->ready) {
+            throw std::future_error(std::future_errc::promise_already_satisfied);
+        }
+    }
+
+    void _MakeReady(std::unique_lock<std::mutex> &lock) {
+        _state->ready = true;
+        Task continuation = std::move(_state->continuation);
+        lock.unlock();
+
+        _state->ready_condition.notify_all();
+        if (continuation) {
+            continuation();
+        }
+    }
+
+    void _Break() {
+        if (!_state) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(_state->lock);
+        if (!_state->ready) {
+            _state->error = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+            _MakeReady(lock);
+        }
+    }
+
+    std::shared_ptr<_FutureState<T>> _state;
+};
+
+} // namespace Core
+} // namespace Afina
+
+#endif // AFINA_FUTURE_H
@@ -0,0 +1,166 @@
+#ifndef AFINA_TASK_H
+#define AFINA_TASK_H
+
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace Afina {
+namespace Core {
+
+/**
+ * # Move-only callable for thread pools
+ * Unlike std::function keeps callables up to inline_size bytes inside itself, so function with a few bound
+ * arguments and lambdas capturing several pointers are stored without allocation. Callable could be move-only.
+ * Bigger callables are placed on the heap.
+ *
+ * Bind() stores function with arguments the same way as std::bind does: arguments are copied or moved in and
+ * passed to the function as lvalues, member function is called on the object pointer given as the first argument
+ */
+class Task {
+public:
+    static const size_t inline_size = 96;
+
+    Task() : _invoke(nullptr), _manage(nullptr) {}
+
+    template <typename F,
+              typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&function) : _invoke(nullptr), _manage(nullptr) {
+        _Store<typename std::decay<F>::type>(std::forward<F>(function));
+    }
+
+    Task(Task &&other) : _invoke(other._invoke), _manage(other._manage) {
+        if (_manage != nullptr) {
+            _manage(_storage, other._storage);
+            other._invoke = nullptr;
+            other._manage = nullptr;
+        }
+    }
+
+    Task &operator=(Task &&other) {
+        if (this != &other) {
+            Reset();
+            _invoke = other._invoke;
+            _manage = other._manage;
+            if (_manage != nullptr) {
+                _manage(_storage, other._storage);
+                other._invoke = nullptr;
+                other._manage = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task() { Reset(); }
+
+    template <typename F, typename... Types> static Task Bind(F &&function, Types &&... args) {
+        return Task(_Bound<typename std::decay<F>::type, typename std::decay<Types>::type...>(
+            std::forward<F>(function), std::forward<Types>(args)...));
+    }
+
+    // Typed fast path for the common case of method taking int, such as connection handler taking socket
+    template <typename C> static Task Bind(void (C::*method)(int), C *object, int arg) {
+        return Task(_MemberCall<C>(method, object, arg));
+    }
+
+    void operator()() { _invoke(_storage); }
+
+    explicit operator bool() const { return _invoke != nullptr; }
+
+    // Destroys stored callable
+    void Reset() {
+        if (_manage != nullptr) {
+            _manage(nullptr, _storage);
+            _invoke = nullptr;
+            _manage = nullptr;
+        }
+    }
+
+    // Callable of the given type is stored without allocation
+    template <typename F> static constexpr bool IsInline() {
+        return sizeof(F) <= inline_size && alignof(F) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<F>::value;
+    }
+
+private:
+    // Calls stored callable
+    typedef void (*_Invoker)(void *storage);
+
+    // Moves callable from src storage to dst and destroys the source one, only destroys it if dst is nullptr
+    typedef void (*_Manager)(void *dst, void *src);
+
+    // Index sequence to unpack arguments stored in tuple (C++11 has no std::index_sequence)
+    template <std::size_t... I> struct _Indexes {};
+    template <std::size_t N, std::size_t... I> struct _MakeIndexes : _MakeIndexes<N - 1, N - 1, I...> {};
+    template <std::size_t... I> struct _MakeIndexes<0, I...> { typedef _Indexes<I...> type; };
+
+    template <typename F, typename... Args> static void _Call(F &function, Args &... args) { function(args...); }
+
+    template <typename R, typename C, typename... Params, typename O, typename... Args>
+    static void _Call(R (C::*method)(Params...), O *object, Args &... args) {
+        (object->*method)(args...);
+    }
+
+    template <typename F, typename... Types> struct _Bound {
+        F function;
+        std::tuple<Types...> args;
+
+        template <typename Fa, typename... Ta>
+        _Bound(Fa &&function_p, Ta &&... args_p)
+            : function(std::forward<Fa>(function_p)), args(std::forward<Ta>(args_p)...) {}
+
+        void operator()() { _Apply(typename _MakeIndexes<sizeof...(Types)>::type()); }
+
+        template <std::size_t... I> void _Apply(_Indexes<I...>) { _Call(function, std::get<I>(args)...); }
+    };
+
+    template <typename C> struct _MemberCall {
+        void (C::*method)(int);
+        C *object;
+        int arg;
+
+        _MemberCall(void (C::*method_p)(int), C *object_p, int arg_p)
+            : method(method_p), object(object_p), arg(arg_p) {}
+
+        void operator()() { (object->*method)(arg); }
+    };
+
+    template <typename F, typename Fa> typename std::enable_if<IsInline<F>()>::type _Store(Fa &&function) {
+        new (_storage) F(std::forward<Fa>(function));
+        _invoke = [](void *storage) { (*static_cast<F *>(storage))(); };
+        _manage = [](void *dst, void *src) {
+            F *source = static_cast<F *>(src);
+            if (dst != nullptr) {
+                new (dst) F(std::move(*source));
+            }
+            source->~F();
+        };
+    }
+
+    template <typename F, typename Fa> typename std::enable_if<!IsInline<F>()>::type _Store(Fa &&function) {
+        *reinterpret_cast<F **>(_storage) = new F(std::forward<Fa>(function));
+        _invoke = [](void *storage) { (**static_cast<F **>(storage))(); };
+        _manage = [](void *dst, void *src) {
+            F **source = static_cast<F **>(src);
+            if (dst != nullptr) {
+                *static_cast<F **>(dst) = *source;
+            } else {
+                delete *source;
+            }
+        };
+    }
+
+    _Invoker _invoke;
+    _Manager _manage;
+    alignas(std::max_align_t) char _storage[inline_size];
+};
+
+} // namespace Core
+} // namespace Afina
+
+#endif // AFINA_TASK_H
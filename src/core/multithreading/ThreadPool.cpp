@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include<iostream>
 
 #include "ThreadPool.h"
@@ -7,12 +9,29 @@
 namespace Afina {
 namespace Core {
 
-ThreadPool::ThreadPool() : _low_watermark(0), _hight_watermark(0), _max_queue_size(0), _idle_time(0), 
-						   state(ThreadPool::State::kStopped), _count_free_threads(0)
-{}
+ThreadPool::ThreadPool() : _count_free_threads(0), _tasks_size(0), _free_nodes(nullptr),
+						   state(ThreadPool::State::kStopped), _low_watermark(0), _hight_watermark(0),
+						   _max_queue_size(0), _idle_time(0), _target_delay(0), _delay_interval(0), _adaptive(false),
+						   _threads_to_stop(0), _executed(0), _rejected(0), _busy_time(0)
+{
+	std::memset(_wait_histogram, 0, sizeof(_wait_histogram));
+}
 
 ThreadPool::~ThreadPool() {
 	Stop(true);
+	for (_Lane &lane : _lanes) {
+		lane.tail = nullptr;
+		while (lane.head != nullptr) {
+			_TaskNode *next = lane.head->next;
+			delete lane.head;
+			lane.head = next;
+		}
+	}
+	while (_free_nodes != nullptr) {
+		_TaskNode *next = _free_nodes->next;
+		delete _free_nodes;
+		_free_nodes = next;
+	}
 }
 
 void ThreadPool::_ThreadFunction() {
@@ -20,8 +39,8 @@ void ThreadPool::_ThreadFunction() {
 	try {
 		bool thread_unregistered = false;
 		while (state.load() == ThreadPool::State::kRun) {
-			_ExecuteTasks();
-			if (_idle_time != 0) { 
+			bool finish = _ExecuteTasks();
+			if (finish || (_idle_time != 0 && !_adaptive)) { 
 				if (_TryUnregisterThread()) { //Checks low watermark
 					thread_unregistered = true;
 					break; 
@@ -40,12 +59,18 @@ void ThreadPool::_ThreadFunction() {
 	THREADPOOL_CURRENT_PROCESS_DEBUG(__PRETTY_FUNCTION__ << " was finished");
 }
 
-void ThreadPool::_ExecuteTasks() {
+bool ThreadPool::_ExecuteTasks() {
 	//Waiting for new tasks
-	while (tasks.empty() && state.load() == ThreadPool::State::kRun) {
+	while (_tasks_size.load() == 0 && state.load() == ThreadPool::State::kRun) {
 		std::unique_lock<std::mutex> lock(threadpool_mutex); //Will be released in wait_for()/wait() function
+		//Check again under the lock, otherwise task or Stop() notification could come before the wait and be lost
+		if (_tasks_size.load() != 0 || state.load() != ThreadPool::State::kRun) { break; }
+		if (_threads_to_stop != 0) { //Controller shrinks the pool, idle thread goes away
+			--_threads_to_stop;
+			return true;
+		}
 		++_count_free_threads;
-		if (_idle_time != 0) {
+		if (_idle_time != 0 && !_adaptive) {
 			auto status = empty_condition.wait_for(lock, std::chrono::milliseconds(_idle_time));
 			if (status == std::cv_status::timeout) //No need wait more
 			{ 
@@ -60,25 +85,230 @@ void ThreadPool::_ExecuteTasks() {
 	}
 
 	//Extract the new tasks
-	while (!tasks.empty()) {
-		std::deque<std::function<void()>>::iterator task_iterator;
-		std::function<void()> task;
-		//Extract task under mutex
+	while (_tasks_size.load() != 0) {
+		Task task;
+		//Extract task under mutex, node goes to the free list right away, so there is no extra lock after execution
 		{
 			std::unique_lock<std::mutex> __lock(threadpool_mutex);
-			task_iterator = tasks.begin();
-			if (task_iterator == tasks.end()) { return; } //No new tasks
-			task = std::move(*task_iterator);
-			tasks.erase(task_iterator);
+			_TaskNode *node = _Dequeue();
+			if (node == nullptr) { return false; } //No new tasks
+
+			task = std::move(node->task);
+			node->next = _free_nodes;
+			_free_nodes = node;
 		}
 
+		auto started = std::chrono::steady_clock::now();
 		try { //Other problems are system problems in thread and it should be finished - so try-catch is in _ThreadFunction()
 			task(); //Execue
 		}
 		catch (std::exception& exc) {
 			THREADPOOL_CURRENT_PROCESS_DEBUG("EXCEPTION during the execution of the task: " << exc.what());
 		}
+		auto busy = std::chrono::steady_clock::now() - started;
+		_busy_time.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count(),
+							 std::memory_order_relaxed);
+	}
+	return false;
+}
+
+bool ThreadPool::_Enqueue(Priority priority, Task &&task) {
+	std::unique_lock<std::mutex> lock(threadpool_mutex);
+	//Overloaded lane sheds new tasks until queued ones are taken. Overload is detected on dequeue, but when all
+	//threads are busy nothing is taken, so the oldest task having waited longer than target sheds as well
+	_Lane &lane = _lanes[static_cast<size_t>(priority)];
+	auto now = std::chrono::steady_clock::now();
+	bool standing = (_target_delay.count() != 0 && lane.head != nullptr && now - lane.head->enqueued > _target_delay);
+	if (_tasks_size.load() >= _max_queue_size || (lane.overloaded && lane.size != 0) || standing) {
+		_rejected++;
+		return false;
+	}
+
+	_TaskNode *node = _free_nodes;
+	if (node != nullptr) {
+		_free_nodes = node->next;
+	} else {
+		node = new _TaskNode();
+	}
+	node->task = std::move(task);
+	node->enqueued = now;
+	node->next = nullptr;
+
+	if (lane.tail != nullptr) {
+		lane.tail->next = node;
+	} else {
+		lane.head = node;
+	}
+	lane.tail = node;
+	lane.size++;
+	_tasks_size.fetch_add(1);
+
+	//Adaptive pool is resized by controller, thread is started here only if there are none at all
+	if (_count_free_threads.load() == 0 && threads.size() < _hight_watermark && (!_adaptive || threads.empty())) {
+		_StartThread(false);
+	}
+
+	empty_condition.notify_one();
+	return true;
+}
+
+ThreadPool::_TaskNode *ThreadPool::_Dequeue() {
+	for (_Lane &lane : _lanes) {
+		_TaskNode *node = lane.head;
+		if (node == nullptr) { continue; }
+
+		lane.head = node->next;
+		if (lane.head == nullptr) { lane.tail = nullptr; }
+		lane.size--;
+		_tasks_size.fetch_sub(1);
+
+		auto now = std::chrono::steady_clock::now();
+		auto wait = std::chrono::duration_cast<std::chrono::microseconds>(now - node->enqueued);
+		_wait_histogram[_WaitBucket(wait.count())]++;
+		_executed++;
+
+		if (_target_delay.count() != 0) {
+			lane.min_delay = std::min(lane.min_delay, now - node->enqueued);
+			if (now >= lane.interval_end) {
+				//Standing queue: even the luckiest task of the interval waited too long
+				lane.overloaded = (lane.min_delay > _target_delay);
+				lane.min_delay = std::chrono::steady_clock::duration::max();
+				lane.interval_end = now + _delay_interval;
+			}
+			if (lane.size == 0) { lane.overloaded = false; } //Queue has drained
+		}
+		return node;
 	}
+	return nullptr;
+}
+
+void ThreadPool::SetAdmissionControl(std::chrono::milliseconds target, std::chrono::milliseconds interval) {
+	std::unique_lock<std::mutex> lock(threadpool_mutex);
+	_target_delay = target;
+	_delay_interval = interval;
+
+	auto now = std::chrono::steady_clock::now();
+	for (_Lane &lane : _lanes) {
+		lane.min_delay = std::chrono::steady_clock::duration::max();
+		lane.interval_end = now + _delay_interval;
+		lane.overloaded = false;
+	}
+}
+
+void ThreadPool::SetAdaptiveSizing(const SizingPolicy &policy) {
+	std::unique_lock<std::mutex> lock(threadpool_mutex);
+	if (state.load() != ThreadPool::State::kStopped) {
+		throw std::logic_error("Adaptive sizing must be set before thread pool is started");
+	}
+	_adaptive = true;
+	_policy = policy;
+}
+
+void ThreadPool::_ControlSizing() {
+	THREADPOOL_CURRENT_PROCESS_DEBUG(__PRETTY_FUNCTION__);
+	std::unique_lock<std::mutex> lock(threadpool_mutex);
+
+	//Each period looks only at tasks taken during it
+	uint64_t window_base[_wait_buckets];
+	std::memcpy(window_base, _wait_histogram, sizeof(window_base));
+	uint64_t busy_base = _busy_time.load();
+	auto period_start = std::chrono::steady_clock::now();
+
+	unsigned int slow_periods = 0, idle_periods = 0;
+	while (state.load() == ThreadPool::State::kRun) {
+		_controller_condition.wait_for(lock, _policy.period);
+		if (state.load() != ThreadPool::State::kRun) { break; }
+
+		auto now = std::chrono::steady_clock::now();
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - period_start).count();
+		uint64_t busy = _busy_time.load();
+		double utilization = 0;
+		if (elapsed > 0 && !threads.empty()) {
+			utilization = double(busy - busy_base) / (double(elapsed) * threads.size());
+		}
+		//Tasks that are still in the queue have waited at least since the period start
+		std::chrono::microseconds wait = _WaitPercentile(_wait_histogram, window_base, 0.9);
+		if (_tasks_size.load() != 0) {
+			wait = std::max(wait, std::chrono::duration_cast<std::chrono::microseconds>(now - period_start));
+		}
+
+		std::memcpy(window_base, _wait_histogram, sizeof(window_base));
+		busy_base = busy;
+		period_start = now;
+
+		//Separate thresholds and run lengths for growing and shrinking give hysteresis
+		slow_periods = (wait > _policy.grow_wait) ? slow_periods + 1 : 0;
+		idle_periods = (wait < _policy.grow_wait / 4 && utilization < _policy.shrink_utilization) ? idle_periods + 1 : 0;
+
+		if (slow_periods >= _policy.grow_periods && threads.size() < _hight_watermark) {
+			size_t grow = std::min(std::max<size_t>(1, threads.size() / 4), _hight_watermark - threads.size());
+			THREADPOOL_CURRENT_PROCESS_DEBUG("Adaptive sizing starts " << grow << " threads, wait " << wait.count() << "us");
+			for (size_t i = 0; i < grow; i++) {
+				_StartThread(false);
+			}
+			slow_periods = idle_periods = 0;
+		} else if (idle_periods >= _policy.shrink_periods && threads.size() > _low_watermark + 1 + _threads_to_stop) {
+			THREADPOOL_CURRENT_PROCESS_DEBUG("Adaptive sizing stops a thread, utilization " << utilization);
+			_threads_to_stop++;
+			empty_condition.notify_one();
+			slow_periods = idle_periods = 0;
+		}
+	}
+	THREADPOOL_CURRENT_PROCESS_DEBUG(__PRETTY_FUNCTION__ << " was finished");
+}
+
+size_t ThreadPool::_WaitBucket(uint64_t wait_us) {
+	if (wait_us < 4) { return wait_us; }
+	size_t power = 63 - __builtin_clzll(wait_us);
+	size_t bucket = 4 * (power - 1) + ((wait_us >> (power - 2)) & 3);
+	return std::min(bucket, _wait_buckets - 1);
+}
+
+uint64_t ThreadPool::_WaitBucketUpper(size_t bucket) {
+	if (bucket < 4) { return bucket; }
+	size_t power = bucket / 4 + 1;
+	return ((4 + bucket % 4 + 1) << (power - 2)) - 1;
+}
+
+std::chrono::microseconds ThreadPool::_WaitPercentile(const uint64_t *histogram, const uint64_t *base,
+													  double percentile) {
+	uint64_t total = 0;
+	for (size_t i = 0; i < _wait_buckets; i++) {
+		total += histogram[i] - (base != nullptr ? base[i] : 0);
+	}
+	if (total == 0) { return std::chrono::microseconds(0); }
+
+	uint64_t rank = static_cast<uint64_t>(percentile * (total - 1)) + 1, seen = 0;
+	for (size_t i = 0; i < _wait_buckets; i++) {
+		seen += histogram[i] - (base != nullptr ? base[i] : 0);
+		if (seen >= rank) { return std::chrono::microseconds(_WaitBucketUpper(i)); }
+	}
+	return std::chrono::microseconds(_WaitBucketUpper(_wait_buckets - 1));
+}
+
+ThreadPool::Metrics ThreadPool::GetMetrics() {
+	std::unique_lock<std::mutex> lock(threadpool_mutex);
+	Metrics metrics;
+	metrics.queue_depth = _tasks_size.load();
+	metrics.threads = threads.size();
+	metrics.active_threads = threads.size() - std::min<size_t>(threads.size(), _count_free_threads.load());
+	metrics.executed = _executed;
+	metrics.rejected = _rejected;
+	metrics.wait_p50 = _WaitPercentile(_wait_histogram, nullptr, 0.5);
+	metrics.wait_p90 = _WaitPercentile(_wait_histogram, nullptr, 0.9);
+	metrics.wait_p99 = _WaitPercentile(_wait_histogram, nullptr, 0.99);
+	return metrics;
+}
+
+void ThreadPool::Metrics::Append(std::map<std::string, std::string> &stats, const std::string &prefix) const {
+	stats[prefix + "queue_depth"] = std::to_string(queue_depth);
+	stats[prefix + "threads"] = std::to_string(threads);
+	stats[prefix + "active_threads"] = std::to_string(active_threads);
+	stats[prefix + "executed"] = std::to_string(executed);
+	stats[prefix + "rejected"] = std::to_string(rejected);
+	stats[prefix + "wait_p50_us"] = std::to_string(wait_p50.count());
+	stats[prefix + "wait_p90_us"] = std::to_string(wait_p90.count());
+	stats[prefix + "wait_p99_us"] = std::to_string(wait_p99.count());
 }
 
 bool ThreadPool::_TryUnregisterThread() {
@@ -95,6 +325,7 @@ bool ThreadPool::_TryUnregisterThread() {
 	//Set thread pool state if it was the last thread
 	if (state.load() == ThreadPool::State::kStopping && threads.empty()) {
 		state.store(ThreadPool::State::kStopped);
+		stop_condition.notify_all();
 	}
 
 	return true;
@@ -122,38 +353,36 @@ void ThreadPool::Start(size_t low_watermark, size_t hight_watermark, size_t max_
 	}
 
 	std::unique_lock<std::mutex> __lock(threadpool_mutex);
-	for (int i = 0; i < _low_watermark; i++) {
+	state.store(ThreadPool::State::kRun); //Before threads start, otherwise they see the pool stopped and exit
+	for (size_t i = 0; i < _low_watermark; i++) {
 		//move semantic
 		_StartThread(false);
 	}
-	state.store(ThreadPool::State::kRun);
+	if (_adaptive) {
+		_threads_to_stop = 0;
+		_controller = std::thread(&ThreadPool::_ControlSizing, this);
+	}
 }
 
 void ThreadPool::Stop(bool await) {
 	THREADPOOL_CURRENT_PROCESS_DEBUG(__PRETTY_FUNCTION__);
-	if (state.load() != ThreadPool::State::kRun) { return; }
-	state.store(ThreadPool::State::kStopping);
+	std::unique_lock<std::mutex> lock(threadpool_mutex);
+	if (state.load() == ThreadPool::State::kRun) { state.store(ThreadPool::State::kStopping); }
 
 	//Wake up all threads that are waiting new tasks
 	empty_condition.notify_all();
+	_controller_condition.notify_all();
 
 	if (await) {
+		//Threads detach and unregister themselves (see _TryUnregisterThread), so they can't be joined: the last one
+		//notifies stop_condition instead
 		while (!threads.empty()) {
-			_ThreadsIterator next_thread;
-			{ 
-				std::unique_lock<std::mutex> __lock(threadpool_mutex);
-				next_thread = threads.begin();
-				if (next_thread == threads.end()) { break; } //All threads was finished before we get unique lock
-			} //Free lock to get a allow thread to finish
-
-			try {
-				if (next_thread->second.joinable()) { next_thread->second.join(); } 
-			}
-			catch(std::system_error& exc) {
-				if (exc.code() == std::errc::no_such_process) { continue; } //The process has finished before we've called join()
-			}
+			stop_condition.wait(lock);
 		}
 		state.store(ThreadPool::State::kStopped); //Only if we are waiting we can guarantee stop state
+
+		lock.unlock();
+		if (_controller.joinable()) { _controller.join(); }
 	}
 
         THREADPOOL_CURRENT_PROCESS_DEBUG(__PRETTY_FUNCTION__ << " finished");	
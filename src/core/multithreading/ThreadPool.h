@@ -2,8 +2,11 @@
 #define AFINA_THREADPOOL_H
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <queue>
@@ -13,6 +16,9 @@
 
 #include <afina/core/Debug.h>
 
+#include "Future.h"
+#include "Task.h"
+
 #define THREADPOOL_CURRENT_PROCESS_DEBUG(MESSAGE) CURRENT_PROCESS_DEBUG("Treadpull process: " << MESSAGE)
 
 namespace Afina {
@@ -20,6 +26,17 @@ namespace Core {
 
 /**
  * # Thread pool
+ * Tasks are queued in priority lanes, threads always take the oldest task of the highest non-empty lane.
+ *
+ * Optional admission control follows CoDel: queue is overloaded if even the shortest wait of tasks taken from a
+ * lane during the interval was above the target. Such lane doesn't accept new tasks until it drains, so under
+ * overload tasks are rejected right away instead of piling up, and accepted ones wait about target. Lane with the
+ * oldest task waiting longer than target doesn't accept them either: if all threads are busy nothing is taken
+ * from the queue and the interval never ends.
+ *
+ * By default pool starts a thread whenever task comes and no thread is free, and thread exits after idle_time
+ * without tasks. With adaptive sizing a controller thread resizes the pool by the measured queue wait and
+ * utilization instead, see SizingPolicy.
  */
 class ThreadPool {
 public:
@@ -35,6 +52,17 @@ public:
         kStopped
     };
 
+    enum class Priority {
+        // Administrative and short tasks, taken before anything else
+        kHigh,
+
+        // Default lane
+        kNormal,
+
+        // Background and long tasks, taken once others are done
+        kLow
+    };
+
     ThreadPool();
     ~ThreadPool();
 
@@ -52,32 +80,94 @@ public:
 
     State GetState() const { return state; }
 
+    /**
+     * Rules of the adaptive sizing. Pool grows when tasks wait too long during several periods in a row and
+     * shrinks by one thread when threads are mostly idle and tasks don't wait during much longer run of periods.
+     * Gap between the two conditions and the different lengths keep the pool from growing and shrinking on every
+     * burst. Like idle threads, pool doesn't go below low_watermark + 1 threads
+     */
+    struct SizingPolicy {
+        // How often controller looks at the pool
+        std::chrono::milliseconds period = std::chrono::milliseconds(100);
+
+        // Pool grows by a quarter (at least a thread) once 90th percentile of the queue wait is above grow_wait
+        std::chrono::microseconds grow_wait = std::chrono::microseconds(1000);
+        unsigned int grow_periods = 2;
+
+        // Pool shrinks once threads are busy less than that part of time and 90th percentile of the queue wait is
+        // below quarter of grow_wait
+        double shrink_utilization = 0.5;
+        unsigned int shrink_periods = 30;
+    };
+
+    /**
+     * Pool state for monitoring. Wait percentiles are over all tasks taken since start, rounded up by at most
+     * a quarter of the value
+     */
+    struct Metrics {
+        size_t queue_depth;
+        size_t threads;
+        size_t active_threads;
+        uint64_t executed;
+        uint64_t rejected;
+        std::chrono::microseconds wait_p50;
+        std::chrono::microseconds wait_p90;
+        std::chrono::microseconds wait_p99;
+
+        // Appends metrics to the map of statistics, names are given the prefix
+        void Append(std::map<std::string, std::string> &stats, const std::string &prefix) const;
+    };
+
+    /**
+     * Enables adaptive sizing, must be called before Start. Number of threads given by low_watermark are started
+     * first, idle_time is ignored
+     */
+    void SetAdaptiveSizing(const SizingPolicy &policy);
+
+    Metrics GetMetrics();
+
+    /**
+     * Enables queue delay based admission control, see class description. Zero target disables it, then only
+     * max_queue_size limits the queue
+     */
+    void SetAdmissionControl(std::chrono::milliseconds target,
+                             std::chrono::milliseconds interval = std::chrono::milliseconds(100));
+
     /**
      * Add function to be executed on the threadpool. Method returns true in case if task has been placed
      * onto execution queue, i.e scheduled for execution and false otherwise.
      *
      * That function doesn't wait for function result. Function could always be written in a way to notify caller about
-     * execution finished by itself
+     * execution finished by itself.
+     *
+     * Arguments are bound as std::bind does, but into Task: once the pool has warmed up submission doesn't allocate
      */
     template <typename F, typename... Types> bool Execute(F &&func, Types... args) {
-        // Prepare "task"
-        auto exec = std::bind(std::forward<F>(func), std::forward<Types>(args)...);
-        if (state.load() != State::kRun) {
-            return false;
-        }
+        return ExecuteWithPriority(Priority::kNormal, std::forward<F>(func), std::forward<Types>(args)...);
+    }
 
-        std::unique_lock<std::mutex> lock(threadpool_mutex);
-        // Enqueue new task
-        if (tasks.size() >= _max_queue_size) {
+    /**
+     * Same as Execute, but task is placed in the given lane. Task is also rejected if the lane is overloaded
+     */
+    template <typename F, typename... Types> bool ExecuteWithPriority(Priority priority, F &&func, Types... args) {
+        if (state.load() != State::kRun) {
             return false;
-        } // Cannot create new task
-        tasks.push_back(exec);
-        if (_count_free_threads.load() == 0 && threads.size() < _hight_watermark) {
-            _StartThread(false);
         }
+        return _Enqueue(priority, Task::Bind(std::forward<F>(func), std::forward<Types>(args)...));
+    }
 
-        empty_condition.notify_one();
-        return true;
+    /**
+     * Same as Execute, but returns future of the function result, so caller could wait for it or attach
+     * continuation. If task isn't accepted then future holds std::future_error with broken_promise code
+     */
+    template <typename F, typename... Types>
+    Future<typename std::result_of<typename std::decay<F>::type &(Types &...)>::type> Submit(F &&func,
+                                                                                           Types... args) {
+        typedef typename std::result_of<typename std::decay<F>::type &(Types &...)>::type Result;
+        Promise<Result> promise;
+        Future<Result> result = promise.GetFuture();
+        Execute(_MakePromised(std::move(promise), std::bind(std::forward<F>(func), std::forward<Types>(args)...)));
+        return result;
     }
 
 private:
@@ -94,8 +184,20 @@ private:
     // friend void perform(ThreadPool* pool);
     void _ThreadFunction();
 
-    // Executes tasks in thread
-    void _ExecuteTasks();
+    // Executes tasks in thread, returns true if controller asked the thread to finish
+    bool _ExecuteTasks();
+
+    // Main function of the adaptive sizing controller thread
+    void _ControlSizing();
+
+    // Histogram of the queue wait: buckets are exact up to 4us, then each power of two is split into four
+    static const size_t _wait_buckets = 160;
+    static size_t _WaitBucket(uint64_t wait_us);
+    static uint64_t _WaitBucketUpper(size_t bucket);
+
+    // Percentile of the wait over histogram minus the base one (which could be nullptr)
+    static std::chrono::microseconds _WaitPercentile(const uint64_t *histogram, const uint64_t *base,
+                                                     double percentile);
 
     // Starts a new thread
     void _StartThread(bool need_lock);
@@ -103,6 +205,45 @@ private:
     // Returns true if thread was removed from threads map, false if it cannot be finished due to low_watermark
     bool _TryUnregisterThread();
 
+    // Puts task into the lane, returns false if queue is full or lane is overloaded
+    bool _Enqueue(Priority priority, Task &&task);
+
+    // Task fulfilling promise with the function result
+    template <typename R, typename F> struct _Promised {
+        Promise<R> promise;
+        F function;
+
+        void operator()() { Fulfill(promise, function); }
+    };
+
+    template <typename R, typename F> static _Promised<R, F> _MakePromised(Promise<R> &&promise, F &&function) {
+        return _Promised<R, F>{std::move(promise), std::forward<F>(function)};
+    }
+
+    // Element of the task queue, nodes of executed tasks are kept in the free list and reused
+    struct _TaskNode {
+        Task task;
+        std::chrono::steady_clock::time_point enqueued;
+        _TaskNode *next = nullptr;
+    };
+
+    // Queue of the single priority
+    struct _Lane {
+        _TaskNode *head = nullptr;
+        _TaskNode *tail = nullptr;
+        size_t size = 0;
+
+        // Admission control: shortest wait in the current interval, and whether the previous one was above target
+        std::chrono::steady_clock::duration min_delay = std::chrono::steady_clock::duration::max();
+        std::chrono::steady_clock::time_point interval_end;
+        bool overloaded = false;
+    };
+
+    static const size_t _lanes_count = 3;
+
+    // Takes the next task, nullptr if there are none. Must be called under threadpool_mutex
+    _TaskNode *_Dequeue();
+
     /**
      * Mutex to protect state below from concurrent modification
      */
@@ -113,6 +254,11 @@ private:
      */
     std::condition_variable empty_condition;
 
+    /**
+     * Conditional variable to await the last thread to finish in Stop
+     */
+    std::condition_variable stop_condition;
+
     /**
      * Unordered map of actual threads that perorm execution
      * thread_id is the key
@@ -122,9 +268,13 @@ private:
     std::atomic<unsigned int> _count_free_threads;
 
     /**
-     * Task queue
+     * Task queue, lanes are indexed by Priority, total size could be read without lock
      */
-    std::deque<std::function<void()>> tasks;
+    _Lane _lanes[_lanes_count];
+    std::atomic<size_t> _tasks_size;
+
+    // Nodes of executed tasks
+    _TaskNode *_free_nodes;
 
     /**
      * Flag to stop bg threads
@@ -135,6 +285,27 @@ private:
     size_t _hight_watermark;
     size_t _max_queue_size;
     unsigned int _idle_time;
+
+    // Admission control parameters, zero target if disabled
+    std::chrono::steady_clock::duration _target_delay;
+    std::chrono::steady_clock::duration _delay_interval;
+
+    // Adaptive sizing, controller thread is running if enabled
+    bool _adaptive;
+    SizingPolicy _policy;
+    std::thread _controller;
+    std::condition_variable _controller_condition;
+
+    // Number of idle threads asked by controller to finish
+    size_t _threads_to_stop;
+
+    // Metrics, histogram and counters are protected by threadpool_mutex
+    uint64_t _wait_histogram[_wait_buckets];
+    uint64_t _executed;
+    uint64_t _rejected;
+
+    // Nanoseconds threads spent in tasks
+    std::atomic<uint64_t> _busy_time;
 };
 
 } // namespace Core
@@ -0,0 +1,161 @@
+#include "WorkStealingThreadPool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Afina {
+namespace Core {
+
+thread_local WorkStealingThreadPool *WorkStealingThreadPool::_current_pool = nullptr;
+thread_local size_t WorkStealingThreadPool::_current_index = 0;
+
+WorkStealingThreadPool::WorkStealingThreadPool() : _queued(0), _max_queue_size(0), _state(State::kStopped) {}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+    Stop(true);
+    _Task *task;
+    while (_free_tasks && _free_tasks->TryPop(task)) {
+        delete task;
+    }
+}
+
+void WorkStealingThreadPool::Start(size_t threads, size_t max_queue_size) {
+    THREADPOOL_CURRENT_PROCESS_DEBUG(__PRETTY_FUNCTION__);
+    if (_state.load() != State::kStopped || !_workers.empty()) {
+        throw std::logic_error("Work stealing thread pool is already started");
+    }
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    _max_queue_size = max_queue_size;
+    _injection.reset(new MPMCQueue<_Task *>(max_queue_size));
+    if (!_free_tasks || _free_tasks->Capacity() < max_queue_size) {
+        _Task *task;
+        while (_free_tasks && _free_tasks->TryPop(task)) {
+            delete task;
+        }
+        _free_tasks.reset(new MPMCQueue<_Task *>(max_queue_size));
+    }
+
+    // Deques exist before any thread starts: workers steal from each other from the very beginning
+    for (size_t i = 0; i < threads; i++) {
+        _workers.emplace_back(new _Worker());
+    }
+    _state.store(State::kRun);
+    for (size_t i = 0; i < threads; i++) {
+        _workers[i]->thread = std::thread(&WorkStealingThreadPool::_ThreadFunction, this, i);
+    }
+}
+
+void WorkStealingThreadPool::Stop(bool await) {
+    THREADPOOL_CURRENT_PROCESS_DEBUG(__PRETTY_FUNCTION__);
+    State expected = State::kRun;
+    if (_state.compare_exchange_strong(expected, State::kStopping)) {
+        _event.NotifyAll();
+    }
+    if (!await || _workers.empty()) {
+        return;
+    }
+
+    for (auto &worker : _workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    _workers.clear();
+    _state.store(State::kStopped);
+}
+
+void WorkStealingThreadPool::_ThreadFunction(size_t index) {
+    THREADPOOL_CURRENT_PROCESS_DEBUG(__PRETTY_FUNCTION__);
+    _current_pool = this;
+    _current_index = index;
+
+    while (true) {
+        _Task *task = _Take(index);
+        if (task == nullptr) {
+            // Nothing anywhere: announce sleep and look once more, task could be pushed before the announce
+            EventCount::Key key = _event.PrepareWait();
+            task = _Take(index);
+            if (task == nullptr) {
+                if (_state.load() != State::kRun && _queued.load() == 0) {
+                    _event.CancelWait();
+                    break;
+                }
+                _event.Wait(key);
+                continue;
+            }
+            _event.CancelWait();
+        }
+
+        try {
+            task->function();
+        } catch (std::exception &exc) {
+            THREADPOOL_CURRENT_PROCESS_DEBUG("EXCEPTION during the execution of the task: " << exc.what());
+        }
+        task->function.Reset();
+        if (!_free_tasks->TryPush(task)) {
+            delete task;
+        }
+    }
+
+    _current_pool = nullptr;
+    THREADPOOL_CURRENT_PROCESS_DEBUG(__PRETTY_FUNCTION__ << " was finished");
+}
+
+bool WorkStealingThreadPool::_Submit(Task &&function) {
+    _Task *task;
+    if (!_free_tasks->TryPop(task)) {
+        task = new _Task();
+    }
+    task->function = std::move(function);
+
+    if (!_Push(task)) {
+        task->function.Reset();
+        if (!_free_tasks->TryPush(task)) {
+            delete task;
+        }
+        _Unqueue();
+        return false;
+    }
+    return true;
+}
+
+bool WorkStealingThreadPool::_Push(_Task *task) {
+    if (_current_pool == this) {
+        _workers[_current_index]->tasks.Push(task);
+    } else if (!_injection->TryPush(task)) {
+        return false;
+    }
+
+    _event.NotifyOne();
+    return true;
+}
+
+WorkStealingThreadPool::_Task *WorkStealingThreadPool::_Take(size_t index) {
+    _Task *task = nullptr;
+    if (_workers[index]->tasks.Pop(task) || _injection->TryPop(task)) {
+        _Unqueue();
+        return task;
+    }
+
+    // Victims are tried in order starting from the next worker, so thieves spread over different deques
+    for (size_t i = 1; i < _workers.size(); i++) {
+        if (_workers[(index + i) % _workers.size()]->tasks.Steal(task)) {
+            _Unqueue();
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void WorkStealingThreadPool::_Unqueue() {
+    // The last task of the stopping pool is taken, workers sleeping in the meanwhile should see it and exit
+    if (_queued.fetch_sub(1) == 1 && _state.load() != State::kRun) {
+        _event.NotifyAll();
+    }
+}
+
+} // namespace Core
+} // namespace Afina
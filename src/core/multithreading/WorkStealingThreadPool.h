@@ -0,0 +1,117 @@
+#ifndef AFINA_WORK_STEALING_THREADPOOL_H
+#define AFINA_WORK_STEALING_THREADPOOL_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <afina/core/Debug.h>
+#include <afina/core/EventCount.h>
+#include <afina/core/MPMCQueue.h>
+#include <afina/core/WorkStealingDeque.h>
+
+#include "Task.h"
+#include "ThreadPool.h"
+
+namespace Afina {
+namespace Core {
+
+/**
+ * # Work stealing thread pool
+ * Fixed number of threads without a lock on the task path. Each worker has own Chase-Lev deque: tasks submitted
+ * from inside of a task go there and are taken by the owner in LIFO order, while they are hot in its cache.
+ * Tasks from other threads go through the bounded lock-free injection queue. Worker without tasks takes them
+ * from the injection queue, then steals from the other workers, and once there is nothing anywhere sleeps on
+ * the futex based event count. Submitting costs a CAS and a fence when no worker sleeps.
+ *
+ * Interface follows ThreadPool, so it could replace it where tasks are independent
+ */
+class WorkStealingThreadPool {
+public:
+    using State = ThreadPool::State;
+
+    WorkStealingThreadPool();
+    ~WorkStealingThreadPool();
+
+    WorkStealingThreadPool(const WorkStealingThreadPool &) = delete;
+    WorkStealingThreadPool &operator=(const WorkStealingThreadPool &) = delete;
+
+    /**
+     * Starts the given number of threads (number of cores if 0). No more then max_queue_size tasks could wait
+     * for execution at once
+     */
+    void Start(size_t threads = 0, size_t max_queue_size = 1024);
+
+    /**
+     * Stops accepting new tasks, threads finish once all queued tasks are done. If await is set then call
+     * doesn't return until that
+     */
+    void Stop(bool await = false);
+
+    State GetState() const { return _state; }
+
+    /**
+     * Adds function to be executed on the pool, returns false if pool isn't running or queue is full. Doesn't
+     * wait for function result
+     */
+    template <typename F, typename... Types> bool Execute(F &&func, Types... args) {
+        // Counted before state is checked: workers don't exit while some task is on the way to the queue
+        if (_queued.fetch_add(1) >= _max_queue_size) {
+            _queued.fetch_sub(1);
+            return false;
+        }
+        if (_state.load() != State::kRun) {
+            _Unqueue();
+            return false;
+        }
+
+        return _Submit(Task::Bind(std::forward<F>(func), std::forward<Types>(args)...));
+    }
+
+private:
+    // Node passed through the queues, nodes of executed tasks are reused by the next submissions
+    struct _Task {
+        Task function;
+    };
+
+    struct _Worker {
+        WorkStealingDeque<_Task *> tasks;
+        std::thread thread;
+    };
+
+    // Main function of the worker thread
+    void _ThreadFunction(size_t index);
+
+    // Wraps task into a free node and pushes it, task is already counted in _queued
+    bool _Submit(Task &&function);
+
+    // Puts task into the deque of the current worker or into the injection queue and wakes up a sleeping worker
+    bool _Push(_Task *task);
+
+    // Takes task from own deque, injection queue or other workers, nullptr if there are none
+    _Task *_Take(size_t index);
+
+    // Task is taken from queue or its submission failed
+    void _Unqueue();
+
+    std::vector<std::unique_ptr<_Worker>> _workers;
+    std::unique_ptr<MPMCQueue<_Task *>> _injection;
+    std::unique_ptr<MPMCQueue<_Task *>> _free_tasks;
+    EventCount _event;
+
+    // Tasks submitted and not taken yet
+    std::atomic<size_t> _queued;
+    size_t _max_queue_size;
+
+    std::atomic<State> _state;
+
+    // Pool and worker the current thread belongs to
+    static thread_local WorkStealingThreadPool *_current_pool;
+    static thread_local size_t _current_index;
+};
+
+} // namespace Core
+} // namespace Afina
+
+#endif // AFINA_WORK_STEALING_THREADPOOL_H
@@ -1,28 +1,159 @@
 #include <afina/coroutine/Engine.h>
+#include <afina/coroutine/Scheduler.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <limits>
+#include <mutex>
 #include <setjmp.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <thread>
 #include <unistd.h>
 
+#ifndef AFINA_COROUTINE_UCONTEXT
+/**
+ * void afina_coroutine_switch(void **from_sp, void *to_sp)
+ * Pushes callee-saved registers of System V ABI on the current stack, saves stack pointer to *from_sp, switches to
+ * to_sp and pops registers saved there. Everything else is saved by the caller according to the ABI
+ *
+ * void afina_coroutine_trampoline()
+ * Initial return address of a new coroutine: calls function from r12 with argument from rbx, function never returns
+ */
+asm(R"(
+    .text
+    .globl afina_coroutine_switch
+    .type afina_coroutine_switch, @function
+afina_coroutine_switch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size afina_coroutine_switch, .-afina_coroutine_switch
+
+    .globl afina_coroutine_trampoline
+    .type afina_coroutine_trampoline, @function
+afina_coroutine_trampoline:
+    .cfi_startproc
+    .cfi_undefined rip
+    movq %rbx, %rdi
+    callq *%r12
+    ud2
+    .cfi_endproc
+    .size afina_coroutine_trampoline, .-afina_coroutine_trampoline
+)");
+
+extern "C" void afina_coroutine_switch(void **from_sp, void *to_sp);
+extern "C" void afina_coroutine_trampoline();
+#endif
+
 namespace Afina {
 namespace Coroutine {
 
 int Engine::_stack_direction = 0;
+const size_t Engine::_poll_interval;
+const size_t Engine::no_timer;
+thread_local Engine *Engine::_current = nullptr;
+
+__attribute__((noinline)) Engine *Engine::_Current() { return _current; }
 
 Engine::~Engine() {
+    // Routines waiting for descriptors are in blocked list as well
+    for (context *pc : _timers) {
+        if (pc->WaitFd < 0) {
+            _DeleteContext(pc);
+        }
+    }
+
     while (alive != nullptr) {
         if (cur_routine == alive) {
             cur_routine = nullptr;
         }
         context *next = alive->next;
-        delete alive;
+        _DeleteContext(alive);
         alive = next;
     }
+    while (blocked != nullptr) {
+        if (cur_routine == blocked) {
+            cur_routine = nullptr;
+        }
+        context *next = blocked->next;
+        _DeleteContext(blocked);
+        blocked = next;
+    }
 
+    if (cur_routine != nullptr && cur_routine != idle_ctx) {
+        _DeleteContext(cur_routine);
+    }
     // delete nullptr; - no effect command
-    /*if (cur_routine != nullptr) */ delete cur_routine;
     /*if (idle_ctx != nullptr)    */ delete idle_ctx;
+    if (_zombie != nullptr) {
+        _DeleteContext(_zombie);
+    }
+
+    context *pc = nullptr;
+    while (_ready.Pop(pc)) {
+        _DeleteContext(pc);
+    }
+
+    if (_epoll_fd >= 0) {
+        close(_epoll_fd);
+        close(_interrupt_fd);
+    }
+    if (_notify_fd >= 0) {
+        close(_notify_fd);
+    }
+}
+
+void Engine::_DeleteContext(context *pc) {
+    if (pc->OwnStack == nullptr) {
+        delete pc;
+        return;
+    }
+
+    char *stack = pc->OwnStack;
+    StackPool *pool = pc->Pool;
+    pc->~context();
+    if (pool == &_stack_pool) {
+        _stack_pool.Release(stack);
+    } else {
+        _stack_pool.Adopt(stack, *pool);
+    }
+}
+
+void Engine::_Unlink(context *&list, context *pc) {
+    if (pc->prev != nullptr) {
+        pc->prev->next = pc->next;
+    }
+    if (pc->next != nullptr) {
+        pc->next->prev = pc->prev;
+    }
+    if (list == pc) {
+        list = pc->next;
+    }
+    pc->prev = pc->next = nullptr;
+}
+
+void Engine::_Link(context *&list, context *pc) {
+    pc->prev = nullptr;
+    pc->next = list;
+    list = pc;
+    if (pc->next != nullptr) {
+        pc->next->prev = pc;
+    }
 }
 
 void Engine::Store(context &ctx) {
@@ -32,11 +163,13 @@ void Engine::Store(context &ctx) {
     ASSERT(ctx.Low() < ctx.Hight() && ctx.Low() != nullptr);
 
     size_t stack_size = ctx.Hight() - ctx.Low();
-    char *stack = (char *)calloc(stack_size, sizeof(char));
-    memcpy(stack, ctx.Low(), stack_size);
-
-    ctx.RemoveStack();
-    ctx.Stack = stack;
+    if (ctx.StackCapacity < stack_size) {
+        ctx.RemoveStack();
+        ctx.Stack = static_cast<char *>(malloc(stack_size));
+        ASSERT(ctx.Stack != nullptr);
+        ctx.StackCapacity = stack_size;
+    }
+    memcpy(ctx.Stack, ctx.Low(), stack_size);
 }
 
 void Engine::Restore(context &ctx) {
@@ -47,7 +180,9 @@ void Engine::Restore(context &ctx) {
 }
 
 void Engine::_Rewind(context &ctx) {
-    char stack_marker = 0;
+    // Volatile store after the recursive call keeps the frame, otherwise optimizer turns recursion into a loop
+    // and stack never grows
+    volatile char stack_marker = 0;
 
     ASSERT(_stack_direction != 0);
 
@@ -71,6 +206,25 @@ void Engine::_Rewind(context &ctx) {
 }
 
 void Engine::yield() {
+    if (_scheduler != nullptr) {
+        _Current()->_ScheduledYield();
+        return;
+    }
+
+    if (_mode == StackMode::Separate) {
+        if (_HasWaiters() && ++_yields_since_poll >= _poll_interval) {
+            _Poll(0);
+        }
+        _DrainRemote();
+
+        // Round robin over alive list, idle context starts from its head
+        context *next = (cur_routine != idle_ctx && cur_routine->next != nullptr) ? cur_routine->next : alive;
+        if (next != nullptr) {
+            _Switch(*cur_routine, *next);
+        }
+        return;
+    }
+
     if (alive == nullptr) {
         return;
     }
@@ -82,6 +236,12 @@ void Engine::yield() {
 
 void Engine::sched(void *routine_) {
     context &ctx = *(static_cast<context *>(routine_));
+    ASSERT(_scheduler == nullptr);
+    if (_mode == StackMode::Separate) {
+        _Switch(*cur_routine, ctx);
+        return;
+    }
+
     if (cur_routine != idle_ctx) { // Function was called from scheduller
         Store(*cur_routine);       // Because storing of idle_ctx presented in start function
         if (setjmp(cur_routine->Environment) > 0) {
@@ -92,5 +252,546 @@ void Engine::sched(void *routine_) {
     Restore(ctx);
 }
 
+Engine::context *Engine::_CreateSeparate(size_t task_size, size_t task_align, void *&task_place) {
+    ASSERT(_stack_pool.StackSize() >= sizeof(context) + task_size + 1024);
+    char *stack = _stack_pool.Acquire();
+
+    // Context and task take the top of the stack, coroutine frames start below them
+    uintptr_t top = reinterpret_cast<uintptr_t>(stack + _stack_pool.MappingSize());
+    uintptr_t context_place = (top - sizeof(context)) & ~(uintptr_t)(alignof(context) - 1);
+    context *pc = new (reinterpret_cast<void *>(context_place)) context();
+    pc->OwnStack = stack;
+    pc->Pool = &_stack_pool;
+
+    task_place = reinterpret_cast<void *>((context_place - task_size) & ~(uintptr_t)(task_align - 1));
+    return pc;
+}
+
+void Engine::_PrepareSeparate(context *pc) {
+    uintptr_t top = reinterpret_cast<uintptr_t>(pc->Task) & ~(uintptr_t)15;
+
+#ifdef AFINA_COROUTINE_UCONTEXT
+    ASSERT(getcontext(&pc->Ucontext) == 0);
+    pc->Ucontext.uc_stack.ss_sp = pc->OwnStack + _stack_pool.GuardSize();
+    pc->Ucontext.uc_stack.ss_size = top - reinterpret_cast<uintptr_t>(pc->Ucontext.uc_stack.ss_sp);
+    pc->Ucontext.uc_link = nullptr;
+
+    // makecontext passes int arguments only
+    uintptr_t engine = reinterpret_cast<uintptr_t>(this);
+    makecontext(&pc->Ucontext, reinterpret_cast<void (*)()>(&Engine::_UcontextEntry), 2, int(engine >> 32),
+                int(engine & 0xffffffff));
+#else
+    // Frame afina_coroutine_switch pops: r15, r14, r13, r12, rbx, rbp and return address. Trampoline starts with
+    // 16-byte aligned stack as it is required before call instruction
+    void **frame = reinterpret_cast<void **>(top) - 7;
+    frame[0] = frame[1] = frame[2] = nullptr;
+    frame[3] = reinterpret_cast<void *>(&Engine::_SeparateEntry);
+    frame[4] = this;
+    frame[5] = nullptr;
+    frame[6] = reinterpret_cast<void *>(&afina_coroutine_trampoline);
+    pc->StackPointer = frame;
+#endif
+
+    if (_scheduler != nullptr) {
+        _scheduler->_live.fetch_add(1);
+    }
+    _MakeReady(pc);
+}
+
+void Engine::_Switch(context &from, context &to) {
+    cur_routine = &to;
+    if (&from == &to) {
+        return; // stack pointer of the running coroutine isn't saved yet
+    }
+
+#ifdef AFINA_COROUTINE_UCONTEXT
+    ASSERT(swapcontext(&from.Ucontext, &to.Ucontext) == 0);
+#else
+    afina_coroutine_switch(&from.StackPointer, to.StackPointer);
+#endif
+
+    // Here the switch back to "from" is done, possibly by another engine which has stolen it
+    Engine *engine = (_scheduler != nullptr) ? _Current() : this;
+    engine->_AfterSwitch();
+}
+
+void Engine::_SeparateEntry(Engine *engine) {
+    // Engine which created the coroutine isn't necessary the one running it
+    if (engine->_scheduler != nullptr) {
+        engine = _Current();
+    }
+    engine->_AfterSwitch();
+
+    context *pc = engine->cur_routine;
+    pc->Task->Run();
+    pc->Task->~_Task();
+    pc->Task = nullptr;
+
+    if (engine->_scheduler != nullptr) {
+        engine = _Current();
+    }
+
+    // Stack can't be released while we are on it, idle context will do that
+    engine->_Unlink(pc);
+    engine->_zombie = pc;
+    engine->_Switch(*pc, *engine->idle_ctx);
+}
+
+#ifdef AFINA_COROUTINE_UCONTEXT
+void Engine::_UcontextEntry(int engine_high, int engine_low) {
+    uintptr_t engine = (uintptr_t(unsigned(engine_high)) << 32) | uintptr_t(unsigned(engine_low));
+    _SeparateEntry(reinterpret_cast<Engine *>(engine));
+}
+#endif
+
+void Engine::_StartSeparate(void *main) {
+    Engine *previous = _current;
+    _current = this;
+    sched(main);
+
+    // Control comes here each time some coroutine finishes
+    while (true) {
+        _FreeZombie();
+        _DrainRemote();
+        if (alive != nullptr) {
+            yield();
+        } else if (_HasWaiters() || _parked.load() != 0) {
+            _Sleep();
+        } else {
+            // Remote unpark is done under the lock, engine doesn't exit (and get destroyed) in the middle of it
+            _LockRemote();
+            std::lock_guard<Core::SpinLock> guard(_remote_lock, std::adopt_lock);
+            if (!_remote_pending.load() && _parked.load() == 0) {
+                break;
+            }
+        }
+    }
+
+    delete idle_ctx;
+    idle_ctx = nullptr;
+    cur_routine = nullptr;
+    _current = previous;
+}
+
+void Engine::_FreeZombie() {
+    if (_zombie == nullptr) {
+        return;
+    }
+
+    _DeleteContext(_zombie);
+    _zombie = nullptr;
+    if (_scheduler != nullptr && _scheduler->_live.fetch_sub(1) == 1) {
+        _scheduler->_WakeAll(); // the last coroutine is done, engines should exit
+    }
+}
+
+void Engine::_InitPoller() {
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    VALIDATE_SYSTEM_FUNCTION(_epoll_fd);
+    _interrupt_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    VALIDATE_SYSTEM_FUNCTION(_interrupt_fd);
+    _notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    VALIDATE_SYSTEM_FUNCTION(_notify_fd);
+
+    // Interrupt and notification are the only events without coroutine attached
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    VALIDATE_SYSTEM_FUNCTION(epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _interrupt_fd, &event));
+    event.data.ptr = &_notify_fd;
+    VALIDATE_SYSTEM_FUNCTION(epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _notify_fd, &event));
+}
+
+uint32_t Engine::_WaitFd(int fd, uint32_t events, const clock::time_point *deadline) {
+    if (_scheduler != nullptr && _Current() != this) {
+        return _Current()->_WaitFd(fd, events, deadline);
+    }
+    ASSERT(_mode == StackMode::Separate && cur_routine != idle_ctx);
+    context *pc = cur_routine;
+
+    // One shot registration is disarmed after the event is reported, so stale events never reach coroutine which
+    // doesn't wait anymore. Descriptor stays registered, modification is the only syscall for the next waits
+    epoll_event event;
+    event.events = events | EPOLLONESHOT;
+    event.data.ptr = pc;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &event) != 0) {
+        VALIDATE_CONDITION(errno == ENOENT);
+        VALIDATE_SYSTEM_FUNCTION(epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event));
+    }
+
+    pc->WaitFd = fd;
+    pc->WaitEvents = 0;
+    _Unlink(alive, pc);
+    _Link(blocked, pc);
+    if (deadline != nullptr) {
+        _TimerAdd(pc, *deadline);
+    }
+
+    _Suspend(pc);
+    return pc->WaitEvents;
+}
+
+void Engine::sleep_until(clock::time_point deadline) {
+    Engine &self = _Self();
+    ASSERT(self._mode == StackMode::Separate && self.cur_routine != nullptr && self.cur_routine != self.idle_ctx);
+    context *pc = self.cur_routine;
+    pc->WaitEvents = 0;
+    self._Unlink(self.alive, pc);
+    self._TimerAdd(pc, deadline);
+    self._Suspend(pc);
+}
+
+void Engine::_Suspend(context *pc) {
+    // Other ready routine runs next, idle context polls descriptors once there are none
+    context *next = (_scheduler != nullptr) ? _TakeReady(false) : alive;
+    _Switch(*pc, (next != nullptr) ? *next : *idle_ctx);
+}
+
+void Engine::interrupt() {
+    uint64_t value = 1;
+    VALIDATE_SYSTEM_FUNCTION(write(_interrupt_fd, &value, sizeof(value)));
+}
+
+void Engine::_Poll(int timeout) {
+    _yields_since_poll = 0;
+
+    epoll_event events[64];
+    int count = epoll_wait(_epoll_fd, events, sizeof(events) / sizeof(events[0]), _TimerTimeout(timeout));
+    if (count < 0) {
+        VALIDATE_CONDITION(errno == EINTR);
+        count = 0;
+    }
+
+    // Woken up routines are collected first: in scheduler mode routine could be stolen and finished by other
+    // engine right after it is made ready, but the rest of the batch could still refer to it
+    context *woken = nullptr;
+    for (int i = 0; i < count; i++) {
+        context *pc = static_cast<context *>(events[i].data.ptr);
+        if (pc == reinterpret_cast<context *>(&_notify_fd)) {
+            uint64_t value;
+            while (read(_notify_fd, &value, sizeof(value)) > 0) {
+            }
+            continue;
+        }
+
+        if (pc != nullptr) {
+            if (pc->WaitFd < 0) {
+                continue; // already woken up by interrupt in this batch
+            }
+            pc->WaitFd = -1;
+            pc->WaitEvents = events[i].events;
+            if (pc->TimerIndex != no_timer) {
+                _TimerRemove(pc);
+            }
+            _Unlink(blocked, pc);
+            _Link(woken, pc);
+            continue;
+        }
+
+        // Interrupt: registrations of the blocked routines are removed, so they won't get late events
+        uint64_t value;
+        while (read(_interrupt_fd, &value, sizeof(value)) > 0) {
+        }
+        _TimerExpire(woken, false);
+        while (blocked != nullptr) {
+            pc = blocked;
+            epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, pc->WaitFd, nullptr);
+            pc->WaitFd = -1;
+            pc->WaitEvents = 0;
+            _Unlink(blocked, pc);
+            _Link(woken, pc);
+        }
+    }
+    _TimerExpire(woken, true);
+
+    while (woken != nullptr) {
+        context *pc = woken;
+        _Unlink(woken, pc);
+        _MakeReady(pc);
+    }
+}
+
+int Engine::_TimerTimeout(int timeout) const {
+    if (_timers.empty() || timeout == 0) {
+        return timeout;
+    }
+
+    // Rounded up, otherwise engine would spin in zero timeout waits during the last millisecond
+    clock::duration left = _timers[0]->Deadline - clock::now();
+    if (left <= clock::duration::zero()) {
+        return 0;
+    }
+    auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(left + std::chrono::milliseconds(1) -
+                                                                              clock::duration(1))
+                            .count();
+    if (timeout > 0 && milliseconds > timeout) {
+        return timeout;
+    }
+    return static_cast<int>(std::min<decltype(milliseconds)>(milliseconds, std::numeric_limits<int>::max()));
+}
+
+void Engine::_TimerExpire(context *&woken, bool expired_only) {
+    if (_timers.empty()) {
+        return;
+    }
+
+    clock::time_point now = clock::now();
+    while (!_timers.empty() && (!expired_only || _timers[0]->Deadline <= now)) {
+        context *pc = _timers[0];
+        _TimerRemove(pc);
+        if (pc->WaitFd >= 0) {
+            // Registration is removed, so late event doesn't reach the routine once it waits for something else
+            epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, pc->WaitFd, nullptr);
+            pc->WaitFd = -1;
+            _Unlink(blocked, pc);
+        }
+        pc->WaitEvents = 0;
+        _Link(woken, pc);
+    }
+}
+
+void Engine::_TimerAdd(context *pc, clock::time_point deadline) {
+    pc->Deadline = deadline;
+    pc->TimerIndex = _timers.size();
+    _timers.push_back(pc);
+    _TimerUp(pc->TimerIndex);
+}
+
+void Engine::_TimerRemove(context *pc) {
+    size_t index = pc->TimerIndex;
+    pc->TimerIndex = no_timer;
+
+    context *last = _timers.back();
+    _timers.pop_back();
+    if (last == pc) {
+        return;
+    }
+
+    // The last element takes place of the removed one and moves to where it belongs
+    _timers[index] = last;
+    last->TimerIndex = index;
+    _TimerUp(index);
+    _TimerDown(last->TimerIndex);
+}
+
+void Engine::_TimerUp(size_t index) {
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!(_timers[index]->Deadline < _timers[parent]->Deadline)) {
+            break;
+        }
+        _TimerSwap(index, parent);
+        index = parent;
+    }
+}
+
+void Engine::_TimerDown(size_t index) {
+    while (true) {
+        size_t smallest = index;
+        for (size_t child = 2 * index + 1; child <= 2 * index + 2 && child < _timers.size(); child++) {
+            if (_timers[child]->Deadline < _timers[smallest]->Deadline) {
+                smallest = child;
+            }
+        }
+        if (smallest == index) {
+            break;
+        }
+        _TimerSwap(index, smallest);
+        index = smallest;
+    }
+}
+
+void Engine::_TimerSwap(size_t a, size_t b) {
+    std::swap(_timers[a], _timers[b]);
+    _timers[a]->TimerIndex = a;
+    _timers[b]->TimerIndex = b;
+}
+
+void Engine::_Attach(Scheduler *scheduler, size_t index) {
+    ASSERT(_mode == StackMode::Separate && idle_ctx == nullptr);
+    _scheduler = scheduler;
+    _index = index;
+}
+
+void Engine::_MakeReady(context *pc) {
+    if (_scheduler == nullptr) {
+        _Link(alive, pc);
+        return;
+    }
+
+    _ready.Push(pc);
+    _scheduler->_Notify(this);
+}
+
+Engine::context *Engine::_TakeReady(bool steal) {
+    // Own deque is taken from the top as well, so coroutines run in FIFO order and yield is fair
+    context *pc = nullptr;
+    while (!_ready.Empty()) {
+        if (_ready.Steal(pc)) {
+            return pc;
+        }
+    }
+    return steal ? _scheduler->_Steal(this) : nullptr;
+}
+
+void Engine::_AfterSwitch() {
+    if (_unlock_after_switch != nullptr) {
+        Core::SpinLock *lock = _unlock_after_switch;
+        _unlock_after_switch = nullptr;
+        lock->unlock();
+    }
+    if (_yielded != nullptr) {
+        context *pc = _yielded;
+        _yielded = nullptr;
+        _MakeReady(pc);
+    }
+}
+
+void Engine::_ScheduledYield() {
+    ASSERT(cur_routine != idle_ctx);
+    if (_HasWaiters() && ++_yields_since_poll >= _poll_interval) {
+        _Poll(0);
+    }
+    _DrainRemote();
+
+    context *next = _TakeReady(false);
+    if (next == nullptr) {
+        return; // nothing else to run here, continue current coroutine
+    }
+    _yielded = cur_routine;
+    _Switch(*cur_routine, *next);
+}
+
+void Engine::_RunScheduled() {
+    Engine *previous = _current;
+    _current = this;
+    idle_ctx = new context();
+    cur_routine = idle_ctx;
+
+    while (true) {
+        _FreeZombie();
+        if (_HasWaiters() && ++_yields_since_poll >= _poll_interval) {
+            _Poll(0);
+        }
+        _DrainRemote();
+
+        context *next = _TakeReady(true);
+        if (next != nullptr) {
+            _Switch(*idle_ctx, *next);
+            continue;
+        }
+        if (_scheduler->_live.load() == 0) {
+            break;
+        }
+
+        // Nothing to run: announce sleep, check deques once more as work could be pushed before the flag was
+        // seen, then sleep until own descriptor is ready or other engine pushes work
+        _sleeping.store(true);
+        _scheduler->_sleepers.fetch_add(1);
+        next = _TakeReady(true);
+        if (next == nullptr && _scheduler->_live.load() != 0 && !_remote_pending.load()) {
+            _Poll(-1);
+        }
+        _scheduler->_sleepers.fetch_sub(1);
+        _sleeping.store(false);
+
+        if (next != nullptr) {
+            _Switch(*idle_ctx, *next);
+        }
+    }
+
+    delete idle_ctx;
+    idle_ctx = nullptr;
+    cur_routine = nullptr;
+    _current = previous;
+}
+
+bool Engine::_Wake() {
+    if (!_sleeping.load(std::memory_order_relaxed) || !_sleeping.exchange(false)) {
+        return false;
+    }
+
+    uint64_t value = 1;
+    VALIDATE_SYSTEM_FUNCTION(write(_notify_fd, &value, sizeof(value)));
+    return true;
+}
+
+void Engine::park(Core::SpinLock &lock) {
+    Engine &self = _Self();
+    ASSERT(self._mode == StackMode::Separate && self.cur_routine != nullptr && self.cur_routine != self.idle_ctx);
+    context *pc = self.cur_routine;
+    pc->ParkedOn = &self;
+    self._parked.fetch_add(1);
+    self._unlock_after_switch = &lock;
+    self._Unlink(self.alive, pc);
+
+    self._Suspend(pc);
+}
+
+void Engine::unpark(void *routine) {
+    context *pc = static_cast<context *>(routine);
+    Engine *owner = pc->ParkedOn;
+    ASSERT(owner != nullptr);
+    pc->ParkedOn = nullptr;
+
+    // Any engine of the scheduler could run the routine, but only owner thread could push to engine's deque
+    Engine *self = _Current();
+    if (self == owner || (self != nullptr && owner->_scheduler != nullptr && self->_scheduler == owner->_scheduler)) {
+        self->_MakeReady(pc);
+        owner->_parked.fetch_sub(1);
+    } else {
+        owner->_RemoteReady(pc);
+    }
+}
+
+void Engine::_RemoteReady(context *pc) {
+    // All is done under the lock, which engine takes before it exits: once the lock is released the engine could be
+    // destroyed. Counter is decremented together with publishing, otherwise engine could run the routine to the end
+    // and go to sleep on the not yet decremented counter with nobody left to wake it up
+    std::lock_guard<Core::SpinLock> guard(_remote_lock);
+    _remote.push_back(pc);
+    _parked.fetch_sub(1);
+
+    // Pairs with _Sleep(): either engine sees the flag or we see it is sleeping
+    _remote_pending.store(true);
+    if (_sleeping.load() && _sleeping.exchange(false)) {
+        uint64_t value = 1;
+        VALIDATE_SYSTEM_FUNCTION(write(_notify_fd, &value, sizeof(value)));
+    }
+}
+
+void Engine::_DrainRemote() {
+    if (!_remote_pending.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::vector<context *> ready;
+    {
+        _LockRemote();
+        std::lock_guard<Core::SpinLock> guard(_remote_lock, std::adopt_lock);
+        _remote_pending.store(false);
+        ready.swap(_remote);
+    }
+    for (context *pc : ready) {
+        _MakeReady(pc);
+    }
+}
+
+void Engine::_LockRemote() {
+    // Unparking thread holds the lock while it wakes engine up, on a single core spinning woken engine would burn the
+    // whole time slice of the thread it waits for
+    while (!_remote_lock.try_lock()) {
+        std::this_thread::yield();
+    }
+}
+
+void Engine::_Sleep() {
+    _sleeping.store(true);
+    if (!_remote_pending.load()) {
+        _Poll(-1);
+    }
+    _sleeping.store(false);
+}
+
 } // namespace Coroutine
 } // namespace Afina
@@ -0,0 +1,85 @@
+#include <afina/coroutine/Scheduler.h>
+
+#include <algorithm>
+
+#include <unistd.h>
+
+namespace Afina {
+namespace Coroutine {
+
+Scheduler::Scheduler(size_t threads, size_t stack_size) : _live(0), _sleepers(0) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        _engines.emplace_back(new Engine(Engine::StackMode::Separate, stack_size));
+        _engines.back()->_Attach(this, i);
+    }
+}
+
+Scheduler::~Scheduler() {}
+
+void Scheduler::interrupt() {
+    for (auto &engine : _engines) {
+        engine->interrupt();
+    }
+}
+
+void Scheduler::_Run() {
+    auto run = [](Engine *engine) {
+        try {
+            engine->_RunScheduled();
+        } catch (std::exception &exc) {
+            CURRENT_PROCESS_DEBUG("EXCEPTION in coroutine scheduler thread: " << exc.what());
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < _engines.size(); i++) {
+        threads.emplace_back(run, _engines[i].get());
+    }
+    run(_engines[0].get());
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+Engine::context *Scheduler::_Steal(Engine *thief) {
+    // Victims are checked starting from the next engine, so thieves don't all attack the first one
+    Engine::context *pc = nullptr;
+    for (size_t i = 1; i < _engines.size(); i++) {
+        Engine &victim = *_engines[(thief->_index + i) % _engines.size()];
+        while (!victim._ready.Empty()) {
+            if (victim._ready.Steal(pc)) {
+                return pc;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void Scheduler::_Notify(Engine *pusher) {
+    // Pairs with sleeping engine which increments _sleepers and then checks deques
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleepers.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    for (size_t i = 1; i < _engines.size(); i++) {
+        if (_engines[(pusher->_index + i) % _engines.size()]->_Wake()) {
+            return;
+        }
+    }
+}
+
+void Scheduler::_WakeAll() {
+    for (auto &engine : _engines) {
+        uint64_t value = 1;
+        VALIDATE_SYSTEM_FUNCTION(write(engine->_notify_fd, &value, sizeof(value)));
+    }
+}
+
+} // namespace Coroutine
+} // namespace Afina
@@ -0,0 +1,77 @@
+#include <afina/coroutine/StackPool.h>
+
+#include <algorithm>
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <afina/core/Debug.h>
+
+namespace Afina {
+namespace Coroutine {
+
+StackPool::StackPool(size_t stack_size, size_t hot_stacks)
+    : _page_size(sysconf(_SC_PAGESIZE)), _hot_stacks(hot_stacks), _mapped(0), _discarded(0) {
+    _stack_size = (stack_size + _page_size - 1) / _page_size * _page_size;
+}
+
+StackPool::~StackPool() {
+    if (_mapped != _free.size()) {
+        CURRENT_PROCESS_DEBUG("EXCEPTION: " << _mapped - _free.size() << " coroutine stacks are still in use");
+    }
+    Trim();
+}
+
+char *StackPool::Acquire() {
+    if (!_free.empty()) {
+        char *stack = _free.back();
+        _free.pop_back();
+        _discarded = std::min(_discarded, _free.size());
+        return stack;
+    }
+
+    void *memory = mmap(nullptr, MappingSize(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (memory == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+    // Stack grows down, so overflow hits the lowest page
+    if (mprotect(memory, _page_size, PROT_NONE) != 0) {
+        munmap(memory, MappingSize());
+        throw std::bad_alloc();
+    }
+
+    _mapped++;
+    return static_cast<char *>(memory);
+}
+
+void StackPool::Release(char *stack) {
+    _free.push_back(stack);
+
+    // Stack which has just left the hot part of the pool won't be needed soon. Stacks below it are discarded
+    // already, they stay cold until taken back
+    while (_free.size() > _hot_stacks + _discarded) {
+        madvise(_free[_discarded] + _page_size, _stack_size, MADV_DONTNEED);
+        _discarded++;
+    }
+}
+
+void StackPool::Adopt(char *stack, StackPool &owner) {
+    ASSERT(owner.MappingSize() == MappingSize());
+    owner._mapped.fetch_sub(1, std::memory_order_relaxed);
+    _mapped.fetch_add(1, std::memory_order_relaxed);
+    Release(stack);
+}
+
+void StackPool::Trim() {
+    for (char *stack : _free) {
+        munmap(stack, MappingSize());
+    }
+    _mapped -= _free.size();
+    _free.clear();
+    _discarded = 0;
+}
+
+} // namespace Coroutine
+} // namespace Afina
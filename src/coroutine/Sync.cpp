@@ -0,0 +1,146 @@
+#include <afina/coroutine/Sync.h>
+
+#include <mutex>
+
+namespace Afina {
+namespace Coroutine {
+
+WaitQueue::Waiter::Waiter(void *data_p) : routine(nullptr), next(nullptr), data(data_p), result(false) {
+    Engine *engine = Engine::current();
+    ASSERT(engine != nullptr);
+    routine = engine->current_routine();
+    ASSERT(routine != nullptr);
+}
+
+void WaitQueue::Push(Waiter *waiter) {
+    waiter->next = nullptr;
+    if (_tail == nullptr) {
+        _head = waiter;
+    } else {
+        _tail->next = waiter;
+    }
+    _tail = waiter;
+}
+
+WaitQueue::Waiter *WaitQueue::Pop() {
+    Waiter *waiter = _head;
+    if (waiter != nullptr) {
+        _head = waiter->next;
+        if (_head == nullptr) {
+            _tail = nullptr;
+        }
+    }
+    return waiter;
+}
+
+void WaitQueue::Wait(Core::SpinLock &lock, WaitQueue &queue, Waiter &waiter) {
+    queue.Push(&waiter);
+    Engine::current()->park(lock);
+}
+
+void Mutex::lock() {
+    _guard.lock();
+    if (!_locked) {
+        _locked = true;
+        _guard.unlock();
+        return;
+    }
+
+    // Mutex stays locked, unlock() passes it to this routine
+    WaitQueue::Waiter waiter;
+    WaitQueue::Wait(_guard, _waiters, waiter);
+}
+
+bool Mutex::try_lock() {
+    std::lock_guard<Core::SpinLock> guard(_guard);
+    if (_locked) {
+        return false;
+    }
+    _locked = true;
+    return true;
+}
+
+void Mutex::unlock() {
+    _guard.lock();
+    ASSERT(_locked);
+    WaitQueue::Waiter *next = _waiters.Pop();
+    if (next == nullptr) {
+        _locked = false;
+    }
+    _guard.unlock();
+
+    // Routine can't leave park() before it is unparked, so its waiter is still alive here
+    if (next != nullptr) {
+        Engine::unpark(next->routine);
+    }
+}
+
+void ConditionVariable::wait(Mutex &mutex) {
+    _guard.lock();
+    WaitQueue::Waiter waiter;
+
+    // Mutex is unlocked under the guard, so notification sent right after that finds this routine waiting
+    mutex.unlock();
+    WaitQueue::Wait(_guard, _waiters, waiter);
+    mutex.lock();
+}
+
+void ConditionVariable::notify_one() {
+    _guard.lock();
+    WaitQueue::Waiter *waiter = _waiters.Pop();
+    _guard.unlock();
+    if (waiter != nullptr) {
+        Engine::unpark(waiter->routine);
+    }
+}
+
+void ConditionVariable::notify_all() {
+    _guard.lock();
+    WaitQueue waiters = _waiters;
+    _waiters = WaitQueue();
+    _guard.unlock();
+
+    // Next is read before unpark, after that waiter could be gone
+    for (WaitQueue::Waiter *waiter = waiters.Pop(); waiter != nullptr; waiter = waiters.Pop()) {
+        Engine::unpark(waiter->routine);
+    }
+}
+
+void Semaphore::acquire() {
+    _guard.lock();
+    if (_count > 0) {
+        _count--;
+        _guard.unlock();
+        return;
+    }
+
+    // release() hands unit over to this routine directly
+    WaitQueue::Waiter waiter;
+    WaitQueue::Wait(_guard, _waiters, waiter);
+}
+
+bool Semaphore::try_acquire() {
+    std::lock_guard<Core::SpinLock> guard(_guard);
+    if (_count == 0) {
+        return false;
+    }
+    _count--;
+    return true;
+}
+
+void Semaphore::release(size_t count) {
+    WaitQueue woken;
+    _guard.lock();
+    for (; count > 0 && !_waiters.Empty(); count--) {
+        woken.Push(_waiters.Pop());
+    }
+    _count += count;
+    _guard.unlock();
+
+    for (WaitQueue::Waiter *waiter = woken.Pop(); waiter != nullptr; waiter = woken.Pop()) {
+        Engine::unpark(waiter->routine);
+    }
+}
+
+} // namespace Coroutine
+} // namespace Afina
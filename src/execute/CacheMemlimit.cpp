@@ -0,0 +1,37 @@
+#include <afina/Storage.h>
+#include <afina/execute/CacheMemlimit.h>
+
+#include <cstdint>
+#include <iostream>
+
+namespace Afina {
+namespace Execute {
+
+bool CacheMemlimit::ExtractArguments(std::string &args_str) {
+    Command::ExtractArguments(args_str); //" noreply"
+
+    std::stringstream sstream(args_str);
+    sstream >> _megabytes;
+
+    return !sstream.fail() && sstream.eof() && args_str.find('-') == std::string::npos;
+}
+
+void CacheMemlimit::Execute(Storage &storage, const std::string & /* args */, std::string &out) const {
+    std::cout << "CacheMemlimit(" << _megabytes << ")" << std::endl;
+    if (_megabytes < 1) {
+        out = "MEMLIMIT_TOO_SMALL cannot set maxbytes to less than 1m";
+    } else if (_megabytes > (SIZE_MAX >> 20)) {
+        out = "CLIENT_ERROR memory limit is too big";
+    } else if (!storage.SetMaxMemoryLimit(_megabytes << 20)) {
+        out = "SERVER_ERROR storage doesn't support resizing";
+    } else {
+        out = "OK";
+    }
+
+    if (_no_reply) {
+        out.clear();
+    }
+}
+
+} // namespace Execute
+} // namespace Afina
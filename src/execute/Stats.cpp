@@ -3,12 +3,35 @@
 
 #include <iostream>
 #include <iterator>
+#include <map>
 #include <sstream>
 
 namespace Afina {
 namespace Execute {
 
-void Stats::Execute(Storage &storage, const std::string &args, std::string &out) const { out.assign("END"); }
+/* memcached protocol:
+
+Server responds with a list of lines:
+
+STAT <name> <value>\r\n
+
+and terminates the list with the line
+"END\r\n"
+
+*/
+
+void Stats::Execute(Storage &storage, const std::string &args, std::string &out) const {
+    std::map<std::string, std::string> stats;
+    storage.GetStatistics(stats);
+
+    std::stringstream outStream;
+    for (auto &stat : stats) {
+        outStream << "STAT " << stat.first << " " << stat.second << "\r\n";
+    }
+    outStream << "END"; // networking layer should add the last \r\n
+
+    out = outStream.str();
+}
 
 } // namespace Execute
 } // namespace Afina
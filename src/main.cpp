@@ -1,7 +1,10 @@
 #include <chrono>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <memory>
 #include <uv.h>
+#include <vector>
 
 #include <cxxopts.hpp>
 
@@ -12,15 +15,22 @@
 #include "pipes/FIFOServer.h"
 
 #include "network/blocking/ServerImpl.h"
+#include "network/coroutine/ServerImpl.h"
 #include "network/nonblocking/ServerImpl.h"
 #include "network/uv/ServerImpl.h"
+
+#include "core/memory/SlabPool.h"
 #include "storage/MapBasedFCImpl.h"
 #include "storage/MapBasedGlobalLockImpl.h"
+#include "storage/MapBasedShardedFCImpl.h"
+#include "storage/MapBasedSharedNothingImpl.h"
+#include "storage/MemoryPressureMonitor.h"
 
 typedef struct {
     std::shared_ptr<Afina::Storage> storage;
     std::shared_ptr<Afina::Network::Server> server;
     std::shared_ptr<Afina::FIFONamespace::FIFOServer> fifo;
+    std::shared_ptr<Afina::Backend::MemoryPressureMonitor> memory_monitor;
 } Application;
 
 // Handle all signals catched
@@ -35,6 +45,14 @@ void signal_handler(uv_signal_t *handle, int signum) {
 void timer_handler(uv_timer_t *handle) {
     Application *pApp = static_cast<Application *>(handle->data);
     std::cout << "Start passive metrics collection" << std::endl;
+
+    std::map<std::string, std::string> stats;
+    if (pApp->server != nullptr) {
+        pApp->server->GetStatistics(stats);
+    }
+    for (auto &stat : stats) {
+        std::cout << "STAT " << stat.first << " " << stat.second << std::endl;
+    }
 }
 
 int main(int argc, char **argv) {
@@ -53,6 +71,21 @@ int main(int argc, char **argv) {
         // and simplify validation below
         options.add_options()("s,storage", "Type of storage service to use", cxxopts::value<std::string>());
         options.add_options()("n,network", "Type of network service to use", cxxopts::value<std::string>());
+        options.add_options()("shards", "Number of shards of sharded_fc_storage and shared_nothing, one per CPU by default",
+                              cxxopts::value<int>());
+        options.add_options()("hugepages", "Pages for storage memory: none, thp, 2mb, 1gb",
+                              cxxopts::value<std::string>());
+        options.add_options()("numa", "Pin network workers to NUMA nodes and interleave storage memory");
+        options.add_options()("pin-cores",
+                              "Pin nonblocking workers to CPUs and steer connections to the worker of their CPU");
+        options.add_options()("work-stealing", "Blocking server runs connections on the work stealing pool");
+        options.add_options()("queue-delay", "Blocking server sheds new connections once queued ones wait longer (ms)",
+                              cxxopts::value<int>());
+        options.add_options()("priority-client", "Blocking server runs connections from this IPv4 address first",
+                              cxxopts::value<std::vector<std::string>>());
+        options.add_options()("memory-monitor", "Shrink storage when cgroup v2 memory limit is close");
+        options.add_options()("idle-timeout", "Seconds coroutine server keeps idle connection open",
+                              cxxopts::value<int>());
         options.add_options()("r,read", "Reading FIFO name", cxxopts::value<std::string>());
         options.add_options()("w,write", "Writing FIFO name", cxxopts::value<std::string>());
         options.add_options()("h,help", "Print usage info");
@@ -77,16 +110,37 @@ int main(int argc, char **argv) {
         storage_type = options["storage"].as<std::string>();
     }
 
+    Afina::Core::HugePagesMode hugepages_mode = Afina::Core::HugePagesMode::None;
+    if (options.count("hugepages") > 0) {
+        hugepages_mode = Afina::Core::HugePageRegion::ParseMode(options["hugepages"].as<std::string>());
+    }
+
+    bool numa_aware = (options.count("numa") > 0);
+    Afina::Core::MemoryPlacement placement(hugepages_mode, numa_aware);
+
+    size_t max_size = std::numeric_limits<int>::max();
+    size_t shards = 0;
+    if (options.count("shards") > 0) {
+        shards = options["shards"].as<int>();
+    }
     if (storage_type == "map_global") {
-        app.storage = std::make_shared<Afina::Backend::MapBasedGlobalLockImpl>();
+        app.storage = std::make_shared<Afina::Backend::MapBasedGlobalLockImpl>(max_size, placement);
     } else {
         if (storage_type == "fc_storage") {
-            app.storage = std::make_shared<Afina::Backend::MapBasedFCImpl>();
+            app.storage = std::make_shared<Afina::Backend::MapBasedFCImpl>(max_size, placement);
+        } else if (storage_type == "sharded_fc_storage") {
+            app.storage = std::make_shared<Afina::Backend::MapBasedShardedFCImpl>(max_size, placement, shards);
+        } else if (storage_type == "shared_nothing") {
+            app.storage = std::make_shared<Afina::Backend::MapBasedSharedNothingImpl>(max_size, placement, shards);
         } else {
             throw std::runtime_error("Unknown storage type");
         }
     }
 
+    if (options.count("memory-monitor") > 0) {
+        app.memory_monitor = std::make_shared<Afina::Backend::MemoryPressureMonitor>(app.storage);
+    }
+
     // Build  & start network layer
     std::string network_type = "uv";
     if (options.count("network") > 0) {
@@ -96,9 +150,25 @@ int main(int argc, char **argv) {
     if (network_type == "uv") {
         app.server = std::make_shared<Afina::Network::UV::ServerImpl>(app.storage);
     } else if (network_type == "blocking") {
-        app.server = std::make_shared<Afina::Network::Blocking::ServerImpl>(app.storage);
+        std::chrono::milliseconds queue_delay(0);
+        if (options.count("queue-delay") > 0) {
+            queue_delay = std::chrono::milliseconds(options["queue-delay"].as<int>());
+        }
+        std::vector<std::string> priority_clients;
+        if (options.count("priority-client") > 0) {
+            priority_clients = options["priority-client"].as<std::vector<std::string>>();
+        }
+        app.server = std::make_shared<Afina::Network::Blocking::ServerImpl>(
+            app.storage, options.count("work-stealing") > 0, queue_delay, priority_clients);
     } else if (network_type == "nonblocking") {
-        app.server = std::make_shared<Afina::Network::NonBlocking::ServerImpl>(app.storage);
+        app.server = std::make_shared<Afina::Network::NonBlocking::ServerImpl>(app.storage, numa_aware,
+                                                                               options.count("pin-cores") > 0);
+    } else if (network_type == "coroutine") {
+        std::chrono::seconds idle_timeout(0);
+        if (options.count("idle-timeout") > 0) {
+            idle_timeout = std::chrono::seconds(options["idle-timeout"].as<int>());
+        }
+        app.server = std::make_shared<Afina::Network::Coroutine::ServerImpl>(app.storage, idle_timeout);
     } else {
         throw std::runtime_error("Unknown network type");
     }
@@ -136,6 +206,9 @@ int main(int argc, char **argv) {
     // Start services
     try {
         app.storage->Start();
+        if (app.memory_monitor != nullptr) {
+            app.memory_monitor->Start();
+        }
         app.server->Start(8080);
         if (app.fifo != nullptr) {
             app.fifo->Start(reading_fifo_name, writing_fifo_name);
@@ -152,6 +225,9 @@ int main(int argc, char **argv) {
             app.fifo->Stop();
             app.fifo->Join();
         }
+        if (app.memory_monitor != nullptr) {
+            app.memory_monitor->Stop();
+        }
         app.storage->Stop();
 
         std::cout << "Application stopped" << std::endl;
@@ -27,10 +27,23 @@ namespace Afina {
 namespace Network {
 namespace Blocking {
 
+const size_t ServerImpl::_max_queue_size;
+const size_t ServerImpl::_max_delayed_queue_size;
+
 // See Server.h
-ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> ps) :
-	Server(ps), _server_socket(-1), running(false), _is_finishing(false), listen_port(0), _thread_pool()
-{}
+ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> ps, bool work_stealing, std::chrono::milliseconds queue_delay,
+                       const std::vector<std::string> &priority_clients) :
+	Server(ps), _server_socket(-1), running(false), _is_finishing(false), listen_port(0), _thread_pool(),
+	_work_stealing(work_stealing), _queue_delay(queue_delay)
+{
+	for (auto &client : priority_clients) {
+		in_addr address;
+		if (inet_pton(AF_INET, client.c_str(), &address) != 1) {
+			throw std::invalid_argument("Bad priority client address: " + client);
+		}
+		_priority_clients.insert(address.s_addr);
+	}
+}
 
 // See Server.h
 ServerImpl::~ServerImpl() 
@@ -85,7 +98,14 @@ void ServerImpl::Start(uint16_t port, uint16_t n_workers) {
     // Note that, in this particular example, creating a "server thread" is redundant,
     // since there will only be one server thread, and the program's main thread (the
     // one running main()) could fulfill this purpose.
-    _thread_pool.Start(0, n_workers);
+    if (_work_stealing) {
+        _stealing_pool.Start(n_workers, _max_queue_size);
+    } else if (_queue_delay.count() != 0) {
+        _thread_pool.SetAdmissionControl(_queue_delay);
+        _thread_pool.Start(0, n_workers, _max_delayed_queue_size);
+    } else {
+        _thread_pool.Start(0, n_workers, _max_queue_size);
+    }
     
     running.store(true);
     if (pthread_create(&accept_thread, NULL, ServerImpl::RunMethodInDifferentThread<&ServerImpl::RunAcceptor>, this) < 0) {
@@ -109,6 +129,7 @@ void ServerImpl::Stop() {
 		}
 	}
 	_thread_pool.Stop(true);
+	_stealing_pool.Stop(true);
 
 	shutdown(_server_socket, SHUT_RDWR);
 	pthread_join(accept_thread, 0);
@@ -209,12 +230,12 @@ void ServerImpl::RunAcceptor() {
 		{
 			//Block mutex for work with connections set (_thread_pool.Execute starts a function immediatly, but _client_sockets.insert should be performed
 			LOCK_CONNECTIONS_MUTEX; 
-			if (!_thread_pool.Execute(&ServerImpl::RunConnection, this, client_socket)) {
+			if (!ExecuteConnection(client_socket, client_addr)) {
 				std::string message = "SERVER_ERROR Server is buisy an cannot accept a new client\r\n";
 				if (send(client_socket, message.data(), message.size(), 0) <= 0) {
 					close(client_socket); //Closes only client socket
 				}
-				NETWORK_DEBUG("Connection was rejected due to _thread_pool.Execute = false");
+				NETWORK_DEBUG("Connection was rejected due to ExecuteConnection = false");
 				continue;
 			}
 			_client_sockets.insert(client_socket);
@@ -225,6 +246,25 @@ void ServerImpl::RunAcceptor() {
     close(_server_socket);
 }
 
+bool ServerImpl::ExecuteConnection(int client_socket, const sockaddr_in &client_addr) {
+	if (_work_stealing) {
+		return _stealing_pool.Execute(&ServerImpl::RunConnection, this, client_socket);
+	}
+
+	Core::ThreadPool::Priority priority = Core::ThreadPool::Priority::kNormal;
+	if (_priority_clients.count(client_addr.sin_addr.s_addr) != 0) {
+		priority = Core::ThreadPool::Priority::kHigh;
+	}
+	return _thread_pool.ExecuteWithPriority(priority, &ServerImpl::RunConnection, this, client_socket);
+}
+
+// See Server.h
+void ServerImpl::GetStatistics(std::map<std::string, std::string> &stats) {
+	if (!_work_stealing) {
+		_thread_pool.GetMetrics().Append(stats, "pool_");
+	}
+}
+
 // See Server.h
 void ServerImpl::RunConnection(int client_socket) {
 	NETWORK_DEBUG(__PRETTY_FUNCTION__);
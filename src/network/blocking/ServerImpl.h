@@ -2,13 +2,17 @@
 #define AFINA_NETWORK_BLOCKING_SERVER_H
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <iostream>
 #include <mutex>
+#include <netinet/in.h>
 #include <pthread.h>
 #include <unordered_set>
+#include <vector>
 
 #include "./../../core/multithreading/ThreadPool.h"
+#include "./../../core/multithreading/WorkStealingThreadPool.h"
 #include "./../../protocol/Parser.h"
 #include "./../core/Socket.h"
 #include <afina/core/Debug.h>
@@ -25,7 +29,14 @@ namespace Blocking {
  */
 class ServerImpl : public Server {
 public:
-    ServerImpl(std::shared_ptr<Afina::Storage> ps);
+    // work_stealing - connections are run on the lock-free WorkStealingThreadPool instead of ThreadPool
+    // queue_delay - if not zero, connections are rejected once they wait for a thread longer than that, instead of
+    // a fixed queue length (see ThreadPool::SetAdmissionControl)
+    // priority_clients - IPv4 addresses of administrative clients (monitoring, stats), their connections go to the
+    // high priority lane of the pool. Throws std::invalid_argument for malformed address
+    ServerImpl(std::shared_ptr<Afina::Storage> ps, bool work_stealing = false,
+               std::chrono::milliseconds queue_delay = std::chrono::milliseconds(0),
+               const std::vector<std::string> &priority_clients = std::vector<std::string>());
     ~ServerImpl();
 
     // See Server.h
@@ -37,6 +48,9 @@ public:
     // See Server.h
     void Join() override;
 
+    // See Server.h, work stealing pool has no metrics
+    void GetStatistics(std::map<std::string, std::string> &stats) override;
+
     ServerImpl(const ServerImpl &) = delete;
     ServerImpl &operator=(const ServerImpl &) = delete;
 
@@ -52,6 +66,10 @@ protected:
      */
     void RunConnection(int client_socket = 0);
 
+    // Passes connection to the pool, returns false if pool is busy. Connections of priority clients go before data
+    // traffic. Work stealing pool has no priorities
+    bool ExecuteConnection(int client_socket, const sockaddr_in &client_addr);
+
 private:
     // Function for pthread_create. pthread_create gets this pointer as parameter
     // and then this function calls RunAcceptor()/RunConnectionProxy
@@ -97,6 +115,17 @@ private:
 
     // Treadpool for new threads
     Core::ThreadPool _thread_pool;
+    Core::WorkStealingThreadPool _stealing_pool;
+    bool _work_stealing;
+    std::chrono::milliseconds _queue_delay;
+
+    // Addresses of priority clients, in network byte order
+    std::unordered_set<in_addr_t> _priority_clients;
+
+    // Connections waiting for a free thread, the latter is used when admission control bounds queue delay
+    static const size_t _max_queue_size = 20;
+    static const size_t _max_delayed_queue_size = 1024;
+
     // Client sockets
     std::unordered_set<int> _client_sockets;
 };
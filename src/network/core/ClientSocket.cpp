@@ -24,7 +24,7 @@ ClientSocket::IOInformation ClientSocket::Receive(std::string& out, int count, b
 		info.state = _InterpretateReturnValue(result);
 		if (result > 0)
 		{
-			out.append(new_data);
+			out.append(new_data, result);
 			info.result += result;
 			count -= reading_portion;
 		}
@@ -38,6 +38,16 @@ ClientSocket::IOInformation ClientSocket::Receive(std::string& out, int count, b
 	return info;
 }
 
+ClientSocket::IOInformation ClientSocket::Receive(char* buffer, size_t size)
+{
+	if (!_opened) { throw NetworkException("Cannot use ClientSocket from ServerSocket::AcceptInformation structure with incorrect state!"); }
+
+	int result = recv(_fd_id, buffer, size, 0);
+	IOInformation info = {_InterpretateReturnValue(result), result};
+	if (result == 0) { info.state = IO_OPERATION_STATE::EOF_FLAG; }
+	return info;
+}
+
 ClientSocket::IOInformation ClientSocket::Send(const std::string& data)
 {
 	if (!_opened) { throw NetworkException("Cannot use ClientSocket from ServerSocket::AcceptInformation structure with incorrect state!"); }
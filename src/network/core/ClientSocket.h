@@ -29,6 +29,8 @@ public:
     static const unsigned int reading_portion = 1024;
     // Recieved information will be append to "out" string
     IOInformation Receive(std::string &out, int count = reading_portion, bool wait_all = false);
+    // Single recv() straight into the buffer, such as free space of Protocol::InputBuffer
+    IOInformation Receive(char *buffer, size_t size);
     IOInformation Send(const std::string &data);
     IOInformation Send(const iovec iov[], int count);
 };
@@ -1,7 +1,13 @@
 #include <utility>
 
+#include <linux/filter.h>
+
 #include "ServerSocket.h"
 
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
 namespace Afina {
 namespace Network {
 
@@ -70,7 +76,7 @@ ServerSocket::AcceptInformation ServerSocket::Accept(sockaddr_in* client_addr)
 	}
 
 	socklen_t sinSize = sizeof(sockaddr_in);
-	int result = accept(_fd_id, (sockaddr*) &client_addr, &sinSize);
+	int result = accept(_fd_id, (sockaddr*) client_addr, &sinSize);
 	
 	auto state = _InterpretateReturnValue(result);
 	if (state == IO_OPERATION_STATE::OK)
@@ -86,5 +92,24 @@ ServerSocket::AcceptInformation ServerSocket::Accept(sockaddr_in* client_addr)
 	}
 }
 
+void ServerSocket::SteerByCpu(const std::vector<int>& cpus)
+{
+	// A = CPU id; if (A == cpus[i]) return i; ...; A = A % listeners; return A
+	std::vector<sock_filter> code;
+	code.push_back({BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t) (SKF_AD_OFF + SKF_AD_CPU)});
+	for (size_t i = 0; i < cpus.size(); i++) {
+		code.push_back({BPF_JMP | BPF_JEQ | BPF_K, 0, 1, (uint32_t) cpus[i]}); //Otherwise skip the return
+		code.push_back({BPF_RET | BPF_K, 0, 0, (uint32_t) i});
+	}
+	code.push_back({BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t) cpus.size()});
+	code.push_back({BPF_RET | BPF_A, 0, 0, 0});
+
+	sock_fprog program = {};
+	program.len = code.size();
+	program.filter = code.data();
+	VALIDATE_NETWORK_FUNCTION(setsockopt(_fd_id, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)));
+	NETWORK_DEBUG("Connections of server socket " << _fd_id << " are steered over " << cpus.size() << " listeners by CPU");
+}
+
 } //namespace Network
 } //namespace Afina
@@ -1,6 +1,8 @@
 #ifndef AFINA_NETWORK_SERVER_SOCKET_H
 #define AFINA_NETWORK_SERVER_SOCKET_H
 
+#include <vector>
+
 #include "ClientSocket.h"
 #include "Socket.h"
 
@@ -27,6 +29,13 @@ public:
 
     // If client_addr != nullptr, information about client will be writed to structure
     AcceptInformation Accept(sockaddr_in *client_addr = nullptr);
+
+    /**
+     * Attaches classic BPF program to the SO_REUSEPORT group of this socket: new connection received on cpus[i]
+     * goes to the listener i, one received on any other CPU to the listener (CPU % listeners). Listeners are
+     * numbered in order they were started, so all cpus.size() of them must be started before the call
+     */
+    void SteerByCpu(const std::vector<int> &cpus);
 };
 
 } // namespace Network
@@ -0,0 +1,187 @@
+#include "ServerImpl.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <signal.h>
+#include <sys/epoll.h>
+
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Network {
+namespace Coroutine {
+
+typedef Core::FileDescriptor::IO_OPERATION_STATE IO_STATE;
+
+namespace {
+
+// Pause of the acceptor after accept failure other than EAGAIN, doubled while failures go on
+const std::chrono::milliseconds accept_backoff_min(10);
+const std::chrono::milliseconds accept_backoff_max(1000);
+
+} // namespace
+
+// See Server.h
+ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> ps, std::chrono::milliseconds idle_timeout)
+    : Server(ps), _running(false), _idle_timeout(idle_timeout) {}
+
+// See Server.h
+ServerImpl::~ServerImpl() {
+    Stop();
+    Join();
+}
+
+// See Server.h
+void ServerImpl::Start(uint16_t port, uint16_t n_workers) {
+    NETWORK_DEBUG(__PRETTY_FUNCTION__);
+
+    // If a client closes a connection, this will generally produce a SIGPIPE
+    // signal that will kill the process. We want to ignore this signal, so send()
+    // just returns -1 when this happens.
+    sigset_t sig_mask;
+    sigemptyset(&sig_mask);
+    sigaddset(&sig_mask, SIGPIPE);
+    if (pthread_sigmask(SIG_BLOCK, &sig_mask, NULL) != 0) {
+        throw std::runtime_error("Unable to mask SIGPIPE");
+    }
+
+    // Sockets are created before threads start, so errors such as busy port are reported to the caller
+    for (int i = 0; i < n_workers; i++) {
+        _server_sockets.emplace_back();
+        _server_sockets.back().Start(port, max_listen, true);
+        _server_sockets.back().MakeNonblocking();
+    }
+
+    _scheduler.reset(new Afina::Coroutine::Scheduler(n_workers));
+    _running.store(true);
+    _thread = std::thread(&ServerImpl::_ThreadFunction, this);
+}
+
+// See Server.h
+void ServerImpl::Stop() {
+    NETWORK_DEBUG(__PRETTY_FUNCTION__);
+    if (!_running.exchange(false)) {
+        return;
+    }
+
+    // Coroutines blocked on sockets wake up, see that server is stopping and finish
+    _scheduler->interrupt();
+}
+
+// See Server.h
+void ServerImpl::Join() {
+    NETWORK_DEBUG(__PRETTY_FUNCTION__);
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void ServerImpl::_ThreadFunction() {
+    try {
+        _scheduler->start(&ServerImpl::_Main, *this, _scheduler->engine(0));
+        NETWORK_CURRENT_PROCESS_DEBUG("Coroutine scheduler is stopped");
+    } catch (std::exception &exc) {
+        NETWORK_CURRENT_PROCESS_DEBUG("EXCEPTION in thread: " << exc.what());
+    }
+}
+
+void ServerImpl::_Main(ServerImpl &server, Afina::Coroutine::Engine &engine) {
+    for (auto &server_socket : server._server_sockets) {
+        engine.run(&ServerImpl::_Acceptor, server, engine, server_socket);
+    }
+}
+
+void ServerImpl::_Acceptor(ServerImpl &server, Afina::Coroutine::Engine &engine, ServerSocket &server_socket) {
+    // Exception must not leave coroutine, there is no caller to catch it
+    try {
+        std::chrono::milliseconds backoff = accept_backoff_min;
+        while (server._running.load()) {
+            auto accept_information = server_socket.Accept();
+            if (accept_information.state == IO_STATE::OK) {
+                backoff = accept_backoff_min;
+                accept_information.socket.MakeNonblocking();
+                engine.run(&ServerImpl::_Connection, server, engine, std::move(accept_information.socket));
+                continue;
+            }
+            if (accept_information.state == IO_STATE::ASYNC_ERROR) {
+                engine.wait_fd(server_socket.GetID(), EPOLLIN);
+                continue;
+            }
+
+            // Listening socket stays readable while accept fails (say, with EMFILE), waiting for it would spin
+            int error = errno;
+            NETWORK_CURRENT_PROCESS_DEBUG("Accept failed: " << std::strerror(error));
+            if (error == EBADF || error == EINVAL || error == ENOTSOCK) {
+                return; // listening socket is unusable
+            }
+            engine.sleep_for(backoff);
+            backoff = std::min(backoff * 2, accept_backoff_max);
+        }
+    } catch (std::exception &exc) {
+        NETWORK_CURRENT_PROCESS_DEBUG("Acceptor of " << server_socket.GetID() << " failed: " << exc.what());
+    }
+}
+
+void ServerImpl::_Connection(ServerImpl &server, Afina::Coroutine::Engine &engine, ClientSocket client) {
+    // Exception must not leave coroutine, there is no caller to catch it
+    try {
+        Protocol::Executor executor(server.pStorage);
+        while (server._running.load()) {
+            size_t size = 0;
+            char *space = executor.GetInputSpace(size);
+            auto io_information = client.Receive(space, size);
+            if (io_information.state == IO_STATE::ASYNC_ERROR) {
+                if (!server._Wait(engine, client, EPOLLIN) && server._running.load()) {
+                    NETWORK_CURRENT_PROCESS_DEBUG("Connection " << client.GetID() << " is idle, closing");
+                    return;
+                }
+                continue;
+            }
+            if (io_information.state != IO_STATE::OK || io_information.result == 0) {
+                return; // connection is closed
+            }
+
+            if (executor.CommitAndTryExecute(io_information.result) && !server._Send(engine, client, executor, true)) {
+                return;
+            }
+        }
+
+        // Server is stopping: the last attempt to write results of executed commands
+        server._Send(engine, client, executor, false);
+    } catch (std::exception &exc) {
+        NETWORK_CURRENT_PROCESS_DEBUG("Connection " << client.GetID() << " failed: " << exc.what());
+    }
+}
+
+bool ServerImpl::_Send(Afina::Coroutine::Engine &engine, ClientSocket &client, Protocol::Executor &executor,
+                       bool wait) {
+    while (executor.HasOutputData()) {
+        auto io_information = client.Send(executor.GetOutputAsIovec(), executor.GetQueueSize());
+        if (io_information.state == IO_STATE::ASYNC_ERROR) {
+            if (!wait || !_Wait(engine, client, EPOLLOUT)) {
+                return false;
+            }
+            continue;
+        }
+        if (io_information.state != IO_STATE::OK) {
+            return false;
+        }
+
+        executor.RemoveFromOutput(io_information.result);
+    }
+    return true;
+}
+
+bool ServerImpl::_Wait(Afina::Coroutine::Engine &engine, ClientSocket &client, uint32_t events) {
+    if (_idle_timeout == std::chrono::milliseconds::zero()) {
+        return engine.wait_fd(client.GetID(), events) != 0;
+    }
+    return engine.wait_fd(client.GetID(), events, _idle_timeout) != 0;
+}
+
+} // namespace Coroutine
+} // namespace Network
+} // namespace Afina
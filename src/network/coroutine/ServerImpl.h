@@ -0,0 +1,81 @@
+#ifndef AFINA_NETWORK_COROUTINE_SERVER_H
+#define AFINA_NETWORK_COROUTINE_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <thread>
+
+#include <afina/coroutine/Engine.h>
+#include <afina/coroutine/Scheduler.h>
+#include <afina/network/Server.h>
+
+#include "./../../protocol/Executor.h"
+#include "./../core/ServerSocket.h"
+
+namespace Afina {
+namespace Network {
+namespace Coroutine {
+
+/**
+ * # Network resource manager implementation
+ * Server that is running a coroutine for each connection. Connection code is written in blocking style, but
+ * once socket would block the coroutine is suspended until epoll reports the socket is ready. Coroutines run
+ * on the M:N scheduler, so connections accepted by one thread are spread over all of them. Each worker has own
+ * listening socket on the same port, kernel balances connections between them.
+ *
+ * Connection which gets no data from the client or can't send output to it during idle timeout is closed
+ */
+class ServerImpl : public Server {
+public:
+    // idle_timeout - zero keeps connections open until client closes them
+    ServerImpl(std::shared_ptr<Afina::Storage> ps,
+               std::chrono::milliseconds idle_timeout = std::chrono::milliseconds::zero());
+    ~ServerImpl();
+
+    // See Server.h
+    void Start(uint16_t port, uint16_t workers = 1) override;
+
+    // See Server.h
+    void Stop() override;
+
+    // See Server.h
+    void Join() override;
+
+    ServerImpl(const ServerImpl &) = delete;
+    ServerImpl &operator=(const ServerImpl &) = delete;
+
+private:
+    // Runs scheduler until all coroutines are done
+    void _ThreadFunction();
+
+    // The first coroutine, starts acceptors
+    static void _Main(ServerImpl &server, Afina::Coroutine::Engine &engine);
+
+    // Coroutine accepting connections from one of the listening sockets
+    static void _Acceptor(ServerImpl &server, Afina::Coroutine::Engine &engine, ServerSocket &server_socket);
+
+    // Coroutine serving a single connection
+    static void _Connection(ServerImpl &server, Afina::Coroutine::Engine &engine, ClientSocket client);
+
+    /**
+     * Writes all output of the executor. If wait is set then coroutine is suspended while socket buffer is full,
+     * otherwise single attempt is made. Returns false if connection is broken or output isn't written
+     */
+    bool _Send(Afina::Coroutine::Engine &engine, ClientSocket &client, Protocol::Executor &executor, bool wait);
+
+    // Suspends connection coroutine until socket is ready, returns false if the wait is interrupted or timed out
+    bool _Wait(Afina::Coroutine::Engine &engine, ClientSocket &client, uint32_t events);
+
+    std::atomic<bool> _running;
+    std::chrono::milliseconds _idle_timeout;
+    std::deque<ServerSocket> _server_sockets;
+    std::unique_ptr<Afina::Coroutine::Scheduler> _scheduler;
+    std::thread _thread;
+};
+
+} // namespace Coroutine
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_COROUTINE_SERVER_H
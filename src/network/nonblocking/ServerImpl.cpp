@@ -1,10 +1,12 @@
 #include "ServerImpl.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
+#include <thread>
 
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -16,12 +18,15 @@
 
 #include <afina/Storage.h>
 
+#include "./../../core/NumaTopology.h"
+
 namespace Afina {
 namespace Network {
 namespace NonBlocking {
 
 // See Server.h
-ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> ps) : Server(ps), _server_socket(std::make_shared<ServerSocket>()) {}
+ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> ps, bool numa_aware, bool pin_cores) :
+	Server(ps), _numa_aware(numa_aware), _pin_cores(pin_cores) {}
 
 // See Server.h
 ServerImpl::~ServerImpl() {
@@ -42,15 +47,37 @@ void ServerImpl::Start(uint16_t port, uint16_t n_workers) {
         throw std::runtime_error("Unable to mask SIGPIPE");
     }
 
-    // Create server socket
-    _server_socket->Start(port, max_listen, true);
-    _server_socket->MakeNonblocking();
-    
+    // Worker i is pinned to the i-th CPU process is allowed to run on and gets connections received there. Extra
+    // workers would share CPUs and get no connections, so there are no more workers than CPUs
+    std::vector<int> cpus;
+    if (_pin_cores) {
+	cpus = Core::NumaTopology::AllowedCpus();
+	if (n_workers > cpus.size()) {
+	    NETWORK_DEBUG("Only " << cpus.size() << " workers are started, one per CPU");
+	    n_workers = cpus.size();
+	}
+	cpus.resize(n_workers);
+    }
+
+    // Create listener of every worker
     for (int i = 0; i < n_workers; i++) {
+	_server_sockets.push_back(std::make_shared<ServerSocket>());
+	_server_sockets.back()->Start(port, max_listen, true);
+	_server_sockets.back()->MakeNonblocking();
 	_workers.emplace_back(pStorage);
     }
-    for (auto it = _workers.begin(); it != _workers.end(); it++) {
-    	it->Start(_server_socket, max_listen);
+    // Program is attached once all listeners are in the group, so their numbers are known
+    if (_pin_cores && n_workers > 1) {
+	_server_sockets.front()->SteerByCpu(cpus);
+    }
+
+    // Workers are assigned to nodes round-robin. On a single node machine there is nothing to pin
+    const Core::NumaTopology &topology = Core::NumaTopology::Instance();
+    bool pin_workers = _numa_aware && topology.IsNuma();
+    int worker_index = 0;
+    for (auto it = _workers.begin(); it != _workers.end(); it++, worker_index++) {
+    	it->Start(_server_sockets[worker_index], max_listen, pin_workers ? (worker_index % topology.NodesCount()) : -1,
+    	          _pin_cores ? cpus[worker_index] : -1);
     }
 }
 
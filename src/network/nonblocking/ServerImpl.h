@@ -2,6 +2,8 @@
 #define AFINA_NETWORK_NONBLOCKING_SERVER_H
 
 #include <deque>
+#include <memory>
+#include <vector>
 
 #include <afina/network/Server.h>
 
@@ -14,11 +16,14 @@ namespace NonBlocking {
 
 /**
  * # Network resource manager implementation
- * Epoll based server
+ * Epoll based server. Every worker has its own SO_REUSEPORT listener of the port, kernel spreads connections over
+ * them, so workers don't wake up and contend for the same accept queue
  */
 class ServerImpl : public Server {
 public:
-    ServerImpl(std::shared_ptr<Afina::Storage> ps);
+    // numa_aware: spread workers over NUMA nodes and pin each one to its node
+    // pin_cores: pin worker i to CPU i and give connection to the worker of the CPU which received it
+    ServerImpl(std::shared_ptr<Afina::Storage> ps, bool numa_aware = false, bool pin_cores = false);
     ~ServerImpl();
 
     // See Server.h
@@ -31,7 +36,10 @@ public:
     void Join() override;
 
 private:
-    std::shared_ptr<ServerSocket> _server_socket;
+    // Listener of each worker, in order they joined SO_REUSEPORT group
+    std::vector<std::shared_ptr<ServerSocket>> _server_sockets;
+    bool _numa_aware;
+    bool _pin_cores;
 
     // Thread that is accepting new connections
     std::deque<Worker> _workers;
@@ -1,18 +1,32 @@
 #include "Worker.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
+#include <limits.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <signal.h>
 
+#include "./../../core/NumaTopology.h"
+
 namespace Afina {
 namespace Network {
 namespace NonBlocking {
 
+namespace {
+
+// Pause of accept once process is out of descriptors, doubled while failures go on
+const std::chrono::milliseconds accept_delay_min(10);
+const std::chrono::milliseconds accept_delay_max(1000);
+
+} // namespace
+
 // See Worker.h
-Worker::Worker(std::shared_ptr<Afina::Storage> ps) : _storage(ps), _current_state(STATE::STOPPED), _max_listeners(0)
+Worker::Worker(std::shared_ptr<Afina::Storage> ps) : _storage(ps), _current_state(STATE::STOPPED), _max_listeners(0),
+	_numa_node(-1), _cpu(-1), _accept_delay(0)
 {}
 
 // See Worker.h
@@ -21,7 +35,7 @@ Worker::~Worker() {
 }
 
 // See Worker.h
-void Worker::Start(std::shared_ptr<ServerSocket> server_socket, size_t max_listeners) {
+void Worker::Start(std::shared_ptr<ServerSocket> server_socket, size_t max_listeners, int numa_node, int cpu) {
 	NETWORK_DEBUG(__PRETTY_FUNCTION__);
     
 	if (!server_socket->IsNonblocking()) {
@@ -30,6 +44,8 @@ void Worker::Start(std::shared_ptr<ServerSocket> server_socket, size_t max_liste
 
 	_max_listeners = max_listeners;
 	_server_socket = server_socket;
+	_numa_node = numa_node;
+	_cpu = cpu;
 
 	//Register signal to stop epoll
 	struct sigaction sa = {};
@@ -66,51 +82,81 @@ void Worker::Join() {
 
 void Worker::_ThreadWrapper() {
 	try	{
+		//Pin before any allocation, so all memory of this thread is first-touched on its node
+		if (_cpu >= 0 && Core::NumaTopology::PinCurrentThreadToCpu(_cpu)) {
+			NETWORK_CURRENT_PROCESS_DEBUG("Worker was pinned to CPU " << _cpu);
+		}
+		else if (_numa_node >= 0 && Core::NumaTopology::Instance().PinCurrentThread(_numa_node)) {
+			NETWORK_CURRENT_PROCESS_DEBUG("Worker was pinned to NUMA node " << _numa_node);
+		}
 		_ThreadFunction();
 		NETWORK_CURRENT_PROCESS_DEBUG("Worker thread is going to stop");
 	}
 	catch (std::exception& exc) {
 		NETWORK_CURRENT_PROCESS_DEBUG("EXCEPTION in thread (process will be stopped): " << exc.what());
 		_clients.clear();
+		//Closed listener leaves SO_REUSEPORT group, otherwise kernel keeps sending connections nobody accepts
+		_server_socket->Close();
 	}
 }
 
-bool Worker::_ReadFromSocket(int epoll, ClientAndExecutor& client_executor) {
-	std::string str;
-	auto io_information = client_executor.client.Receive(str);
-	while (io_information.state == Core::FileDescriptor::IO_OPERATION_STATE::OK || 
-	       io_information.state == Core::FileDescriptor::IO_OPERATION_STATE::EOF_FLAG) {
-		if (io_information.result == 0) { return false; } //Socket was closed
-
-		if (client_executor.executor.AppendAndTryExecute(str)) {
-			epoll_event socket_event = {};
-			socket_event.data.fd = client_executor.client.GetID();
-			socket_event.events = EPOLLIN | EPOLLOUT;
-			VALIDATE_NETWORK_FUNCTION(epoll_ctl(epoll, EPOLL_CTL_MOD, client_executor.client.GetID(), &socket_event));
+void Worker::_AcceptClients(int epoll) {
+	// Nobody else accepts from this listener, so it is drained until EAGAIN
+	while (true) {
+		auto accept_information = _server_socket->Accept();
+		if (accept_information.state == Core::FileDescriptor::IO_OPERATION_STATE::ASYNC_ERROR) {
+			_accept_delay = std::chrono::milliseconds::zero();
+			return;
 		}
-		io_information = client_executor.client.Receive(str);
+		if (accept_information.state == Core::FileDescriptor::IO_OPERATION_STATE::ERROR) {
+			int error = errno;
+			if (error == ECONNABORTED || error == EINTR) { continue; } //Only this connection is lost
+			if (error != EMFILE && error != ENFILE) {
+				throw NetworkException("Accept failed!");
+			}
+
+			//Connections stay in the backlog, listener is edge-triggered, so worker retries by itself later
+			_accept_delay = std::min(std::max(_accept_delay * 2, accept_delay_min), accept_delay_max);
+			_accept_retry = std::chrono::steady_clock::now() + _accept_delay;
+			NETWORK_CURRENT_PROCESS_DEBUG("Accept failed, retry in " << _accept_delay.count() << "ms: " << std::strerror(error));
+			return;
+		}
+
+		accept_information.socket.MakeNonblocking();
+		epoll_event socket_event = {};
+		socket_event.data.fd = accept_information.socket.GetID();
+		socket_event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+		VALIDATE_NETWORK_FUNCTION(epoll_ctl(epoll, EPOLL_CTL_ADD, accept_information.socket.GetID(), &socket_event));
+		_clients.emplace(std::make_pair(accept_information.socket.GetID(), ClientAndExecutor(std::move(accept_information.socket), _storage)));
 	}
-	if (io_information.state == Core::FileDescriptor::IO_OPERATION_STATE::ASYNC_ERROR) { return true; }
-	else { return false; }
 }
 
-bool Worker::_WriteToSocket(int epoll, ClientAndExecutor& client_executor) {
+bool Worker::_ReadFromSocket(ClientAndExecutor& client_executor) {
+	//Socket reads straight into the input buffer of the executor, commands are parsed there in place
+	size_t size = 0;
+	char* space = client_executor.executor.GetInputSpace(size);
+	auto io_information = client_executor.client.Receive(space, size);
+	while (io_information.state == Core::FileDescriptor::IO_OPERATION_STATE::OK) {
+		client_executor.executor.CommitAndTryExecute(io_information.result);
+		space = client_executor.executor.GetInputSpace(size);
+		io_information = client_executor.client.Receive(space, size);
+	}
+
+	//Responses of the whole batch go in one writev
+	bool alive = _WriteToSocket(client_executor);
+	if (io_information.state == Core::FileDescriptor::IO_OPERATION_STATE::ASYNC_ERROR) { return alive; }
+	else { return false; } //Socket was closed by client or failed
+}
+
+bool Worker::_WriteToSocket(ClientAndExecutor& client_executor) {
 	while (client_executor.executor.HasOutputData()) {
-		auto io_information = client_executor.client.Send(client_executor.executor.GetOutputAsIovec(), client_executor.executor.GetQueueSize());
-		if (io_information.state == Core::FileDescriptor::IO_OPERATION_STATE::ASYNC_ERROR) { return true; }
+		int count = std::min<size_t>(client_executor.executor.GetQueueSize(), IOV_MAX);
+		auto io_information = client_executor.client.Send(client_executor.executor.GetOutputAsIovec(), count);
+		if (io_information.state == Core::FileDescriptor::IO_OPERATION_STATE::ASYNC_ERROR) { return true; } //Wait for EPOLLOUT
 		if (io_information.state == Core::FileDescriptor::IO_OPERATION_STATE::ERROR) { return false; }
 
 		client_executor.executor.RemoveFromOutput(io_information.result);
 	}
-	
-	//Server is finishing
-	if (epoll != 0) {
-		epoll_event socket_event = {};
-		socket_event.data.fd = client_executor.client.GetID();
-		socket_event.events = EPOLLIN;
-		VALIDATE_NETWORK_FUNCTION(epoll_ctl(epoll, EPOLL_CTL_MOD, client_executor.client.GetID(), &socket_event));
-	}
-
 	return true;
 }
 
@@ -126,15 +172,15 @@ void Worker::_ThreadFunction() {
     // 4. Add connections to the local context
     // 5. Process connection events
     //
-    // Do not forget to use EPOLLEXCLUSIVE flag when register socket
-    // for events to avoid thundering herd type behavior.
+    // Listener isn't shared with other workers, so there is no thundering herd
+    // and EPOLLEXCLUSIVE isn't needed
 
 	int epoll = -1;
 	VALIDATE_NETWORK_FUNCTION(epoll = epoll_create1(0));
 
 	epoll_event socket_event = {};
 	socket_event.data.fd = _server_socket->GetID();
-	socket_event.events = EPOLLIN | EPOLLEXCLUSIVE;
+	socket_event.events = EPOLLIN | EPOLLET;
 	VALIDATE_NETWORK_FUNCTION(epoll_ctl(epoll, EPOLL_CTL_ADD, _server_socket->GetID(), &socket_event));
 
 	epoll_event* events = (epoll_event*) calloc(_max_listeners + 1, sizeof(epoll_event)); //+1 - for server socket
@@ -143,7 +189,12 @@ void Worker::_ThreadFunction() {
 	}
 	
 	while (_current_state.load() == STATE::WORKS) {
-		int n = epoll_wait(epoll, events, _max_listeners + 1, -1);
+		int timeout = -1;
+		if (_accept_delay != std::chrono::milliseconds::zero()) { //Accept is paused, wake up to retry it
+			auto left = std::chrono::duration_cast<std::chrono::milliseconds>(_accept_retry - std::chrono::steady_clock::now());
+			timeout = std::max<int>(0, left.count() + 1);
+		}
+		int n = epoll_wait(epoll, events, _max_listeners + 1, timeout);
 		if (n == -1) {
 			if (errno == EINTR && _current_state.load() != STATE::WORKS) { break; } //Worker is stopping
 			else {
@@ -155,14 +206,7 @@ void Worker::_ThreadFunction() {
 		for (int i = 0; i < n; i++) {
 			if (events[i].data.fd == _server_socket->GetID()) {
 				VALIDATE_NETWORK_CONDITION(events[i].events & EPOLLIN); //Only epollin is a correct event
-				auto accept_information = _server_socket->Accept();
-				VALIDATE_NETWORK_CONDITION(accept_information.state == Core::FileDescriptor::IO_OPERATION_STATE::OK); // No async errors are allowed
-
-				accept_information.socket.MakeNonblocking();
-				socket_event.data.fd = accept_information.socket.GetID();
-				socket_event.events = EPOLLIN;
-				VALIDATE_NETWORK_FUNCTION(epoll_ctl(epoll, EPOLL_CTL_ADD, accept_information.socket.GetID(), &socket_event));
-				_clients.emplace(std::make_pair(accept_information.socket.GetID(), ClientAndExecutor(std::move(accept_information.socket), _storage)));
+				if (_accept_delay == std::chrono::milliseconds::zero()) { _AcceptClients(epoll); }
 			}
 			else {
 				VALIDATE_NETWORK_CONDITION(events[i].events & EPOLLIN || events [i].events & EPOLLOUT || events [i].events & EPOLLHUP || 
@@ -177,24 +221,29 @@ void Worker::_ThreadFunction() {
 
 				auto client_executor = &(_clients.find(events[i].data.fd)->second);
 				if (events[i].events & EPOLLIN) {
-					if (!_ReadFromSocket(epoll, *client_executor)) {
+					if (!_ReadFromSocket(*client_executor)) {
 						_clients.erase(client);
 						continue;
 					}
 				}
 				if (events[i].events & EPOLLOUT) {
-					if (!_WriteToSocket(epoll, *client_executor)) {
+					if (!_WriteToSocket(*client_executor)) {
 						_clients.erase(client);
 						continue;
 					}
 				}
 			}
 		}
+
+		//Closed connections could have freed descriptors, paused accept is retried once delay is over
+		if (_accept_delay != std::chrono::milliseconds::zero() && std::chrono::steady_clock::now() >= _accept_retry) {
+			_AcceptClients(epoll);
+		}
 	}
 
 	// The last attempt write to clients
 	for (auto it = _clients.begin(); it != _clients.end(); it++) {
-		_WriteToSocket(0, it->second);
+		_WriteToSocket(it->second);
 	}
 	
 	_clients.clear();
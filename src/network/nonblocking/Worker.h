@@ -2,6 +2,7 @@
 #define AFINA_NETWORK_NONBLOCKING_WORKER_H
 
 #include <atomic>
+#include <chrono>
 #include <exception>
 #include <functional>
 #include <memory>
@@ -39,9 +40,14 @@ public:
     /**
      * Spaws new background thread that is doing epoll on the given server
      * socket. Once connection accepted it must be registered and being processed
-     * on this thread
+     * on this thread. Server socket is owned by this worker only: it is one of
+     * SO_REUSEPORT listeners of the port
+     *
+     * If numa_node >= 0 the thread is pinned to CPUs of that node, so connection buffers
+     * it allocates are local to the node. If cpu >= 0 the thread is pinned to that CPU,
+     * this takes precedence over the node
      */
-    void Start(std::shared_ptr<ServerSocket> server_socket, size_t max_listeners);
+    void Start(std::shared_ptr<ServerSocket> server_socket, size_t max_listeners, int numa_node = -1, int cpu = -1);
 
     /**
      * Signal background thread to stop. After that signal thread must stop to
@@ -79,8 +85,19 @@ private:
 
     static void _SignalHandler(int signal);
 
-    bool _ReadFromSocket(int epoll, ClientAndExecutor &client_executor);
-    bool _WriteToSocket(int epoll, ClientAndExecutor &client_executor);
+    /**
+     * Accepts all pending connections of the server socket and registers them in epoll. Once process runs out of
+     * descriptors accept is paused for _accept_delay, which grows while failures go on
+     */
+    void _AcceptClients(int epoll);
+
+    /**
+     * Sockets are registered edge-triggered for both directions once, so nothing is changed in epoll later.
+     * Read drains the socket until EAGAIN, executes commands and writes responses right away. What doesn't fit
+     * into the socket buffer is written on the next EPOLLOUT edge. Both return false if connection must be closed
+     */
+    bool _ReadFromSocket(ClientAndExecutor &client_executor);
+    bool _WriteToSocket(ClientAndExecutor &client_executor);
 
 private:
     std::thread _thread;
@@ -90,6 +107,12 @@ private:
     std::shared_ptr<ServerSocket> _server_socket;
     std::unordered_map<int, ClientAndExecutor> _clients;
     size_t _max_listeners;
+    int _numa_node;
+    int _cpu;
+
+    // Non zero while accept is paused, see _AcceptClients()
+    std::chrono::milliseconds _accept_delay;
+    std::chrono::steady_clock::time_point _accept_retry;
 
     std::shared_ptr<Afina::Storage> _storage;
 };
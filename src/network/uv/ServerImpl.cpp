@@ -32,26 +32,39 @@ void ServerImpl::Start(uint16_t port, uint16_t n_workers) {
         throw std::runtime_error("Failed to call uv_ip4_addr");
     }
 
+    // Storage operations are short, a few threads per event loop are enough. Extra threads are started once
+    // commands wait in the queue for too long and go away when threads are mostly idle
+    pool.SetAdaptiveSizing(Afina::Core::ThreadPool::SizingPolicy());
+    pool.Start(n_workers, 4 * n_workers, 1024);
+
     for (auto i = 0; i < n_workers; i++) {
-        workers.push_back(new Worker(pStorage));
+        workers.push_back(new Worker(pStorage, pool, statistics));
         workers[i]->Start(address);
     }
 }
 
 // See Server.h
 void ServerImpl::Stop() {
-    while (!workers.empty()) {
-        auto worker = workers.back();
-	worker->Stop();
-	workers.pop_back();
+    for (auto worker : workers) {
+        worker->Stop();
     }
 }
 
 // See Server.h
 void ServerImpl::Join() {
+    // Workers wait for their running commands, so pool is stopped after them
     for (auto worker : workers) {
         worker->Join();
+        delete worker;
     }
+    workers.clear();
+    pool.Stop(true);
+}
+
+// See Server.h
+void ServerImpl::GetStatistics(std::map<std::string, std::string> &stats) {
+    pool.GetMetrics().Append(stats, "pool_");
+    statistics.Append(stats);
 }
 
 } // namespace UV
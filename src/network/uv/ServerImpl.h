@@ -5,6 +5,8 @@
 #include <vector>
 
 #include <afina/network/Server.h>
+#include <core/multithreading/FlatCombined.h>
+#include <core/multithreading/ThreadPool.h>
 
 #include "Worker.h"
 
@@ -31,11 +33,24 @@ public:
     // See Server.h
     void Join() override;
 
+    // See Server.h
+    void GetStatistics(std::map<std::string, std::string> &stats) override;
+
 protected:
     /**
      * List of all workers created for this instance of server
      */
     std::vector<Worker *> workers;
+
+    /**
+     * Pool executing commands of all workers, event loops only parse input and write output
+     */
+    Afina::Core::ThreadPool pool;
+
+    /**
+     * Counters of commands executed by workers
+     */
+    Afina::Core::FlatCombinedStatistics statistics;
 };
 
 } // namespace UV
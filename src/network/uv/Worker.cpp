@@ -3,6 +3,7 @@
 #include <arpa/inet.h>
 #include <cassert>
 #include <cstring>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
@@ -73,6 +74,15 @@ void Worker::Start(const struct sockaddr_storage &address) {
     }
     uvStopAsync.data = this;
 
+    // Init task completion infrastructure
+    rc = uv_async_init(&uvLoop, &uvTasksDone, delegate<Worker>::callback<&Worker::OnTasksDone>);
+    if (rc != 0) {
+        std::stringstream ss;
+        ss << "Failed to call uv_async_init: [" << uv_err_name(rc) << ", " << rc << "]: " << uv_strerror(rc);
+        throw std::runtime_error(ss.str());
+    }
+    uvTasksDone.data = this;
+
     // Init signals
     rc = uv_signal_init(&uvLoop, &uvSigPipe);
     if (rc != 0) {
@@ -156,6 +166,7 @@ void Worker::Join() {
 void Worker::OnRun() {
     // Run network loop, that call won't return until event loop shuted down by libuv routines
     uv_run(&uvLoop, UV_RUN_DEFAULT);
+    uv_loop_close(&uvLoop);
 }
 
 // Called once signal from outside world received that it is time to stop the network layer.
@@ -164,6 +175,7 @@ void Worker::OnRun() {
 // See Worker.h
 void Worker::OnStop(uv_async_t *async) {
     std::cout << "network debug:" << __PRETTY_FUNCTION__ << std::endl;
+    stopping = true;
 
     // Stop accept new incomming connections
     uv_close((uv_handle_t *)&uvStopAsync, delegate<Worker>::callback<&Worker::OnHandleClosed>);
@@ -177,7 +189,7 @@ void Worker::OnStop(uv_async_t *async) {
         uv_read_stop((uv_stream_t *)conn);
 
         // Try to close connections if possible
-        if (conn->runningTasks == 0) {
+        if (conn->runningTasks == 0 && !uv_is_closing((uv_handle_t *)conn)) {
             uv_close((uv_handle_t *)conn, delegate<Worker>::callback<&Worker::OnConnectionClosed>);
         }
     }
@@ -213,12 +225,10 @@ void Worker::OnConnectionClosed(uv_handle_t *h) {
 // done it is possible to close event loop
 // See Worker.h
 void Worker::CloseEventLoppIfPossible() {
-    if (alive.empty()) {
-        // Loop can't be closed until at least one handler exists, so even code
-        // below executed each time last connection closed it wont leads to
-        // event loop close until there are onStopAsync,SigPipe and uvNetwork
-        // handlers remain active
-        uv_loop_close(&uvLoop);
+    // Tasks are complete once all connections are closed, nothing could signal completion anymore. Once the last
+    // handle is closed uv_run returns and OnRun closes the loop, it can't be done here as uv_run still uses it
+    if (stopping && alive.empty() && !uv_is_closing((uv_handle_t *)&uvTasksDone)) {
+        uv_close((uv_handle_t *)&uvTasksDone, delegate<Worker>::callback<&Worker::OnHandleClosed>);
     }
 }
 
@@ -282,9 +292,14 @@ void Worker::OnRead(uv_stream_t *conn, ssize_t nread, const uv_buf_t *buf) {
     assert(conn != nullptr);
     Connection *pconn = (Connection *)(conn);
 
-    // negative nread indicates that socket has been closed
+    // negative nread indicates that socket has been closed, connection lives until responses of already read commands
+    // are written out
     if (nread < 0) {
-        uv_close((uv_handle_t *)(pconn), delegate<Worker>::callback<&Worker::OnConnectionClosed>);
+        pconn->state = ConnectionState::sClosed;
+        uv_read_stop(conn);
+        if (pconn->runningTasks == 0 && !uv_is_closing((uv_handle_t *)pconn)) {
+            uv_close((uv_handle_t *)(pconn), delegate<Worker>::callback<&Worker::OnConnectionClosed>);
+        }
         return;
     } else if (pconn->state == ConnectionState::sClosed) {
         return;
@@ -297,8 +312,12 @@ void Worker::OnRead(uv_stream_t *conn, ssize_t nread, const uv_buf_t *buf) {
         while (pconn->input_parsed < pconn->input_used) {
             // Read header or body if needs
             if (pconn->state == ConnectionState::sRecvHeader) {
-                // Try to parse command out
-                if (!pconn->parser.Parse(pconn->input, pconn->input_used, pconn->input_parsed)) {
+                // Try to parse command out, parser reports how many bytes it consumed from the given position
+                size_t parsed = 0;
+                bool complete = pconn->parser.Parse(pconn->input + pconn->input_parsed,
+                                                    pconn->input_used - pconn->input_parsed, parsed);
+                pconn->input_parsed += parsed;
+                if (!complete) {
                     continue;
                 }
 
@@ -347,29 +366,22 @@ void Worker::OnRead(uv_stream_t *conn, ssize_t nread, const uv_buf_t *buf) {
             }
         }
     } catch (std::runtime_error &ex) {
-        // Parser throws exception in case if something goes wrong with input data format
-        // TODO: That code duplicates too much of OnExecutionDone - refactor
+        // Parser throws exception in case if something goes wrong with input data format. Error is written out
+        // after responses of the commands read before, connection is closed then
         std::stringstream ss;
-        ss << "CLIENT_ERROR " << ex.what();
-
-        std::string output = ss.str();
+        ss << "CLIENT_ERROR " << ex.what() << "\r\n";
 
         ExecuteTask *ptask = new ExecuteTask();
         ptask->connection = pconn;
-        uv_async_init(&uvLoop, &ptask->done, delegate<Worker>::callback<&Worker::OnExecutionDone>);
-        ptask->done.data = this;
-
-        size_t size = output.size() + 2;
-        ptask->result.base = new char[size];
-        ptask->result.len = size;
-
-        std::memcpy(ptask->result.base, &output[0], size - 2);
-        ptask->result.base[size - 2] = '\r';
-        ptask->result.base[size - 1] = '\n';
+        ptask->output = ss.str();
 
         pconn->runningTasks++;
         pconn->state = ConnectionState::sClosed;
-        OnExecutionDone(&ptask->done);
+        uv_read_stop(conn);
+        pconn->pending.push_back(ptask);
+        if (pconn->pending.size() == 1) {
+            Submit(ptask);
+        }
     }
 }
 
@@ -382,60 +394,97 @@ void Worker::Execute(Connection &pconn) {
     ptask->connection = &pconn;
     ptask->cmd = std::move(pconn.cmd);
     ptask->argument = std::move(pconn.body);
+    ptask->counter = "cmd_" + pconn.parser.Name();
     pconn.runningTasks++;
 
-    // Setup async signal to be called once task execution is complete
-    int rc = uv_async_init(&uvLoop, &ptask->done, delegate<Worker>::callback<&Worker::OnExecutionDone>);
-    if (rc != 0) {
-        throw std::runtime_error("Failed to call uv_async_init for the task");
+    // Command waits until previous ones of the same connection are done
+    pconn.pending.push_back(ptask);
+    if (pconn.pending.size() == 1) {
+        Submit(ptask);
     }
-    ptask->done.data = this;
+}
 
-    // TODO: That should be in another thread
-    {
-        std::string output;
-        try {
-            ptask->cmd->Execute(*pStorage, ptask->argument, output);
-        } catch (std::runtime_error &ex) {
-            std::cerr << "Failed to execute command: " << ex.what() << std::endl;
-
-            std::stringstream ss;
-            ss << "SERVER_ERROR " << ex.what();
-            output = ss.str();
-        }
+// See Worker.h
+void Worker::Submit(ExecuteTask *task) {
+    if (!task->cmd) {
+        Complete(task);
+        return;
+    }
 
-        // Prepare output
-        size_t size = output.size() + 2;
-        ptask->result.base = new char[size];
-        ptask->result.len = size;
+    // Single async handle wakes up the loop for all the tasks, so continuation doesn't need any libuv resources
+    pool.Submit(&Worker::RunCommand, this, task)
+        .Then(std::bind(&Worker::OnCommandDone, this, task, std::placeholders::_1));
+}
 
-        std::memcpy(ptask->result.base, &output[0], size - 2);
-        ptask->result.base[size - 2] = '\r';
-        ptask->result.base[size - 1] = '\n';
+// See Worker.h
+std::string Worker::RunCommand(ExecuteTask *task) {
+    std::string output;
+    task->cmd->Execute(*pStorage, task->argument, output);
+    statistics.Add(task->counter);
+    return output;
+}
+
+// See Worker.h
+void Worker::OnCommandDone(ExecuteTask *task, Afina::Core::Future<std::string> result) {
+    try {
+        task->output = result.Get();
+    } catch (std::future_error &ex) {
+        // Pool didn't accept the task
+        task->output = "SERVER_ERROR Server is busy";
+    } catch (std::exception &ex) {
+        std::cerr << "Failed to execute command: " << ex.what() << std::endl;
 
-        // Notify event loop about task completition
-        uv_async_send(&ptask->done);
+        std::stringstream ss;
+        ss << "SERVER_ERROR " << ex.what();
+        task->output = ss.str();
     }
+    task->output += "\r\n";
+    Complete(task);
 }
 
 // See Worker.h
-void Worker::OnExecutionDone(uv_async_t *handle) {
+void Worker::Complete(ExecuteTask *task) {
+    {
+        std::lock_guard<std::mutex> lock(tasksDoneLock);
+        tasksDone.push_back(task);
+    }
+    uv_async_send(&uvTasksDone);
+}
+
+// See Worker.h
+void Worker::OnTasksDone(uv_async_t *handle) {
     std::cout << "network debug:" << __PRETTY_FUNCTION__ << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(tasksDoneLock);
+        tasksWrite.swap(tasksDone);
+    }
 
-    assert(handle);
-    ExecuteTask *task = (ExecuteTask *)((uint8_t *)handle - offsetof(ExecuteTask, done));
-    assert(&task->done == handle);
+    for (ExecuteTask *task : tasksWrite) {
+        Write(task);
+    }
+    tasksWrite.clear();
+}
 
-    // We don't need async anymore
-    uv_close((uv_handle_t *)&task->done, delegate<Worker>::callback<&Worker::OnHandleClosed>);
+// See Worker.h
+void Worker::Write(ExecuteTask *task) {
+    Connection *pconn = task->connection;
+    assert(pconn->pending.front() == task);
+    pconn->pending.pop_front();
 
     // Send buffer to socket. Even if connection is already closed we are still try to write data out,
     // that would lead to possible write error which is ok and will be handled in the OnWriteDone
-    int rc = uv_write(&task->handler, &task->connection->handler, &task->result, 1,
+    task->result.base = &task->output[0];
+    task->result.len = task->output.size();
+    int rc = uv_write(&task->handler, &pconn->handler, &task->result, 1,
                       delegate<Worker, int>::callback<&Worker::OnWriteDone>);
     if (rc != 0) {
         throw std::runtime_error("Failed to write request");
     }
+
+    // Response is queued, next command of the connection could run
+    if (!pconn->pending.empty()) {
+        Submit(pconn->pending.front());
+    }
 }
 
 // See Worker.h
@@ -446,11 +495,11 @@ void Worker::OnWriteDone(uv_write_t *req, int status) {
     Connection *pconn = task->connection;
 
     task->connection->runningTasks--;
-    if (task->connection->state == ConnectionState::sClosed && task->connection->runningTasks == 0) {
+    if (task->connection->state == ConnectionState::sClosed && task->connection->runningTasks == 0 &&
+        !uv_is_closing((uv_handle_t *)(task->connection))) {
         uv_close((uv_handle_t *)(task->connection), delegate<Worker>::callback<&Worker::OnConnectionClosed>);
     }
 
-    delete[] task->result.base;
     delete task;
 }
 
@@ -1,12 +1,16 @@
 #ifndef AFINA_NETWORK_UV_WORKER_H
 #define AFINA_NETWORK_UV_WORKER_H
 
+#include <deque>
+#include <mutex>
 #include <string>
 #include <unordered_set>
 #include <uv.h>
 #include <vector>
 
 #include <afina/execute/Command.h>
+#include <core/multithreading/FlatCombined.h>
+#include <core/multithreading/ThreadPool.h>
 #include <protocol/Parser.h>
 
 namespace Afina {
@@ -24,7 +28,9 @@ namespace UV {
  */
 class Worker {
 public:
-    Worker(std::shared_ptr<Afina::Storage> pStorage) : pStorage(pStorage) {}
+    Worker(std::shared_ptr<Afina::Storage> pStorage, Afina::Core::ThreadPool &pool,
+           Afina::Core::FlatCombinedStatistics &statistics)
+        : pool(pool), statistics(statistics), stopping(false), pStorage(pStorage) {}
     ~Worker() {}
 
     Worker(const Worker &) = delete;
@@ -75,6 +81,8 @@ protected:
         sClosed
     };
 
+    struct ExecuteTask;
+
     /**
      * Holds information about single connection from the client
      */
@@ -110,6 +118,10 @@ protected:
         // Number of tasks that are running now
         size_t runningTasks;
 
+        // Commands in the order they were read, the first one is executing now. Commands of the same connection are
+        // executed one by one, so responses go out in the order of requests
+        std::deque<ExecuteTask *> pending;
+
         Connection()
             : state(ConnectionState::sRecvHeader), input(nullptr), input_used(0), input_parsed(0), cmd(nullptr),
               body_size(0), body(""), runningTasks(0) {
@@ -128,9 +140,6 @@ protected:
         // Write handler, used to send this task through the libuv write pipeline
         uv_write_t handler;
 
-        // Async signal to be called once task execution is complete
-        uv_async_t done;
-
         // Connection that received command, used to write out response
         Connection *connection;
 
@@ -140,7 +149,13 @@ protected:
         // Argument for the command
         std::string argument;
 
-        // Execution result
+        // Statistics counter of the command
+        std::string counter;
+
+        // Response, including trailing \r\n
+        std::string output;
+
+        // Execution result, points to the output
         uv_buf_t result;
     } ExecuteTask;
 
@@ -194,9 +209,35 @@ protected:
     void Execute(Connection &pconn);
 
     /**
-     * Called once command execution is complete
+     * Sends the first pending command of the connection to the thread pool. Task without command has output already
+     * and completes right away
+     */
+    void Submit(ExecuteTask *task);
+
+    /**
+     * Runs in the thread pool, returns command output
+     */
+    std::string RunCommand(ExecuteTask *task);
+
+    /**
+     * Continuation of the command execution, runs in the thread pool or in the event loop if pool rejected the task
+     */
+    void OnCommandDone(ExecuteTask *task, Afina::Core::Future<std::string> result);
+
+    /**
+     * Passes task with output ready to the event loop
+     */
+    void Complete(ExecuteTask *task);
+
+    /**
+     * Called in the event loop once some tasks are complete, writes their results out
+     */
+    void OnTasksDone(uv_async_t *handle);
+
+    /**
+     * Writes output of the task out to its connection and submits the next pending command of the connection
      */
-    void OnExecutionDone(uv_async_t *handle);
+    void Write(ExecuteTask *task);
 
     /**
      * Called by libuv once ExecuteTask output buffer has been written to the output connection
@@ -234,6 +275,38 @@ private:
      */
     uv_async_t uvStopAsync;
 
+    /**
+     * Async used by the thread pool to wake up event loop once some tasks are complete. Single handle serves all
+     * the tasks, libuv coalesces signals sent before the loop wakes up
+     */
+    uv_async_t uvTasksDone;
+
+    /**
+     * Tasks complete but not written yet, filled by the pool threads, protected by tasksDoneLock
+     */
+    std::mutex tasksDoneLock;
+    std::vector<ExecuteTask *> tasksDone;
+
+    /**
+     * Batch of complete tasks being written out by the event loop, swapped with tasksDone
+     */
+    std::vector<ExecuteTask *> tasksWrite;
+
+    /**
+     * Pool executing commands, shared by all workers of the server
+     */
+    Afina::Core::ThreadPool &pool;
+
+    /**
+     * Commands executed by all workers of the server, updated from the pool threads
+     */
+    Afina::Core::FlatCombinedStatistics &statistics;
+
+    /**
+     * Worker got stop signal, loop ends once all connections are closed
+     */
+    bool stopping;
+
     /**
      * TCP/IP socket used by server to listen for incomming connection
      */
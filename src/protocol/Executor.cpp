@@ -22,7 +22,7 @@ void Executor::_Reset(bool clear_data) {
     _current_command.reset();
 
     if (clear_data) {
-        _current_string = "";
+        _input.Clear();
     }
 }
 
@@ -32,15 +32,19 @@ void Executor::_Execute() {
     size_t data_size = ((_current_command->DataSize() == 0) ? 0 : (_current_command->DataSize() + 2)); // for \r\n
     if (data_size != 0) // Command need argument
     {
-        argument = _current_string.substr(0, data_size);
-        _current_string = _current_string.substr(data_size); // remove argument from received data
+        // The only copy of the value: from the input buffer to the argument, \r\n not needed
+        const char *data = _input.Data();
+        bool terminated = (data[data_size - 2] == '\r' && data[data_size - 1] == '\n');
+        if (terminated) {
+            argument.assign(data, data_size - 2);
+        }
+        _input.Consume(data_size); // remove argument from received data
 
-        if (argument.substr(argument.size() - 2) != "\r\n") {
+        if (!terminated) {
             _AddLineToQueue("CLIENT_ERROR Data should ends with \\r\\n");
             _Reset(false);
             return;
         }
-        argument = argument.substr(0, argument.size() - 2); // \r\n not needed
     }
 
     try {
@@ -55,27 +59,34 @@ void Executor::_Execute() {
 }
 
 bool Executor::_ReadOneCommand() {
+    // Command could be built already and wait for the rest of its argument
+    if (_current_command != nullptr) {
+        return _TryExecute();
+    }
+
     bool was_command = false;
     size_t parsed = 0;
     try {
-        was_command = _parser.Parse(_current_string, parsed);
+        was_command = _parser.Parse(_input.Data(), _input.Size(), parsed);
     } catch (std::exception &) {
         _AddLineToQueue("ERROR"); // Unknown command
         _Reset(true);
         return true;
     }
 
-    _current_string =
-        _current_string.substr(parsed); // remove parsed part of string (was saved in parser) <or> remove command
+    _input.Consume(parsed); // remove parsed part of input (was saved in parser) <or> remove command
     if (!was_command) {
         return false;
     } // need more data
 
     uint32_t arg_size = 0;
     _current_command = _parser.Build(arg_size);
+    return _TryExecute();
+}
 
+bool Executor::_TryExecute() {
     //+2 - for \r\n
-    if (_current_command->DataSize() + 2 > _current_string.size() && _current_command->DataSize() != 0) {
+    if (_current_command->DataSize() + 2 > _input.Size() && _current_command->DataSize() != 0) {
         return false;
     } // need more data
     else {
@@ -85,7 +96,12 @@ bool Executor::_ReadOneCommand() {
 }
 
 bool Executor::AppendAndTryExecute(const std::string &str) {
-    _current_string.append(str);
+    _input.Append(str.data(), str.size());
+    return CommitAndTryExecute(0);
+}
+
+bool Executor::CommitAndTryExecute(size_t received) {
+    _input.Commit(received);
 
     bool was_output = false;
     while (_ReadOneCommand()) {
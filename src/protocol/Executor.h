@@ -13,6 +13,7 @@
 #include <afina/core/Debug.h>
 #include <afina/execute/Command.h>
 
+#include "InputBuffer.h"
 #include "Parser.h"
 
 namespace Afina {
@@ -27,7 +28,7 @@ private:
 
     std::shared_ptr<Afina::Storage> _storage;
 
-    std::string _current_string;
+    InputBuffer _input;
     Parser _parser;
     command_ptr _current_command;
 
@@ -40,7 +41,10 @@ private:
 
     bool _ReadOneCommand();
 
-    // Executes _current_command. Assumes that _current_string is enough for command argument
+    // Executes _current_command if its argument is received already, returns false if more data is needed
+    bool _TryExecute();
+
+    // Executes _current_command. Assumes that _input is enough for command argument
     void _Execute();
 
 public:
@@ -49,6 +53,13 @@ public:
     // Returns true if new data is avaliable
     bool AppendAndTryExecute(const std::string &str);
 
+    /**
+     * Free space of the input buffer to receive into straight from the socket, its size is written to size.
+     * Received bytes are parsed in place by CommitAndTryExecute, which returns true if new data is avaliable
+     */
+    char *GetInputSpace(size_t &size) { return _input.Space(size); }
+    bool CommitAndTryExecute(size_t received);
+
     std::string GetWholeOutputAsString(bool remove = false);
     const iovec *GetOutputAsIovec() const;
     size_t GetQueueSize() const { return _iovec_output.size(); }
@@ -0,0 +1,69 @@
+#include "InputBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Afina {
+namespace Protocol {
+
+InputBuffer::InputBuffer(size_t capacity, size_t idle_capacity)
+    : _read_capacity(std::max<size_t>(capacity, 1)),
+      _idle_capacity(std::min(std::max<size_t>(idle_capacity, 1), _read_capacity)), _capacity(_idle_capacity),
+      _begin(0), _end(0) {}
+
+void InputBuffer::Consume(size_t count) {
+    _begin += std::min(count, Size());
+    if (_begin == _end) {
+        Clear();
+    }
+}
+
+void InputBuffer::Clear() {
+    _begin = _end = 0;
+    if (_capacity > _idle_capacity) {
+        // Grown buffer is allocated again with the idle capacity on the next read
+        _data.reset();
+        _capacity = _idle_capacity;
+    }
+}
+
+char *InputBuffer::Space(size_t &size, size_t min_size) {
+    if (_data == nullptr) {
+        _data.reset(new char[_capacity]);
+    }
+
+    // Last read has filled the buffer and there is more to come, use large reads
+    if (_end == _capacity && _begin != _end && _capacity < _read_capacity) {
+        min_size = std::max(min_size, _read_capacity - Size());
+    }
+
+    min_size = std::max(min_size, _capacity / 4);
+    if (_capacity - _end < min_size) {
+        size_t used = Size();
+        if (_capacity - used < min_size) {
+            // Command is longer than the buffer, keep doubling
+            size_t capacity = std::max(_capacity * 2, used + min_size);
+            std::unique_ptr<char[]> data(new char[capacity]);
+            std::memcpy(data.get(), Data(), used);
+            _data = std::move(data);
+            _capacity = capacity;
+        } else {
+            std::memmove(_data.get(), Data(), used);
+        }
+        _begin = 0;
+        _end = used;
+    }
+
+    size = _capacity - _end;
+    return _data.get() + _end;
+}
+
+void InputBuffer::Append(const char *data, size_t size) {
+    size_t space_size = 0;
+    char *space = Space(space_size, size);
+    std::memcpy(space, data, size);
+    Commit(size);
+}
+
+} // namespace Protocol
+} // namespace Afina
@@ -0,0 +1,62 @@
+#ifndef AFINA_PROTOCOL_INPUT_BUFFER_H
+#define AFINA_PROTOCOL_INPUT_BUFFER_H
+
+#include <cstddef>
+#include <memory>
+
+namespace Afina {
+namespace Protocol {
+
+/**
+ * # Received bytes of a connection
+ * Socket reads straight into the free tail of the buffer, parser consumes bytes from its head in place. Once all
+ * received bytes are consumed both ends return to the beginning, so the unconsumed rest is moved only if a read
+ * leaves a partial command close to the end.
+ *
+ * Memory is allocated on the first read. Buffer starts small and grows up to capacity once a read fills it and leaves
+ * bytes unconsumed, further only if a single command doesn't fit. Drained buffer shrinks back to idle_capacity, so
+ * idle connections hold only a few kilobytes each
+ */
+class InputBuffer {
+public:
+    static const size_t default_capacity = 64 * 1024;
+    static const size_t default_idle_capacity = 4 * 1024;
+
+    // idle_capacity is limited by capacity
+    explicit InputBuffer(size_t capacity = default_capacity, size_t idle_capacity = default_idle_capacity);
+
+    InputBuffer(const InputBuffer &) = delete;
+    InputBuffer &operator=(const InputBuffer &) = delete;
+    InputBuffer(InputBuffer &&) = default;
+    InputBuffer &operator=(InputBuffer &&) = default;
+
+    // Received but not consumed bytes
+    const char *Data() const { return _data.get() + _begin; }
+    size_t Size() const { return _end - _begin; }
+    size_t Capacity() const { return _capacity; }
+
+    void Consume(size_t count);
+    void Clear();
+
+    /**
+     * Returns free space for the next read, at least min_size bytes long (or a quarter of capacity, whichever is
+     * greater, so reads stay large). Size of the space is written to size. Commit() makes received bytes visible
+     */
+    char *Space(size_t &size, size_t min_size = 1);
+    void Commit(size_t count) { _end += count; }
+
+    void Append(const char *data, size_t size);
+
+private:
+    std::unique_ptr<char[]> _data;
+    size_t _read_capacity;
+    size_t _idle_capacity;
+    size_t _capacity;
+    size_t _begin;
+    size_t _end;
+};
+
+} // namespace Protocol
+} // namespace Afina
+
+#endif // AFINA_PROTOCOL_INPUT_BUFFER_H
@@ -30,6 +30,9 @@ Parser::_CommandTypes::_CommandTypes() {
     types.push_back(std::make_pair("delete", []() { return std::unique_ptr<Execute::Command>(new Execute::Delete); }));
 
     types.push_back(std::make_pair("stats", []() { return std::unique_ptr<Execute::Command>(new Execute::Stats); }));
+
+    types.push_back(std::make_pair("cache_memlimit",
+                                   []() { return std::unique_ptr<Execute::Command>(new Execute::CacheMemlimit); }));
 }
 
 Parser::command_ptr Parser::_CommandFactory(const std::string &name) {
@@ -9,6 +9,7 @@
 
 #include <afina/execute/Add.h>
 #include <afina/execute/AppendPrepend.h>
+#include <afina/execute/CacheMemlimit.h>
 #include <afina/execute/Command.h>
 #include <afina/execute/Delete.h>
 #include <afina/execute/Get.h>
@@ -4,42 +4,61 @@ namespace Afina {
 namespace Backend {
 
 MapBasedFCImpl::Operations::Operations() {
-    operations[OperationTypes::PUT] = [](MapBasedFCImpl &container, CombinerType::OperationWrapperPtr wrapper) -> bool {
+    operations[OperationTypes::PUT] = [](MapBasedFCImpl &container, CombinerType::OperationWrapperPtr wrapper) {
         wrapper->GetData().result =
             container.MapBasedImplementation::Put(wrapper->GetData().key, wrapper->GetData().value);
     };
 
     operations[OperationTypes::PUT_IF_ABSENT] = [](MapBasedFCImpl &container,
-                                                   CombinerType::OperationWrapperPtr wrapper) -> bool {
+                                                   CombinerType::OperationWrapperPtr wrapper) {
         wrapper->GetData().result =
             container.MapBasedImplementation::PutIfAbsent(wrapper->GetData().key, wrapper->GetData().value);
     };
 
-    operations[OperationTypes::SET] = [](MapBasedFCImpl &container, CombinerType::OperationWrapperPtr wrapper) -> bool {
+    operations[OperationTypes::SET] = [](MapBasedFCImpl &container, CombinerType::OperationWrapperPtr wrapper) {
         wrapper->GetData().result =
             container.MapBasedImplementation::Set(wrapper->GetData().key, wrapper->GetData().value);
     };
 
     operations[OperationTypes::DELETE] = [](MapBasedFCImpl &container,
-                                            CombinerType::OperationWrapperPtr wrapper) -> bool {
+                                            CombinerType::OperationWrapperPtr wrapper) {
         wrapper->GetData().result = container.MapBasedImplementation::Delete(wrapper->GetData().key);
     };
 
-    operations[OperationTypes::GET] = [](MapBasedFCImpl &container, CombinerType::OperationWrapperPtr wrapper) -> bool {
+    operations[OperationTypes::GET] = [](MapBasedFCImpl &container, CombinerType::OperationWrapperPtr wrapper) {
         wrapper->GetData().result =
             container.MapBasedImplementation::Get(wrapper->GetData().key, wrapper->GetData().value);
     };
 
     operations[OperationTypes::PRINT] = [](MapBasedFCImpl &container,
-                                           CombinerType::OperationWrapperPtr wrapper) -> bool {
+                                           CombinerType::OperationWrapperPtr wrapper) {
         container.MapBasedImplementation::Print();
     };
+
+    operations[OperationTypes::STATISTICS] = [](MapBasedFCImpl &container, CombinerType::OperationWrapperPtr wrapper) {
+        container.MapBasedImplementation::GetStatistics(*wrapper->GetData().stats);
+    };
+
+    operations[OperationTypes::SET_MEMORY_LIMIT] = [](MapBasedFCImpl &container,
+                                                      CombinerType::OperationWrapperPtr wrapper) {
+        wrapper->GetData().result = container.MapBasedImplementation::SetMemoryLimit(wrapper->GetData().size);
+    };
+
+    operations[OperationTypes::EVICT] = [](MapBasedFCImpl &container, CombinerType::OperationWrapperPtr wrapper) {
+        wrapper->GetData().result = container._EvictStep();
+    };
+
+    operations[OperationTypes::MEMORY_USAGE] = [](MapBasedFCImpl &container,
+                                                  CombinerType::OperationWrapperPtr wrapper) {
+        wrapper->GetData().size = container.MapBasedImplementation::GetMemoryUsage();
+    };
 }
 
-MapBasedFCImpl::MapBasedFCImpl(size_t max_size)
-    : MapBasedImplementation(max_size), _flat_combiner(std::bind(&MapBasedFCImpl::_Combiner, this, _1), 0) {}
+MapBasedFCImpl::MapBasedFCImpl(size_t max_size, const Core::MemoryPlacement &placement)
+    : MapBasedImplementation(max_size, placement), _flat_combiner(std::bind(&MapBasedFCImpl::_Combiner, this, _1), 0) {}
 
 MapBasedFCImpl::~MapBasedFCImpl() {
+    _StopEvictor();
     _flat_combiner.DestroyCombiner();
     Clear();
 }
@@ -63,9 +82,10 @@ void MapBasedFCImpl::_Combiner(CombinerType::FlatCombinerShotArrayType &arr) {
 }
 
 bool MapBasedFCImpl::_PrepareAndApplySlot(MapBasedFCImpl::OperationTypes type, const std::string &key,
-                                          const std::string &value) {
+                                          const std::string &value, std::map<std::string, std::string> *stats,
+                                          size_t size) {
     CombinerType::OperationWrapperPtr operation = _flat_combiner.GetThreadSlotOperation();
-    DataForSlot new_data = {type, key, value, false};
+    DataForSlot new_data = {type, key, value, false, stats, size};
     operation->SetOperation(new_data);
 
     _flat_combiner.ApplyThreadSlot(); // sets fence
@@ -110,6 +130,42 @@ bool MapBasedFCImpl::Get(const std::string &key, std::string &value) {
     }
 }
 
+// See MapBasedGlobalLockImpl.h
+void MapBasedFCImpl::GetStatistics(std::map<std::string, std::string> &stats) {
+    GetMapStatistics(stats);
+
+    Core::HugePageUsage usage;
+    GetHugePageUsage(usage);
+    stats["hugepages_bytes"] = std::to_string(usage.Bytes());
+}
+
+// See MapBasedFCImpl.h
+void MapBasedFCImpl::GetMapStatistics(std::map<std::string, std::string> &stats) {
+    _PrepareAndApplySlot(OperationTypes::STATISTICS, "", "", &stats);
+}
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedFCImpl::Start() { _StartEvictor(); }
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedFCImpl::Stop() { _StopEvictor(); }
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedFCImpl::SetMemoryLimit(size_t max_size) {
+    if (_PrepareAndApplySlot(OperationTypes::SET_MEMORY_LIMIT, "", "", nullptr, max_size)) {
+        _WakeEvictor();
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+size_t MapBasedFCImpl::GetMemoryUsage() {
+    _PrepareAndApplySlot(OperationTypes::MEMORY_USAGE, "", "");
+    return _flat_combiner.GetThreadSlotOperation()->GetData().size;
+}
+
+bool MapBasedFCImpl::_BackgroundEvictStep() { return _PrepareAndApplySlot(OperationTypes::EVICT, "", ""); }
+
 void MapBasedFCImpl::Print() { _PrepareAndApplySlot(OperationTypes::PRINT, "", ""); }
 
 } // namespace Backend
@@ -29,8 +29,12 @@ private:
         DELETE = 3,
         GET = 4,
         PRINT = 5,
+        STATISTICS = 6,
+        SET_MEMORY_LIMIT = 7,
+        EVICT = 8,
+        MEMORY_USAGE = 9,
 
-        CountOfTypes = 6
+        CountOfTypes = 10
     };
 
     struct DataForSlot {
@@ -40,6 +44,12 @@ private:
 
         bool result;
 
+        // Output for STATISTICS operation
+        std::map<std::string, std::string> *stats;
+
+        // Input of SET_MEMORY_LIMIT, output of MEMORY_USAGE
+        size_t size;
+
         // is needed from flat combiner
         bool operator<(const DataForSlot &data2) { return key < data2.key; }
     };
@@ -57,9 +67,16 @@ private:
 
 public:
     // max_size - in bytes
-    MapBasedFCImpl(size_t max_size = std::numeric_limits<int>::max());
+    MapBasedFCImpl(size_t max_size = std::numeric_limits<int>::max(),
+                   const Core::MemoryPlacement &placement = Core::MemoryPlacement());
     virtual ~MapBasedFCImpl();
 
+    // Implements Afina::Storage interface, starts background evictor
+    void Start() override;
+
+    // Implements Afina::Storage interface
+    void Stop() override;
+
     // Implements Afina::Storage interface
     bool Put(const std::string &key, const std::string &value) override;
 
@@ -75,14 +92,41 @@ public:
     // Implements Afina::Storage interface
     bool Get(const std::string &key, std::string &value) override;
 
+    // Implements Afina::Storage interface
+    void GetStatistics(std::map<std::string, std::string> &stats) override;
+
+    // Same as GetStatistics but without hugepages_bytes, so sharded storage reads kernel statistics once for all
+    // shards, see GetHugePageUsage
+    void GetMapStatistics(std::map<std::string, std::string> &stats);
+    using MapBasedImplementation::GetHugePageUsage;
+
+    // Implements Afina::Storage interface
+    bool SetMemoryLimit(size_t max_size) override;
+
+    // Implements Afina::Storage interface
+    size_t GetMemoryLimit() override { return MapBasedImplementation::GetMemoryLimit(); }
+
+    // Implements Afina::Storage interface
+    bool SetMaxMemoryLimit(size_t max_size) override { return MapBasedImplementation::SetMaxMemoryLimit(max_size); }
+
+    // Implements Afina::Storage interface
+    size_t GetMaxMemoryLimit() override { return MapBasedImplementation::GetMaxMemoryLimit(); }
+
+    // Implements Afina::Storage interface
+    size_t GetMemoryUsage() override;
+
     void Print();
 
+protected:
+    bool _BackgroundEvictStep() override;
+
 private:
     CombinerType _flat_combiner;
 
 private:
     void _Combiner(CombinerType::FlatCombinerShotArrayType &arr);
-    bool _PrepareAndApplySlot(OperationTypes type, const std::string &key, const std::string &value);
+    bool _PrepareAndApplySlot(OperationTypes type, const std::string &key, const std::string &value,
+                              std::map<std::string, std::string> *stats = nullptr, size_t size = 0);
 };
 
 } // namespace Backend
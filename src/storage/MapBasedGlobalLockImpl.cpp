@@ -6,13 +6,21 @@
 namespace Afina {
 namespace Backend {
 
-MapBasedGlobalLockImpl::MapBasedGlobalLockImpl(size_t max_size) : MapBasedImplementation(max_size) {}
+MapBasedGlobalLockImpl::MapBasedGlobalLockImpl(size_t max_size, const Core::MemoryPlacement &placement)
+    : MapBasedImplementation(max_size, placement) {}
 
 MapBasedGlobalLockImpl::~MapBasedGlobalLockImpl() {
+    _StopEvictor();
     std::lock_guard<std::mutex> __lock(_map_mutex);
     Clear();
 }
 
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Start() { _StartEvictor(); }
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Stop() { _StopEvictor(); }
+
 // See MapBasedGlobalLockImpl.h
 bool MapBasedGlobalLockImpl::Put(const std::string &key, const std::string &value) {
     if (_GetElementSize(key, value) > GetMaxSize()) {
@@ -55,6 +63,43 @@ bool MapBasedGlobalLockImpl::Get(const std::string &key, std::string &value) {
     return MapBasedImplementation::Get(key, value);
 }
 
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::GetStatistics(std::map<std::string, std::string> &stats) {
+    {
+        std::lock_guard<std::mutex> __lock(_map_mutex);
+        MapBasedImplementation::GetStatistics(stats);
+    }
+
+    Core::HugePageUsage usage;
+    GetHugePageUsage(usage);
+    stats["hugepages_bytes"] = std::to_string(usage.Bytes());
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::SetMemoryLimit(size_t max_size) {
+    bool need_eviction = false;
+    {
+        std::lock_guard<std::mutex> __lock(_map_mutex);
+        need_eviction = MapBasedImplementation::SetMemoryLimit(max_size);
+    }
+
+    if (need_eviction) {
+        _WakeEvictor();
+    }
+    return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+size_t MapBasedGlobalLockImpl::GetMemoryUsage() {
+    std::lock_guard<std::mutex> __lock(_map_mutex);
+    return MapBasedImplementation::GetMemoryUsage();
+}
+
+bool MapBasedGlobalLockImpl::_BackgroundEvictStep() {
+    std::lock_guard<std::mutex> __lock(_map_mutex);
+    return _EvictStep();
+}
+
 void MapBasedGlobalLockImpl::Print() {
     std::lock_guard<std::mutex> __lock(_map_mutex);
     MapBasedImplementation::Print();
@@ -18,9 +18,16 @@ namespace Backend {
 class MapBasedGlobalLockImpl : public MapBasedImplementation {
 public:
     // max_size - in bytes
-    MapBasedGlobalLockImpl(size_t max_size = std::numeric_limits<int>::max());
+    MapBasedGlobalLockImpl(size_t max_size = std::numeric_limits<int>::max(),
+                           const Core::MemoryPlacement &placement = Core::MemoryPlacement());
     virtual ~MapBasedGlobalLockImpl();
 
+    // Implements Afina::Storage interface, starts background evictor
+    void Start() override;
+
+    // Implements Afina::Storage interface
+    void Stop() override;
+
     // Implements Afina::Storage interface
     bool Put(const std::string &key, const std::string &value) override;
 
@@ -36,8 +43,29 @@ public:
     // Implements Afina::Storage interface
     bool Get(const std::string &key, std::string &value) override;
 
+    // Implements Afina::Storage interface
+    void GetStatistics(std::map<std::string, std::string> &stats) override;
+
+    // Implements Afina::Storage interface
+    bool SetMemoryLimit(size_t max_size) override;
+
+    // Implements Afina::Storage interface
+    size_t GetMemoryLimit() override { return MapBasedImplementation::GetMemoryLimit(); }
+
+    // Implements Afina::Storage interface
+    bool SetMaxMemoryLimit(size_t max_size) override { return MapBasedImplementation::SetMaxMemoryLimit(max_size); }
+
+    // Implements Afina::Storage interface
+    size_t GetMaxMemoryLimit() override { return MapBasedImplementation::GetMaxMemoryLimit(); }
+
+    // Implements Afina::Storage interface
+    size_t GetMemoryUsage() override;
+
     void Print();
 
+protected:
+    bool _BackgroundEvictStep() override;
+
 private:
     std::mutex _map_mutex;
 };
@@ -1,14 +1,19 @@
 #include "MapBasedImplementation.h"
 
+#include <algorithm>
+#include <set>
 #include <iostream>
 
 namespace Afina {
 namespace Backend {
 
-MapBasedImplementation::MapBasedImplementation(size_t max_size)
-    : _max_size(max_size), _current_size(0), _backend(), _first(nullptr), _last(nullptr) {}
+MapBasedImplementation::MapBasedImplementation(size_t max_size, const Core::MemoryPlacement &placement)
+    : _current_size(0), _max_size(max_size), _target_size(max_size), _limit_size(max_size), _first(nullptr),
+      _last(nullptr), _backend(), _entries_pool(sizeof(Entry), placement), _evictor_running(false),
+      _evict_requested(false) {}
 
 MapBasedImplementation::~MapBasedImplementation() {
+    _StopEvictor();
     Clear();
     if (!_backend.empty()) {
         CURRENT_PROCESS_DEBUG("EXCEPTION: Storage map is not empty!");
@@ -24,9 +29,88 @@ void MapBasedImplementation::_ShrinkToSize(size_t size) {
     }
 }
 
+bool MapBasedImplementation::SetMemoryLimit(size_t max_size) {
+    _target_size = max_size;
+    if (max_size >= _max_size) {
+        _max_size = max_size;
+        return false;
+    }
+
+    // Don't evict here: inserts keep respecting the current budget until evictor lowers it
+    _max_size = std::max(max_size, _current_size);
+    return _current_size > max_size;
+}
+
+bool MapBasedImplementation::SetMaxMemoryLimit(size_t max_size) {
+    _limit_size = max_size;
+    return SetMemoryLimit(max_size);
+}
+
+bool MapBasedImplementation::_EvictStep() {
+    size_t target = _target_size;
+    for (size_t i = 0; i < _evict_batch && _current_size > target && _last != nullptr; i++) {
+        _RemoveFromList(_last);
+    }
+
+    _max_size = std::max(target, _current_size);
+    return _current_size > target;
+}
+
+void MapBasedImplementation::_StartEvictor() {
+    std::lock_guard<std::mutex> lock(_evictor_mutex);
+    if (_evictor_running) {
+        return;
+    }
+    _evictor_running = true;
+    _evictor = std::thread(&MapBasedImplementation::_EvictorThread, this);
+}
+
+void MapBasedImplementation::_StopEvictor() {
+    {
+        std::lock_guard<std::mutex> lock(_evictor_mutex);
+        _evictor_running = false;
+    }
+    _evictor_cv.notify_all();
+    if (_evictor.joinable()) {
+        _evictor.join();
+    }
+}
+
+void MapBasedImplementation::_WakeEvictor() {
+    {
+        std::lock_guard<std::mutex> lock(_evictor_mutex);
+        if (_evictor_running) {
+            _evict_requested = true;
+            _evictor_cv.notify_one();
+            return;
+        }
+    }
+
+    while (_BackgroundEvictStep()) {
+    }
+}
+
+void MapBasedImplementation::_EvictorThread() {
+    std::unique_lock<std::mutex> lock(_evictor_mutex);
+    while (_evictor_running) {
+        if (!_evict_requested) {
+            _evictor_cv.wait(lock);
+            continue;
+        }
+        _evict_requested = false;
+
+        // Storage lock is taken for a single portion only, so clients interleave with eviction
+        lock.unlock();
+        while (_BackgroundEvictStep()) {
+            std::this_thread::yield();
+        }
+        lock.lock();
+    }
+}
+
 bool MapBasedImplementation::_Insert(const std::string &key, const std::string &value, bool need_replace) {
     int size_new = _GetElementSize(key, value);
-    if (size_new > _max_size) {
+    if (static_cast<size_t>(size_new) > _max_size) {
         return false;
     }
     // std::lock_guard<std::recursive_mutex> __lock(_map_mutex);
@@ -36,7 +120,7 @@ bool MapBasedImplementation::_Insert(const std::string &key, const std::string &
         if (size_new + _current_size > _max_size) {
             _ShrinkToSize(_max_size - size_new);
         }
-        Entry *new_element = new Entry(key, value, nullptr, _first);
+        Entry *new_element = new (_entries_pool.Allocate()) Entry(key, value, nullptr, _first);
         if (_first != nullptr) {
             _first->previous = new_element;
         }
@@ -68,7 +152,7 @@ bool MapBasedImplementation::PutIfAbsent(const std::string &key, const std::stri
 // See MapBasedGlobalLockImpl.h
 bool MapBasedImplementation::Set(const std::string &key, const std::string &value) {
     int size_new = _GetElementSize(key, value);
-    if (size_new > _max_size) {
+    if (static_cast<size_t>(size_new) > _max_size) {
         return false;
     }
     // std::lock_guard<std::recursive_mutex> __lock(_map_mutex);
@@ -124,6 +208,17 @@ bool MapBasedImplementation::Get(const std::string &key, std::string &value) {
     return true;
 }
 
+// See MapBasedGlobalLockImpl.h
+void MapBasedImplementation::GetStatistics(std::map<std::string, std::string> &stats) {
+    stats["bytes"] = std::to_string(_current_size);
+    stats["curr_items"] = std::to_string(_backend.size());
+    stats["limit_maxbytes"] = std::to_string(_limit_size);
+
+    stats["hugepages_mode"] = Core::HugePageRegion::ModeName(_entries_pool.GetMode());
+    stats["slab_mapped_bytes"] = std::to_string(_entries_pool.MappedBytes());
+    stats["numa_interleave"] = _entries_pool.IsNumaInterleaved() ? "1" : "0";
+}
+
 void MapBasedImplementation::Print() {
     std::cout << "List printing: " << std::endl;
     Entry *element = _first;
@@ -186,7 +281,27 @@ void MapBasedImplementation::_RemoveFromList(const Entry *entry) {
     element->next = nullptr;
 
     _current_size -= entry->GetSize();
-    delete element;
+    element->~Entry();
+    _entries_pool.Free(element);
+}
+
+size_t ShardMemoryLimit(size_t max_size, size_t shards, size_t shard) {
+    return max_size / shards + (shard < max_size % shards ? 1 : 0);
+}
+
+void MergeShardStatistics(std::map<std::string, std::string> &stats,
+                          const std::map<std::string, std::string> &shard_stats) {
+    // Counters of items and bytes, other numbers (such as numa_interleave flag) are not summed
+    static const std::set<std::string> summed = {"bytes", "curr_items", "limit_maxbytes", "hugepages_bytes",
+                                                 "slab_mapped_bytes"};
+    for (auto &stat : shard_stats) {
+        auto it = stats.find(stat.first);
+        if (it == stats.end() || summed.count(stat.first) == 0) {
+            stats[stat.first] = stat.second;
+        } else {
+            it->second = std::to_string(std::stoull(it->second) + std::stoull(stat.second));
+        }
+    }
 }
 
 } // namespace Backend
@@ -1,13 +1,19 @@
 #ifndef AFINA_STORAGE_MAP_IMPLEMENTATION_H
 #define AFINA_STORAGE_MAP_IMPLEMENTATION_H
 
+#include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <iostream>
 #include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
+#include "./../core/memory/SlabPool.h"
 #include <afina/Storage.h>
 #include <afina/core/Debug.h>
 
@@ -50,7 +56,9 @@ private:
     };
 
 protected:
-    MapBasedImplementation(size_t max_size = std::numeric_limits<int>::max());
+    // Entries of the storage are allocated from the slab pool placed according to placement
+    MapBasedImplementation(size_t max_size = std::numeric_limits<int>::max(),
+                           const Core::MemoryPlacement &placement = Core::MemoryPlacement());
     virtual ~MapBasedImplementation();
 
     // Implements Afina::Storage interface
@@ -68,6 +76,29 @@ protected:
     // Implements Afina::Storage interface
     virtual bool Get(const std::string &key, std::string &value) override;
 
+    // Implements Afina::Storage interface. hugepages_bytes isn't reported, as reading it takes long, implementations
+    // add it outside of their synchronization using GetHugePageUsage
+    virtual void GetStatistics(std::map<std::string, std::string> &stats) override;
+
+    // Adds slabs of the storage to usage, could be called without synchronization with other methods
+    void GetHugePageUsage(Core::HugePageUsage &usage) const { _entries_pool.GetHugePageUsage(usage); }
+
+    // Implements Afina::Storage interface. Returns true if background eviction is needed
+    virtual bool SetMemoryLimit(size_t max_size) override;
+
+    // Implements Afina::Storage interface
+    virtual size_t GetMemoryLimit() override { return _target_size; }
+
+    // Implements Afina::Storage interface. Budget is changed by SetMemoryLimit of the implementation, so it is done
+    // under the same synchronization
+    virtual bool SetMaxMemoryLimit(size_t max_size) override;
+
+    // Implements Afina::Storage interface
+    virtual size_t GetMaxMemoryLimit() override { return _limit_size; }
+
+    // Implements Afina::Storage interface
+    virtual size_t GetMemoryUsage() override { return _current_size; }
+
     void Print();
 
     size_t GetMaxSize() const { return _max_size; }
@@ -75,15 +106,59 @@ protected:
 
     void Clear();
 
+    /**
+     * Evicts up to _evict_batch least recently used elements above the memory limit and lowers the effective
+     * budget accordingly. Returns true if there is more to evict
+     */
+    bool _EvictStep();
+
+    /**
+     * Same as _EvictStep, but called from the evictor thread, so implementations must add own synchronization
+     */
+    virtual bool _BackgroundEvictStep() = 0;
+
+    // Starts/stops thread calling _BackgroundEvictStep after the memory limit has been lowered
+    void _StartEvictor();
+    void _StopEvictor();
+
+    /**
+     * Asks evictor thread to bring storage down to the memory limit. If evictor isn't running, then elements are
+     * evicted by the calling thread
+     */
+    void _WakeEvictor();
+
+    // Elements evicted at once by the background evictor, bounds time of the single lock acquisition
+    static const size_t _evict_batch = 64;
+
 private:
     size_t _current_size;
-    size_t _max_size;
+
+    // Budget respected by inserts. While background eviction is in progress it is greater then _target_size,
+    // otherwise they are equal. Written under storage lock only, but read without it for early size checks
+    std::atomic<size_t> _max_size;
+
+    // Budget requested by SetMemoryLimit
+    std::atomic<size_t> _target_size;
+
+    // Limit requested by SetMaxMemoryLimit, budget never grows above it
+    std::atomic<size_t> _limit_size;
 
     Entry *_first;
     Entry *_last;
 
     std::unordered_map<StrCRef, const Entry *, StringReferenceHash, StringReferenceEqual> _backend;
 
+    // Memory for Entry objects, so list traversal on LRU updates touches only a few (huge) pages
+    Core::SlabPool _entries_pool;
+
+    std::thread _evictor;
+    std::mutex _evictor_mutex;
+    std::condition_variable _evictor_cv;
+    bool _evictor_running;
+    bool _evict_requested;
+
+    void _EvictorThread();
+
 private:
     bool _Insert(const std::string &key, const std::string &value, bool need_replace);
 
@@ -96,6 +171,14 @@ private:
     void _RemoveFromList(const Entry *entry);
 };
 
+// Part of max_size given to the shard of a storage split by keys, remainder goes to the first shards
+size_t ShardMemoryLimit(size_t max_size, size_t shards, size_t shard);
+
+// Adds statistics of a shard: item and byte counters are summed, the rest (such as hugepages mode or numa
+// interleave flag) is the same for all shards
+void MergeShardStatistics(std::map<std::string, std::string> &stats,
+                          const std::map<std::string, std::string> &shard_stats);
+
 } // namespace Backend
 } // namespace Afina
 
@@ -0,0 +1,94 @@
+#include "MapBasedShardedFCImpl.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace Afina {
+namespace Backend {
+
+MapBasedShardedFCImpl::MapBasedShardedFCImpl(size_t max_size, const Core::MemoryPlacement &placement, size_t shards) {
+    if (shards == 0) {
+        shards = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    _shards.resize(shards);
+    for (size_t i = 0; i < shards; i++) {
+        _shards[i].reset(new MapBasedFCImpl(ShardMemoryLimit(max_size, shards, i), placement));
+    }
+}
+
+// See MapBasedShardedFCImpl.h
+void MapBasedShardedFCImpl::Start() {
+    for (auto &shard : _shards) {
+        shard->Start();
+    }
+}
+
+// See MapBasedShardedFCImpl.h
+void MapBasedShardedFCImpl::Stop() {
+    for (auto &shard : _shards) {
+        shard->Stop();
+    }
+}
+
+// See MapBasedShardedFCImpl.h
+void MapBasedShardedFCImpl::GetStatistics(std::map<std::string, std::string> &stats) {
+    for (auto &shard : _shards) {
+        std::map<std::string, std::string> shard_stats;
+        shard->GetMapStatistics(shard_stats);
+        MergeShardStatistics(stats, shard_stats);
+    }
+    stats["storage_shards"] = std::to_string(_shards.size());
+
+    Core::HugePageUsage usage;
+    for (auto &shard : _shards) {
+        shard->GetHugePageUsage(usage);
+    }
+    stats["hugepages_bytes"] = std::to_string(usage.Bytes());
+}
+
+// See MapBasedShardedFCImpl.h
+bool MapBasedShardedFCImpl::SetMemoryLimit(size_t max_size) {
+    for (size_t i = 0; i < _shards.size(); i++) {
+        _shards[i]->SetMemoryLimit(ShardMemoryLimit(max_size, _shards.size(), i));
+    }
+    return true;
+}
+
+// See MapBasedShardedFCImpl.h
+size_t MapBasedShardedFCImpl::GetMemoryLimit() {
+    size_t limit = 0;
+    for (auto &shard : _shards) {
+        limit += shard->GetMemoryLimit();
+    }
+    return limit;
+}
+
+// See MapBasedShardedFCImpl.h
+bool MapBasedShardedFCImpl::SetMaxMemoryLimit(size_t max_size) {
+    for (size_t i = 0; i < _shards.size(); i++) {
+        _shards[i]->SetMaxMemoryLimit(ShardMemoryLimit(max_size, _shards.size(), i));
+    }
+    return true;
+}
+
+// See MapBasedShardedFCImpl.h
+size_t MapBasedShardedFCImpl::GetMaxMemoryLimit() {
+    size_t limit = 0;
+    for (auto &shard : _shards) {
+        limit += shard->GetMaxMemoryLimit();
+    }
+    return limit;
+}
+
+// See MapBasedShardedFCImpl.h
+size_t MapBasedShardedFCImpl::GetMemoryUsage() {
+    size_t usage = 0;
+    for (auto &shard : _shards) {
+        usage += shard->GetMemoryUsage();
+    }
+    return usage;
+}
+
+} // namespace Backend
+} // namespace Afina
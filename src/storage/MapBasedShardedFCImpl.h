@@ -0,0 +1,84 @@
+#ifndef AFINA_STORAGE_MAP_BASED_SHARDED_FC_IMPL_H
+#define AFINA_STORAGE_MAP_BASED_SHARDED_FC_IMPL_H
+
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MapBasedFCImpl.h"
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Map based implementation sharded over flat combiners
+ * Keys are hashed to independent MapBasedFCImpl shards, each one with its own combiner, map and LRU list, so
+ * batches of different shards are combined in parallel. Memory limit is split between shards evenly: LRU order
+ * is kept within a shard only and an element must fit into the budget of its shard
+ */
+class MapBasedShardedFCImpl : public Afina::Storage {
+public:
+    // max_size - in bytes, shards - number of combiners, 0 means one per hardware thread
+    MapBasedShardedFCImpl(size_t max_size = std::numeric_limits<int>::max(),
+                          const Core::MemoryPlacement &placement = Core::MemoryPlacement(), size_t shards = 0);
+    ~MapBasedShardedFCImpl() {}
+
+    // Implements Afina::Storage interface, starts background evictors of shards
+    void Start() override;
+
+    // Implements Afina::Storage interface
+    void Stop() override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value) override { return _Shard(key).Put(key, value); }
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value) override {
+        return _Shard(key).PutIfAbsent(key, value);
+    }
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value) override { return _Shard(key).Set(key, value); }
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override { return _Shard(key).Delete(key); }
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) override { return _Shard(key).Get(key, value); }
+
+    // Implements Afina::Storage interface, sizes are summed over shards
+    void GetStatistics(std::map<std::string, std::string> &stats) override;
+
+    // Implements Afina::Storage interface, limit is split between shards
+    bool SetMemoryLimit(size_t max_size) override;
+
+    // Implements Afina::Storage interface
+    size_t GetMemoryLimit() override;
+
+    // Implements Afina::Storage interface, limit is split between shards
+    bool SetMaxMemoryLimit(size_t max_size) override;
+
+    // Implements Afina::Storage interface
+    size_t GetMaxMemoryLimit() override;
+
+    // Implements Afina::Storage interface
+    size_t GetMemoryUsage() override;
+
+    size_t GetShardsCount() const { return _shards.size(); }
+
+private:
+    MapBasedFCImpl &_Shard(const std::string &key) {
+        return *_shards[std::hash<std::string>()(key) % _shards.size()];
+    }
+
+    std::vector<std::unique_ptr<MapBasedFCImpl>> _shards;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_MAP_BASED_SHARDED_FC_IMPL_H
@@ -0,0 +1,291 @@
+#include "MapBasedSharedNothingImpl.h"
+
+#include <algorithm>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <afina/core/SpinLock.h>
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+// States of a request, futex word caller sleeps on
+const uint32_t kPending = 0;
+const uint32_t kParked = 1;
+const uint32_t kDone = 2;
+
+} // namespace
+
+MapBasedSharedNothingImpl::MapBasedSharedNothingImpl(size_t max_size, const Core::MemoryPlacement &placement,
+                                                     size_t shards)
+    : _stopping(false), _spin_count(std::thread::hardware_concurrency() > 1 ? 256 : 0) {
+    if (shards == 0) {
+        shards = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    _owners.resize(shards);
+    for (size_t i = 0; i < shards; i++) {
+        _owners[i].reset(new _Owner(1024));
+        _owners[i]->shard.reset(new _Shard(ShardMemoryLimit(max_size, shards, i), placement));
+    }
+
+    for (auto &owner : _owners) {
+        owner->thread = std::thread(&MapBasedSharedNothingImpl::_OwnerThread, this, std::ref(*owner));
+    }
+}
+
+MapBasedSharedNothingImpl::~MapBasedSharedNothingImpl() {
+    _stopping.store(true);
+    for (auto &owner : _owners) {
+        owner->event.NotifyAll();
+        owner->thread.join();
+    }
+}
+
+// See MapBasedSharedNothingImpl.h
+bool MapBasedSharedNothingImpl::Put(const std::string &key, const std::string &value) {
+    _Request request;
+    _Init(request, _OperationType::kPut, &key, &value);
+    return _Execute(_OwnerOf(key), request);
+}
+
+// See MapBasedSharedNothingImpl.h
+bool MapBasedSharedNothingImpl::PutIfAbsent(const std::string &key, const std::string &value) {
+    _Request request;
+    _Init(request, _OperationType::kPutIfAbsent, &key, &value);
+    return _Execute(_OwnerOf(key), request);
+}
+
+// See MapBasedSharedNothingImpl.h
+bool MapBasedSharedNothingImpl::Set(const std::string &key, const std::string &value) {
+    _Request request;
+    _Init(request, _OperationType::kSet, &key, &value);
+    return _Execute(_OwnerOf(key), request);
+}
+
+// See MapBasedSharedNothingImpl.h
+bool MapBasedSharedNothingImpl::Delete(const std::string &key) {
+    _Request request;
+    _Init(request, _OperationType::kDelete, &key);
+    return _Execute(_OwnerOf(key), request);
+}
+
+// See MapBasedSharedNothingImpl.h
+bool MapBasedSharedNothingImpl::Get(const std::string &key, std::string &value) {
+    _Request request;
+    _Init(request, _OperationType::kGet, &key);
+    request.output = &value;
+    return _Execute(_OwnerOf(key), request);
+}
+
+// See MapBasedSharedNothingImpl.h
+void MapBasedSharedNothingImpl::GetStatistics(std::map<std::string, std::string> &stats) {
+    for (auto &owner : _owners) {
+        std::map<std::string, std::string> shard_stats;
+        _Request request;
+        _Init(request, _OperationType::kStatistics);
+        request.stats = &shard_stats;
+        _Execute(*owner, request);
+        MergeShardStatistics(stats, shard_stats);
+    }
+    stats["storage_shards"] = std::to_string(_owners.size());
+
+    // Slabs are read without bothering owners
+    Core::HugePageUsage usage;
+    for (auto &owner : _owners) {
+        owner->shard->GetHugePageUsage(usage);
+    }
+    stats["hugepages_bytes"] = std::to_string(usage.Bytes());
+}
+
+// See MapBasedSharedNothingImpl.h
+bool MapBasedSharedNothingImpl::SetMemoryLimit(size_t max_size) {
+    for (size_t i = 0; i < _owners.size(); i++) {
+        _Request request;
+        _Init(request, _OperationType::kSetMemoryLimit);
+        request.size = ShardMemoryLimit(max_size, _owners.size(), i);
+        _Execute(*_owners[i], request);
+    }
+    return true;
+}
+
+// See MapBasedSharedNothingImpl.h
+size_t MapBasedSharedNothingImpl::GetMemoryLimit() {
+    // Limit of a shard is atomic, it is read without bothering the owner
+    size_t limit = 0;
+    for (auto &owner : _owners) {
+        limit += owner->shard->GetMemoryLimit();
+    }
+    return limit;
+}
+
+// See MapBasedSharedNothingImpl.h
+bool MapBasedSharedNothingImpl::SetMaxMemoryLimit(size_t max_size) {
+    for (size_t i = 0; i < _owners.size(); i++) {
+        _Request request;
+        _Init(request, _OperationType::kSetMaxMemoryLimit);
+        request.size = ShardMemoryLimit(max_size, _owners.size(), i);
+        _Execute(*_owners[i], request);
+    }
+    return true;
+}
+
+// See MapBasedSharedNothingImpl.h
+size_t MapBasedSharedNothingImpl::GetMaxMemoryLimit() {
+    size_t limit = 0;
+    for (auto &owner : _owners) {
+        limit += owner->shard->GetMaxMemoryLimit();
+    }
+    return limit;
+}
+
+// See MapBasedSharedNothingImpl.h
+size_t MapBasedSharedNothingImpl::GetMemoryUsage() {
+    size_t usage = 0;
+    for (auto &owner : _owners) {
+        _Request request;
+        _Init(request, _OperationType::kMemoryUsage);
+        _Execute(*owner, request);
+        usage += request.size;
+    }
+    return usage;
+}
+
+void MapBasedSharedNothingImpl::_Init(_Request &request, _OperationType type, const std::string *key,
+                                      const std::string *value) {
+    request.type = type;
+    request.key = key;
+    request.value = value;
+    request.output = nullptr;
+    request.stats = nullptr;
+    request.size = 0;
+    request.result = false;
+    request.error = nullptr;
+    request.state.store(kPending, std::memory_order_relaxed);
+}
+
+bool MapBasedSharedNothingImpl::_Execute(_Owner &owner, _Request &request) {
+    _Request *pointer = &request;
+    while (!owner.ring.TryPush(pointer)) {
+        // Owner is behind, ring is full
+        std::this_thread::yield();
+    }
+    owner.event.NotifyOne();
+
+    _Wait(request);
+    if (request.error != nullptr) {
+        std::rethrow_exception(request.error);
+    }
+    return request.result;
+}
+
+void MapBasedSharedNothingImpl::_Wait(_Request &request) {
+    for (size_t i = 0; i < _spin_count; i++) {
+        if (request.state.load(std::memory_order_acquire) == kDone) {
+            return;
+        }
+        Core::CpuRelax();
+    }
+
+    uint32_t expected = kPending;
+    if (!request.state.compare_exchange_strong(expected, kParked, std::memory_order_acq_rel)) {
+        return; // done already
+    }
+    while (request.state.load(std::memory_order_acquire) != kDone) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&request.state), FUTEX_WAIT_PRIVATE, kParked, nullptr,
+                nullptr, 0);
+    }
+}
+
+void MapBasedSharedNothingImpl::_OwnerThread(_Owner &owner) {
+    _Request *request;
+    while (true) {
+        size_t executed = 0;
+        while (executed < _batch_size && owner.ring.TryPop(request)) {
+            _Apply(owner, *request);
+            executed++;
+        }
+
+        if (owner.evicting) {
+            owner.evicting = owner.shard->_EvictStep();
+        }
+        if (executed > 0 || owner.evicting) {
+            continue;
+        }
+
+        // Size counts requests being pushed, so owner checks the ring again rather than sleeps on them
+        Core::EventCount::Key key = owner.event.PrepareWait();
+        if (owner.ring.Size() > 0) {
+            owner.event.CancelWait();
+            continue;
+        }
+        if (_stopping.load()) {
+            owner.event.CancelWait();
+            return;
+        }
+        owner.event.Wait(key);
+    }
+}
+
+void MapBasedSharedNothingImpl::_Apply(_Owner &owner, _Request &request) {
+    _Shard &shard = *owner.shard;
+    try {
+        switch (request.type) {
+        case _OperationType::kPut:
+            request.result = (_Shard::_GetElementSize(*request.key, *request.value) <= shard.GetMaxSize()) &&
+                             shard.Put(*request.key, *request.value);
+            break;
+
+        case _OperationType::kPutIfAbsent:
+            request.result = (_Shard::_GetElementSize(*request.key, *request.value) <= shard.GetMaxSize()) &&
+                             shard.PutIfAbsent(*request.key, *request.value);
+            break;
+
+        case _OperationType::kSet:
+            request.result = (_Shard::_GetElementSize(*request.key, *request.value) <= shard.GetMaxSize()) &&
+                             shard.Set(*request.key, *request.value);
+            break;
+
+        case _OperationType::kDelete:
+            request.result = shard.Delete(*request.key);
+            break;
+
+        case _OperationType::kGet:
+            request.result = shard.Get(*request.key, *request.output);
+            break;
+
+        case _OperationType::kStatistics:
+            shard.GetStatistics(*request.stats);
+            break;
+
+        case _OperationType::kSetMemoryLimit:
+            owner.evicting = shard.SetMemoryLimit(request.size) || owner.evicting;
+            request.result = true;
+            break;
+
+        case _OperationType::kSetMaxMemoryLimit:
+            owner.evicting = shard.SetMaxMemoryLimit(request.size) || owner.evicting;
+            request.result = true;
+            break;
+
+        case _OperationType::kMemoryUsage:
+            request.size = shard.GetMemoryUsage();
+            break;
+        }
+    } catch (...) {
+        request.error = std::current_exception();
+    }
+
+    // Caller could return as soon as it sees the state, wake up touches only the futex address then
+    if (request.state.exchange(kDone, std::memory_order_release) == kParked) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&request.state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr,
+                0);
+    }
+}
+
+} // namespace Backend
+} // namespace Afina
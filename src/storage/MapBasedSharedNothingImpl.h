@@ -0,0 +1,175 @@
+#ifndef AFINA_STORAGE_MAP_BASED_SHARED_NOTHING_IMPL_H
+#define AFINA_STORAGE_MAP_BASED_SHARED_NOTHING_IMPL_H
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MapBasedImplementation.h"
+#include <afina/Storage.h>
+#include <afina/core/EventCount.h>
+#include <afina/core/MPMCQueue.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Shared nothing map based implementation
+ * Keys are hashed to shards, each shard is owned by its own thread and is never touched by any other one, so
+ * the map and LRU list stay in the cache of a single core without locks. Callers push requests into the ring of
+ * the shard and wait for the owner to execute them: it takes requests in batches and sleeps on an event count
+ * when the ring is empty. Caller spins a little and then sleeps on futex of its request.
+ *
+ * Memory limit is split between shards evenly, owners evict elements above the limit between batches
+ */
+class MapBasedSharedNothingImpl : public Afina::Storage {
+public:
+    // max_size - in bytes, shards - number of owner threads, 0 means one per hardware thread
+    MapBasedSharedNothingImpl(size_t max_size = std::numeric_limits<int>::max(),
+                              const Core::MemoryPlacement &placement = Core::MemoryPlacement(), size_t shards = 0);
+    ~MapBasedSharedNothingImpl();
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) override;
+
+    // Implements Afina::Storage interface, sizes are summed over shards
+    void GetStatistics(std::map<std::string, std::string> &stats) override;
+
+    // Implements Afina::Storage interface, limit is split between shards
+    bool SetMemoryLimit(size_t max_size) override;
+
+    // Implements Afina::Storage interface
+    size_t GetMemoryLimit() override;
+
+    // Implements Afina::Storage interface, limit is split between shards
+    bool SetMaxMemoryLimit(size_t max_size) override;
+
+    // Implements Afina::Storage interface
+    size_t GetMaxMemoryLimit() override;
+
+    // Implements Afina::Storage interface
+    size_t GetMemoryUsage() override;
+
+    size_t GetShardsCount() const { return _owners.size(); }
+
+private:
+    enum class _OperationType {
+        kPut,
+        kPutIfAbsent,
+        kSet,
+        kDelete,
+        kGet,
+        kStatistics,
+        kSetMemoryLimit,
+        kSetMaxMemoryLimit,
+        kMemoryUsage
+    };
+
+    // Request lives on the stack of the caller until owner completes it
+    struct _Request {
+        _OperationType type;
+        const std::string *key;
+        const std::string *value;
+
+        // Output of kGet
+        std::string *output;
+
+        // Output of kStatistics
+        std::map<std::string, std::string> *stats;
+
+        // Input of kSetMemoryLimit and kSetMaxMemoryLimit, output of kMemoryUsage
+        size_t size;
+
+        bool result;
+        std::exception_ptr error;
+
+        // Futex word, see _Wait()
+        std::atomic<uint32_t> state;
+    };
+
+    // Map of a single shard used by its owner thread only, eviction runs there too
+    class _Shard : public MapBasedImplementation {
+    public:
+        _Shard(size_t max_size, const Core::MemoryPlacement &placement)
+            : MapBasedImplementation(max_size, placement) {}
+
+        using MapBasedImplementation::Delete;
+        using MapBasedImplementation::Get;
+        using MapBasedImplementation::GetHugePageUsage;
+        using MapBasedImplementation::GetMaxSize;
+        using MapBasedImplementation::GetMaxMemoryLimit;
+        using MapBasedImplementation::GetMemoryLimit;
+        using MapBasedImplementation::GetMemoryUsage;
+        using MapBasedImplementation::GetStatistics;
+        using MapBasedImplementation::Put;
+        using MapBasedImplementation::PutIfAbsent;
+        using MapBasedImplementation::Set;
+        using MapBasedImplementation::SetMaxMemoryLimit;
+        using MapBasedImplementation::SetMemoryLimit;
+        using MapBasedImplementation::_EvictStep;
+        using MapBasedImplementation::_GetElementSize;
+
+    protected:
+        bool _BackgroundEvictStep() override { return false; }
+    };
+
+    struct _Owner {
+        explicit _Owner(size_t ring_size) : ring(ring_size), evicting(false) {}
+
+        std::unique_ptr<_Shard> shard;
+        Core::MPMCQueue<_Request *> ring;
+        Core::EventCount event;
+        std::thread thread;
+
+        // Memory limit was lowered, owner evicts a portion after each batch. Accessed by owner only
+        bool evicting;
+    };
+
+    _Owner &_OwnerOf(const std::string &key) { return *_owners[std::hash<std::string>()(key) % _owners.size()]; }
+
+    // Passes request to the owner and waits until it is executed, rethrows exception of the operation
+    bool _Execute(_Owner &owner, _Request &request);
+
+    // Fills request of the given type, outputs are left empty
+    static void _Init(_Request &request, _OperationType type, const std::string *key = nullptr,
+                      const std::string *value = nullptr);
+
+    // Sleeps until owner completes request
+    void _Wait(_Request &request);
+
+    void _OwnerThread(_Owner &owner);
+    static void _Apply(_Owner &owner, _Request &request);
+
+    // Requests owner executes before it looks at eviction
+    static const size_t _batch_size = 64;
+
+
+    std::vector<std::unique_ptr<_Owner>> _owners;
+    std::atomic<bool> _stopping;
+
+    // Checks of the request state before caller goes to sleep, there is no point to spin on a single CPU
+    size_t _spin_count;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_MAP_BASED_SHARED_NOTHING_IMPL_H
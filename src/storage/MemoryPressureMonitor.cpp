@@ -0,0 +1,153 @@
+#include "MemoryPressureMonitor.h"
+
+#include <algorithm>
+
+#include <malloc.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Backend {
+
+constexpr double MemoryPressureMonitor::high_watermark;
+constexpr double MemoryPressureMonitor::low_watermark;
+constexpr double MemoryPressureMonitor::pressure_threshold;
+const size_t MemoryPressureMonitor::min_size;
+const size_t MemoryPressureMonitor::_cooldown;
+
+MemoryPressureMonitor::MemoryPressureMonitor(std::shared_ptr<Afina::Storage> storage, const Core::CgroupMemory &cgroup,
+                                             std::chrono::milliseconds period)
+    : _storage(storage), _cgroup(cgroup), _period(period), _event_fd(-1), _shrink_usage(0), _checks_since_shrink(0),
+      _calm_checks(0), _trim_pending(false) {}
+
+MemoryPressureMonitor::~MemoryPressureMonitor() { Stop(); }
+
+void MemoryPressureMonitor::Start() {
+    if (!_cgroup.IsAvailable() || _storage->GetMaxMemoryLimit() == 0) {
+        CURRENT_PROCESS_DEBUG("Memory pressure monitor is disabled: no cgroup v2 memory controller or resizable storage");
+        return;
+    }
+
+    _event_fd = eventfd(0, EFD_CLOEXEC);
+    VALIDATE_SYSTEM_FUNCTION(_event_fd);
+    _thread = std::thread(&MemoryPressureMonitor::_ThreadFunction, this);
+}
+
+void MemoryPressureMonitor::Stop() {
+    if (!_thread.joinable()) {
+        return;
+    }
+
+    uint64_t value = 1;
+    VALIDATE_SYSTEM_FUNCTION(write(_event_fd, &value, sizeof(value)));
+    _thread.join();
+
+    close(_event_fd);
+    _event_fd = -1;
+}
+
+void MemoryPressureMonitor::_ThreadFunction() {
+    // 100ms of stalls during 1s window is a sign to react before the next periodic check
+    int trigger_fd = _cgroup.OpenPressureTrigger(100000, 1000000);
+
+    pollfd fds[2];
+    fds[0].fd = _event_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = trigger_fd;
+    fds[1].events = POLLPRI;
+    nfds_t count = (trigger_fd >= 0) ? 2 : 1;
+
+    while (true) {
+        fds[0].revents = fds[1].revents = 0;
+        int result = poll(fds, count, _period.count());
+        if (result < 0 && errno != EINTR) {
+            CURRENT_PROCESS_DEBUG("Memory pressure monitor poll failed: " << std::strerror(errno));
+            break;
+        }
+        if (fds[0].revents != 0) {
+            break;
+        }
+        if (fds[1].revents & POLLERR) { // cgroup is gone, keep periodic checks only
+            count = 1;
+        }
+
+        try {
+            Check();
+        } catch (std::exception &e) {
+            CURRENT_PROCESS_DEBUG("Memory pressure check failed: " << e.what());
+        }
+    }
+
+    if (trigger_fd >= 0) {
+        close(trigger_fd);
+    }
+}
+
+void MemoryPressureMonitor::Check() {
+    // Configured limit may be changed by clients at any moment, budget follows it down immediately
+    size_t max_size = _storage->GetMaxMemoryLimit();
+    size_t budget = _storage->GetMemoryLimit();
+    if (budget > max_size) {
+        _storage->SetMemoryLimit(max_size);
+        budget = max_size;
+    }
+
+    size_t limit = _cgroup.Limit();
+    if (limit == Core::CgroupMemory::unlimited) {
+        if (budget < max_size) {
+            _storage->SetMemoryLimit(max_size);
+        }
+        return;
+    }
+
+    // Evicted memory returns to malloc, give it back to the system once storage has reached new budget
+    if (_trim_pending && _storage->GetMemoryUsage() <= budget) {
+        malloc_trim(0);
+        _trim_pending = false;
+    }
+
+    size_t current = _cgroup.Current();
+    size_t usage = current - std::min(current, _cgroup.InactiveFile());
+    bool stalled = _cgroup.Pressure() >= pressure_threshold;
+    size_t high = static_cast<size_t>(limit * high_watermark);
+    size_t low = static_cast<size_t>(limit * low_watermark);
+    _checks_since_shrink++;
+
+    if (usage > high || stalled) {
+        _calm_checks = 0;
+        if (usage <= _shrink_usage && _checks_since_shrink < _cooldown) {
+            return; // previous shrink isn't finished yet
+        }
+
+        // Stored bytes are less then memory they really take, so freeing excess of them is enough
+        size_t stored = _storage->GetMemoryUsage();
+        size_t excess = (usage > low) ? usage - low : stored / 10;
+        size_t new_budget = std::max(std::min(budget, (stored > excess) ? stored - excess : 0), min_size);
+        _Shrink(budget, new_budget, usage);
+    } else if (usage < low) {
+        if (++_calm_checks >= _cooldown && budget < max_size) {
+            size_t new_budget = std::min(max_size, budget + (low - usage) / 2);
+            CURRENT_PROCESS_DEBUG("Memory pressure is gone, storage budget " << budget << " -> " << new_budget);
+            _storage->SetMemoryLimit(new_budget);
+            _calm_checks = 0;
+        }
+    } else {
+        _calm_checks = 0;
+    }
+}
+
+void MemoryPressureMonitor::_Shrink(size_t budget, size_t new_budget, size_t usage) {
+    _shrink_usage = usage;
+    _checks_since_shrink = 0;
+    if (new_budget >= budget) {
+        return;
+    }
+
+    CURRENT_PROCESS_DEBUG("Memory pressure, usage " << usage << ", storage budget " << budget << " -> " << new_budget);
+    _storage->SetMemoryLimit(new_budget);
+    _trim_pending = true;
+}
+
+} // namespace Backend
+} // namespace Afina
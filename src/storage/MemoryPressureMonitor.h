@@ -0,0 +1,83 @@
+#ifndef AFINA_STORAGE_MEMORY_PRESSURE_MONITOR_H
+#define AFINA_STORAGE_MEMORY_PRESSURE_MONITOR_H
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "./../core/CgroupMemory.h"
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Memory pressure monitor
+ * Keeps the process under memory limit of its cgroup by changing memory budget of the storage. Storage
+ * is shrunk once cgroup usage (without reclaimable page cache) goes above the high watermark or PSI
+ * reports tasks stalled on memory, and grows back towards configured limit of the storage (see
+ * Storage::SetMaxMemoryLimit) after usage stays below the low watermark for a while. Eviction itself is done by the
+ * storage in the background.
+ *
+ * State is checked periodically and additionally right after PSI trigger fires, if kernel supports them
+ */
+class MemoryPressureMonitor {
+public:
+    MemoryPressureMonitor(std::shared_ptr<Afina::Storage> storage,
+                          const Core::CgroupMemory &cgroup = Core::CgroupMemory(),
+                          std::chrono::milliseconds period = std::chrono::milliseconds(1000));
+    ~MemoryPressureMonitor();
+
+    MemoryPressureMonitor(const MemoryPressureMonitor &) = delete;
+    MemoryPressureMonitor &operator=(const MemoryPressureMonitor &) = delete;
+
+    // Starts monitoring thread, does nothing if cgroup memory controller is not available
+    void Start();
+    void Stop();
+
+    // Reads cgroup state once and adjusts storage budget, called by the monitoring thread
+    void Check();
+
+    // Fractions of cgroup limit: shrink above the high one, grow below the low one
+    static constexpr double high_watermark = 0.90;
+    static constexpr double low_watermark = 0.80;
+
+    // PSI "some avg10" percentage considered as memory pressure
+    static constexpr double pressure_threshold = 10.0;
+
+    // Budget is never lowered below this value
+    static const size_t min_size = 1 << 20;
+
+private:
+    std::shared_ptr<Afina::Storage> _storage;
+    Core::CgroupMemory _cgroup;
+    std::chrono::milliseconds _period;
+
+    std::thread _thread;
+
+    // Wakes thread up on Stop()
+    int _event_fd;
+
+    // Usage at the moment of the last shrink and checks passed since it, evicted memory is reused by the storage
+    // and not always returned to the system, so it is shrunk again only if usage keeps growing or after cooldown
+    size_t _shrink_usage;
+    size_t _checks_since_shrink;
+
+    // Consecutive checks with usage below the low watermark
+    size_t _calm_checks;
+
+    // Budget was lowered, memory should be returned to the system after eviction
+    bool _trim_pending;
+
+    // Checks to wait after shrink and before grow
+    static const size_t _cooldown = 5;
+
+    void _ThreadFunction();
+
+    void _Shrink(size_t budget, size_t new_budget, size_t usage);
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_MEMORY_PRESSURE_MONITOR_H
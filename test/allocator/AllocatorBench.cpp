@@ -0,0 +1,522 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <malloc.h>
+
+#include <cxxopts.hpp>
+
+#include <afina/allocator/Error.h>
+#include <afina/allocator/Pointer.h>
+#include <afina/allocator/Simple.h>
+#include <core/memory/SlabPool.h>
+
+/**
+ * # Allocators benchmark
+ * Replays the same sequence of alloc/free operations against every allocator and reports throughput, peak RSS,
+ * fragmentation and defragmentation pauses. Sequence is either generated from one of size distributions or
+ * loaded from a trace file, each line of which is "a <id> <size>" or "f <id>", zero size allocations are skipped
+ */
+
+using namespace Afina;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Operation {
+    bool alloc;
+    size_t id;
+    size_t size;
+};
+
+struct Workload {
+    std::vector<Operation> operations;
+    size_t max_id = 0;
+};
+
+// Sizes of values in memcached-like cache: mostly small with a long tail
+size_t MemcachedSize(std::mt19937 &rnd) {
+    std::uniform_real_distribution<double> kind(0, 1);
+    double k = kind(rnd);
+    if (k < 0.70) {
+        return std::uniform_int_distribution<size_t>(16, 128)(rnd);
+    } else if (k < 0.95) {
+        return std::uniform_int_distribution<size_t>(129, 4096)(rnd);
+    }
+    return std::uniform_int_distribution<size_t>(4097, 64 * 1024)(rnd);
+}
+
+/**
+ * Keeps live set of about `live` objects, each step either frees random object or allocates new one.
+ * "phases" distribution allocates small objects, frees every other one and then asks for bigger objects,
+ * that is a classic scenario of external fragmentation
+ */
+Workload Generate(const std::string &distribution, size_t ops, size_t live, unsigned seed) {
+    std::mt19937 rnd(seed);
+    Workload result;
+    std::vector<size_t> alive;
+
+    auto alloc = [&](size_t size) {
+        result.operations.push_back({true, result.max_id, size});
+        alive.push_back(result.max_id++);
+    };
+    auto free_at = [&](size_t position) {
+        result.operations.push_back({false, alive[position], 0});
+        alive[position] = alive.back();
+        alive.pop_back();
+    };
+
+    if (distribution == "phases") {
+        size_t rounds = std::max<size_t>(1, ops / (2 * live));
+        size_t size = 32;
+        for (size_t round = 0; round < rounds; round++, size = std::min<size_t>(size * 2, 16 * 1024)) {
+            for (size_t i = 0; i < live; i++) {
+                alloc(size);
+            }
+            for (size_t i = 0; i < alive.size(); i++) { // every other object
+                free_at(i);
+            }
+        }
+    } else {
+        std::function<size_t()> next_size;
+        if (distribution == "memcached") {
+            next_size = [&rnd]() { return MemcachedSize(rnd); };
+        } else if (distribution == "uniform") {
+            next_size = [&rnd]() { return std::uniform_int_distribution<size_t>(8, 1024)(rnd); };
+        } else if (distribution == "fixed") {
+            next_size = []() { return size_t(64); };
+        } else {
+            throw std::invalid_argument("Unknown distribution: " + distribution);
+        }
+
+        std::uniform_int_distribution<size_t> coin(0, 1);
+        while (result.operations.size() < ops) {
+            if (alive.size() < live || (coin(rnd) == 0 && alive.size() < 2 * live)) {
+                alloc(next_size());
+            } else {
+                free_at(std::uniform_int_distribution<size_t>(0, alive.size() - 1)(rnd));
+            }
+        }
+    }
+
+    // Release everything that is left, so every allocator ends up empty
+    while (!alive.empty()) {
+        free_at(alive.size() - 1);
+    }
+    return result;
+}
+
+Workload LoadTrace(const std::string &path) {
+    std::ifstream input(path);
+    if (!input.is_open()) {
+        throw std::runtime_error("Cannot open trace " + path);
+    }
+
+    Workload result;
+    std::string line;
+    while (std::getline(input, line)) {
+        std::stringstream stream(line);
+        char kind = 0;
+        Operation op = {false, 0, 0};
+        stream >> kind >> op.id;
+        if (kind == 'a') {
+            op.alloc = true;
+            stream >> op.size;
+        } else if (kind != 'f') {
+            continue;
+        }
+        // Zero size allocation has no bytes to touch, its free is skipped by Run() as for any failed allocation
+        if (stream.fail() || (op.alloc && op.size == 0)) {
+            continue;
+        }
+        result.operations.push_back(op);
+        result.max_id = std::max(result.max_id, op.id + 1);
+    }
+    return result;
+}
+
+void SaveTrace(const Workload &workload, const std::string &path) {
+    std::ofstream output(path);
+    for (auto &op : workload.operations) {
+        if (op.alloc) {
+            output << "a " << op.id << " " << op.size << "\n";
+        } else {
+            output << "f " << op.id << "\n";
+        }
+    }
+}
+
+/**
+ * Allocator under test. Objects are addressed by workload ids
+ */
+class BenchAllocator {
+public:
+    virtual ~BenchAllocator() {}
+    virtual std::string Name() const = 0;
+
+    // Returns nullptr if allocator cannot serve request
+    virtual void *Alloc(size_t id, size_t size) = 0;
+    virtual void Free(size_t id) = 0;
+
+    // Bytes really reserved for the object (>= requested size)
+    virtual size_t Granted(size_t, size_t size) const { return size; }
+
+    // Bytes allocator holds now
+    virtual size_t Footprint() const = 0;
+
+    virtual bool CanDefrag() const { return false; }
+    virtual void Defrag() {}
+};
+
+size_t MallocFootprint() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+#else
+    struct mallinfo info = mallinfo();
+#endif
+    return size_t(info.arena) + size_t(info.hblkhd);
+}
+
+class MallocAllocator : public BenchAllocator {
+public:
+    MallocAllocator(size_t max_id) : _objects(max_id, nullptr), _baseline(MallocFootprint()) {}
+
+    std::string Name() const override { return "malloc"; }
+
+    void *Alloc(size_t id, size_t size) override { return _objects[id] = std::malloc(size); }
+    void Free(size_t id) override {
+        std::free(_objects[id]);
+        _objects[id] = nullptr;
+    }
+    size_t Granted(size_t id, size_t) const override { return malloc_usable_size(_objects[id]); }
+    size_t Footprint() const override {
+        size_t current = MallocFootprint();
+        return current > _baseline ? current - _baseline : 0;
+    }
+
+private:
+    std::vector<void *> _objects;
+    size_t _baseline;
+};
+
+class SimpleAllocator : public BenchAllocator {
+public:
+    SimpleAllocator(size_t max_id, size_t arena_size)
+        : _arena(new char[arena_size]), _arena_size(arena_size), _allocator(_arena.get(), arena_size),
+          _objects(max_id) {}
+
+    std::string Name() const override { return "simple"; }
+
+    void *Alloc(size_t id, size_t size) override {
+        try {
+            _objects[id] = _allocator.alloc(size);
+        } catch (Allocator::AllocError &) {
+            return nullptr;
+        }
+        return _objects[id].get();
+    }
+    void Free(size_t id) override { _allocator.free(_objects[id]); }
+    size_t Footprint() const override { return _arena_size; }
+
+    bool CanDefrag() const override { return true; }
+    void Defrag() override { _allocator.defrag(); }
+
+private:
+    std::unique_ptr<char[]> _arena;
+    size_t _arena_size;
+    Allocator::Simple _allocator;
+    std::vector<Allocator::Pointer> _objects;
+};
+
+// Power of two size classes on top of Core::SlabPool, objects bigger than the last class go to malloc
+class SlabAllocator : public BenchAllocator {
+public:
+    static const size_t min_class = 16;
+    static const size_t max_class = 64 * 1024;
+
+    SlabAllocator(size_t max_id, const Core::MemoryPlacement &placement) : _objects(max_id) {
+        for (size_t size = min_class; size <= max_class; size *= 2) {
+            _classes.emplace_back(new Core::SlabPool(size, placement, 256 * 1024));
+        }
+    }
+
+    std::string Name() const override { return "slab"; }
+
+    void *Alloc(size_t id, size_t size) override {
+        size_t cls = _ClassOf(size);
+        _objects[id].cls = cls;
+        if (cls == _classes.size()) {
+            _objects[id].ptr = std::malloc(size);
+            _large_bytes += malloc_usable_size(_objects[id].ptr);
+        } else {
+            _objects[id].ptr = _classes[cls]->Allocate();
+        }
+        return _objects[id].ptr;
+    }
+
+    void Free(size_t id) override {
+        Object &object = _objects[id];
+        if (object.cls == _classes.size()) {
+            _large_bytes -= malloc_usable_size(object.ptr);
+            std::free(object.ptr);
+        } else {
+            _classes[object.cls]->Free(object.ptr);
+        }
+        object.ptr = nullptr;
+    }
+
+    size_t Granted(size_t id, size_t) const override {
+        const Object &object = _objects[id];
+        if (object.cls == _classes.size()) {
+            return malloc_usable_size(object.ptr);
+        }
+        return _classes[object.cls]->ObjectSize();
+    }
+
+    size_t Footprint() const override {
+        size_t result = _large_bytes;
+        for (auto &pool : _classes) {
+            result += pool->MappedBytes();
+        }
+        return result;
+    }
+
+private:
+    struct Object {
+        void *ptr = nullptr;
+        size_t cls = 0;
+    };
+
+    std::vector<std::unique_ptr<Core::SlabPool>> _classes;
+    std::vector<Object> _objects;
+    size_t _large_bytes = 0;
+
+    size_t _ClassOf(size_t size) const {
+        size_t cls = 0;
+        for (size_t class_size = min_class; class_size < size && cls < _classes.size(); class_size *= 2) {
+            cls++;
+        }
+        return cls;
+    }
+};
+
+// Peak RSS could be reset only since linux 4.0, otherwise it is peak of the whole process
+void ResetPeakRSS() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    if (clear_refs.is_open()) {
+        clear_refs << "5";
+    }
+}
+
+size_t PeakRSSKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stoull(line.substr(6));
+        }
+    }
+    return 0;
+}
+
+struct Result {
+    double ops_per_sec = 0;
+    size_t peak_rss_kb = 0;
+    double internal_fragmentation = 0;
+    double external_fragmentation = 0;
+    size_t failed = 0;
+    size_t defrags = 0;
+    double defrag_max_us = 0;
+    double defrag_avg_us = 0;
+};
+
+// Operations timed at once: a pair of clock reads costs about as much as a small allocation
+const size_t timing_batch = 256;
+
+/**
+ * Fragmentation is sampled between batches, at the one with the maximum live bytes:
+ * internal = 1 - requested / granted, external = 1 - granted / footprint
+ *
+ * Only allocator calls (and touching of allocated pages) are timed, by batches of operations. Sampling of
+ * fragmentation queries allocator as well and must not count as its work, so it is done between batches
+ */
+Result Run(BenchAllocator &allocator, const Workload &workload, size_t defrag_every) {
+    Result result;
+    const std::vector<Operation> &ops = workload.operations;
+    std::vector<size_t> sizes(workload.max_id, 0);
+    std::vector<size_t> granted(workload.max_id, 0);
+    std::vector<bool> allocated(workload.max_id, false);
+    size_t live_requested = 0, live_granted = 0, peak_requested = 0;
+    double defrag_total_us = 0;
+    bool defrag = allocator.CanDefrag() && defrag_every != 0;
+
+    // Which operations of the batch were really done and objects allocated by it
+    std::vector<bool> done(timing_batch);
+    std::vector<size_t> fresh;
+
+    ResetPeakRSS();
+    Clock::duration spent = Clock::duration::zero();
+    for (size_t begin = 0; begin < ops.size();) {
+        size_t end = std::min(ops.size(), begin + timing_batch);
+        if (defrag) {
+            end = std::min(end, (begin / defrag_every + 1) * defrag_every);
+        }
+
+        Clock::time_point start = Clock::now();
+        for (size_t i = begin; i < end; i++) {
+            const Operation &op = ops[i];
+            done[i - begin] = false;
+            if (op.alloc) {
+                char *ptr = static_cast<char *>(allocator.Alloc(op.id, op.size));
+                if (ptr == nullptr) {
+                    continue;
+                }
+                // Touch every page, so RSS reflects the real usage
+                for (size_t offset = 0; offset < op.size; offset += 4096) {
+                    ptr[offset] = char(op.id);
+                }
+                ptr[op.size - 1] = char(op.id);
+                allocated[op.id] = done[i - begin] = true;
+            } else if (allocated[op.id]) {
+                allocator.Free(op.id);
+                allocated[op.id] = false;
+                done[i - begin] = true;
+            }
+        }
+        spent += Clock::now() - start;
+
+        for (size_t i = begin; i < end; i++) {
+            const Operation &op = ops[i];
+            if (!done[i - begin]) {
+                result.failed += op.alloc ? 1 : 0;
+            } else if (op.alloc) {
+                sizes[op.id] = op.size;
+                granted[op.id] = 0;
+                live_requested += op.size;
+                fresh.push_back(op.id);
+            } else {
+                live_requested -= sizes[op.id];
+                live_granted -= granted[op.id];
+                granted[op.id] = 0;
+            }
+        }
+
+        // Objects freed by the same batch can't be asked anymore, they aren't live at the sample point anyway
+        for (size_t id : fresh) {
+            if (allocated[id] && granted[id] == 0) {
+                granted[id] = allocator.Granted(id, sizes[id]);
+                live_granted += granted[id];
+            }
+        }
+        fresh.clear();
+
+        if (live_requested > peak_requested) {
+            peak_requested = live_requested;
+            if (live_granted != 0) {
+                result.internal_fragmentation = 1.0 - double(live_requested) / live_granted;
+            }
+            size_t footprint = allocator.Footprint();
+            if (footprint != 0) {
+                result.external_fragmentation = std::max(0.0, 1.0 - double(live_granted) / footprint);
+            }
+        }
+
+        // Defragmentation pauses are reported on their own, not as a part of throughput
+        if (defrag && end % defrag_every == 0) {
+            Clock::time_point defrag_start = Clock::now();
+            allocator.Defrag();
+            double pause = std::chrono::duration<double, std::micro>(Clock::now() - defrag_start).count();
+
+            result.defrags++;
+            result.defrag_max_us = std::max(result.defrag_max_us, pause);
+            defrag_total_us += pause;
+        }
+
+        begin = end;
+    }
+
+    double seconds = std::chrono::duration<double>(spent).count();
+    result.ops_per_sec = (seconds > 0) ? workload.operations.size() / seconds : 0;
+    result.peak_rss_kb = PeakRSSKb();
+    result.defrag_avg_us = (result.defrags != 0) ? defrag_total_us / result.defrags : 0;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    cxxopts::Options options("runAllocatorBench", "Throughput and fragmentation of allocators");
+    options.add_options()("d,distribution", "Sizes: memcached, uniform, fixed, phases",
+                          cxxopts::value<std::string>()->default_value("memcached"));
+    options.add_options()("o,ops", "Number of operations", cxxopts::value<size_t>()->default_value("1000000"));
+    options.add_options()("l,live", "Average number of live objects", cxxopts::value<size_t>()->default_value("10000"));
+    options.add_options()("s,seed", "Random seed", cxxopts::value<unsigned>()->default_value("42"));
+    options.add_options()("t,trace", "Replay operations from file instead of generating", cxxopts::value<std::string>());
+    options.add_options()("record", "Save generated operations to file", cxxopts::value<std::string>());
+    options.add_options()("arena", "Arena size for Simple allocator, MB", cxxopts::value<size_t>()->default_value("256"));
+    options.add_options()("defrag-every", "Call defrag() every N operations, 0 - never",
+                          cxxopts::value<size_t>()->default_value("100000"));
+    options.add_options()("hugepages", "Pages for slab allocator: none, thp, 2mb, 1gb",
+                          cxxopts::value<std::string>()->default_value("none"));
+    options.add_options()("h,help", "Print usage info");
+
+    try {
+        options.parse(argc, argv);
+        if (options.count("help") > 0) {
+            std::cerr << options.help() << std::endl;
+            return 0;
+        }
+
+        Workload workload;
+        if (options.count("trace") > 0) {
+            workload = LoadTrace(options["trace"].as<std::string>());
+        } else {
+            workload = Generate(options["distribution"].as<std::string>(), options["ops"].as<size_t>(),
+                                options["live"].as<size_t>(), options["seed"].as<unsigned>());
+        }
+        if (options.count("record") > 0) {
+            SaveTrace(workload, options["record"].as<std::string>());
+        }
+
+        // Allocators are created one by one right before the run, so they don't affect footprint of each other
+        Core::MemoryPlacement placement(Core::HugePageRegion::ParseMode(options["hugepages"].as<std::string>()));
+        size_t arena_size = options["arena"].as<size_t>() << 20;
+        std::vector<std::function<BenchAllocator *()>> allocators = {
+            [&workload]() { return new MallocAllocator(workload.max_id); },
+            [&workload, arena_size]() { return new SimpleAllocator(workload.max_id, arena_size); },
+            [&workload, &placement]() { return new SlabAllocator(workload.max_id, placement); }};
+
+        std::cout << "operations: " << workload.operations.size() << std::endl;
+        std::cout << std::left << std::setw(10) << "allocator" << std::right << std::setw(14) << "ops/sec"
+                  << std::setw(14) << "peak_rss_kb" << std::setw(12) << "internal" << std::setw(12) << "external"
+                  << std::setw(10) << "failed" << std::setw(10) << "defrags" << std::setw(14) << "defrag_max_us"
+                  << std::setw(14) << "defrag_avg_us" << std::endl;
+
+        for (auto &create : allocators) {
+            std::unique_ptr<BenchAllocator> allocator(create());
+            Result r = Run(*allocator, workload, options["defrag-every"].as<size_t>());
+            std::cout << std::left << std::setw(10) << allocator->Name() << std::right << std::fixed
+                      << std::setprecision(0) << std::setw(14) << r.ops_per_sec << std::setw(14) << r.peak_rss_kb
+                      << std::setprecision(3) << std::setw(12) << r.internal_fragmentation << std::setw(12)
+                      << r.external_fragmentation << std::setw(10) << r.failed << std::setw(10) << r.defrags
+                      << std::setprecision(1) << std::setw(14) << r.defrag_max_us << std::setw(14)
+                      << r.defrag_avg_us << std::endl;
+        }
+    } catch (std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <core/multithreading/FlatCombined.h>
+#include <core/multithreading/FlatCombiner.hpp>
+
+using namespace Afina::Core;
+
+TEST(FlatCombinedQueueTest, FifoOfMoveOnly) {
+    FlatCombinedQueue<std::unique_ptr<int>> queue;
+    for (int i = 0; i < 10; i++) {
+        queue.Push(std::unique_ptr<int>(new int(i)));
+    }
+    ASSERT_EQ(10, queue.Size());
+
+    std::unique_ptr<int> value;
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(queue.TryPop(value));
+        ASSERT_EQ(i, *value);
+    }
+    ASSERT_FALSE(queue.TryPop(value));
+    ASSERT_EQ(0, queue.Size());
+}
+
+TEST(FlatCombinedQueueTest, ManyProducersAndConsumers) {
+    const int producers = 4, consumers = 4, per_producer = 5000;
+    FlatCombinedQueue<int> queue;
+    std::atomic<long long> sum(0);
+    std::atomic<int> taken(0);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, p, per_producer]() {
+            for (int i = 1; i <= per_producer; i++) {
+                queue.Push(p * per_producer + i);
+            }
+        });
+    }
+    for (int c = 0; c < consumers; c++) {
+        threads.emplace_back([&queue, &sum, &taken, producers, per_producer]() {
+            int value;
+            while (taken.load() < producers * per_producer) {
+                if (queue.TryPop(value)) {
+                    sum += value;
+                    taken++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    long long total = (long long)producers * per_producer;
+    ASSERT_EQ(total * (total + 1) / 2, sum.load());
+}
+
+TEST(FlatCombinedPriorityQueueTest, ExpiryOrder) {
+    typedef std::chrono::steady_clock::time_point Deadline;
+    FlatCombinedPriorityQueue<Deadline, std::greater<Deadline>> expiry;
+
+    Deadline now = std::chrono::steady_clock::now();
+    for (int seconds : {5, 1, 3, 2, 4}) {
+        expiry.Push(now + std::chrono::seconds(seconds));
+    }
+
+    Deadline top;
+    ASSERT_TRUE(expiry.TryPop(top));
+    ASSERT_TRUE(top == now + std::chrono::seconds(1));
+
+    std::vector<Deadline> expired;
+    ASSERT_EQ(2, expiry.PopBefore(now + std::chrono::seconds(3), expired));
+    ASSERT_TRUE(expired[0] == now + std::chrono::seconds(2));
+    ASSERT_TRUE(expired[1] == now + std::chrono::seconds(3));
+    ASSERT_EQ(0, expiry.PopBefore(now, expired));
+    ASSERT_EQ(2, expiry.Size());
+}
+
+TEST(FlatCombinedStatisticsTest, ConcurrentCounters) {
+    const int threads_count = 8, per_thread = 2000;
+    FlatCombinedStatistics statistics;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threads_count; t++) {
+        threads.emplace_back([&statistics, t, per_thread]() {
+            std::string name = (t % 2 == 0) ? "cmd_get" : "cmd_set";
+            for (int i = 0; i < per_thread; i++) {
+                statistics.Add(name);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    statistics.Set("connections", 3);
+
+    std::map<std::string, std::string> stats;
+    statistics.Append(stats, "server_");
+    ASSERT_EQ(std::to_string(threads_count / 2 * per_thread), stats["server_cmd_get"]);
+    ASSERT_EQ(std::to_string(threads_count / 2 * per_thread), stats["server_cmd_set"]);
+    ASSERT_EQ("3", stats["server_connections"]);
+}
+
+// Waiters don't spin at all, so nearly every operation goes through parking
+void RunParkedThreads(uint64_t saving_time) {
+    struct Operation {
+        int delta;
+        bool operator<(const Operation &other) const { return delta < other.delta; }
+    };
+    typedef FlatCombiner<Operation> Combiner;
+
+    const int threads_count = 16, per_thread = 5000;
+    long long sum = 0;
+    Combiner combiner(
+        [&sum](Combiner::FlatCombinerShotArrayType &shot) {
+            for (Combiner::OperationWrapperPtr operation : shot) {
+                if (operation == nullptr) {
+                    break;
+                }
+                sum += operation->GetData().delta;
+                operation->OnExecutionComplete(nullptr);
+            }
+        },
+        saving_time, true, Combiner::WaitPolicy(0, true));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threads_count; t++) {
+        threads.emplace_back([&combiner, per_thread]() {
+            Combiner::OperationWrapperPtr slot = combiner.GetThreadSlotOperation();
+            for (int i = 1; i <= per_thread; i++) {
+                Operation operation = {i};
+                slot->SetOperation(operation);
+                combiner.ApplyThreadSlot();
+            }
+            combiner.DetachThread();
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ((long long)threads_count * per_thread * (per_thread + 1) / 2, sum);
+}
+
+TEST(FlatCombinerTest, ParkedThreadsComplete) { RunParkedThreads(100000); }
+
+// Idle slots are removed from the queue on every pass, including ones whose owner is publishing operation
+TEST(FlatCombinerTest, ParkedThreadsCompleteWithoutSavingTime) { RunParkedThreads(0); }
+
+// On a single CPU waiter yields right away, spinning and parking only slow the combiner down there
+TEST(FlatCombinerTest, DefaultWaitPolicy) {
+    FlatCombiner<int>::WaitPolicy wait;
+    if (std::thread::hardware_concurrency() == 1) {
+        ASSERT_EQ(0, wait.spin_count);
+        ASSERT_FALSE(wait.park);
+    } else {
+        ASSERT_LT(0, wait.spin_count);
+        ASSERT_TRUE(wait.park);
+    }
+}
@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <core/multithreading/FlatCombiner.hpp>
+
+using namespace Afina::Core;
+
+// Operation counting comparisons, so a test could tell whether the combiner sorted the shot
+struct CountedOperation {
+    int key;
+    static std::atomic<int> comparisons;
+
+    bool operator<(const CountedOperation &other) const {
+        comparisons++;
+        return key < other.key;
+    }
+};
+
+std::atomic<int> CountedOperation::comparisons(0);
+
+void RunSortedShots(bool need_sort_shot) {
+    typedef FlatCombiner<CountedOperation> Combiner;
+
+    const int threads_count = 8, per_thread = 2000;
+    std::atomic<int> unsorted_shots(0);
+    Combiner combiner(
+        [&unsorted_shots](Combiner::FlatCombinerShotArrayType &shot) {
+            int previous = -1;
+            bool sorted = true;
+            for (Combiner::OperationWrapperPtr operation : shot) {
+                if (operation == nullptr) {
+                    break;
+                }
+                sorted = sorted && (previous <= operation->GetData().key);
+                previous = operation->GetData().key;
+                operation->OnExecutionComplete(nullptr);
+            }
+            if (!sorted) {
+                unsorted_shots++;
+            }
+        },
+        100000, need_sort_shot);
+
+    CountedOperation::comparisons.store(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threads_count; t++) {
+        threads.emplace_back([&combiner, t, threads_count, per_thread]() {
+            Combiner::OperationWrapperPtr slot = combiner.GetThreadSlotOperation();
+            for (int i = 0; i < per_thread; i++) {
+                CountedOperation operation = {threads_count - t};
+                slot->SetOperation(operation);
+                combiner.ApplyThreadSlot();
+            }
+            combiner.DetachThread();
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    if (need_sort_shot) {
+        ASSERT_EQ(0, unsorted_shots.load());
+    } else {
+        ASSERT_EQ(0, CountedOperation::comparisons.load());
+    }
+}
+
+TEST(FlatCombinerTest, SortedShot) { RunSortedShots(true); }
+
+TEST(FlatCombinerTest, UnsortedShotIsNotCompared) { RunSortedShots(false); }
+
+// Short lived threads join and detach while others keep working: detached slots are removed from the queue
+// while new ones are pushed to its head, so removal has to walk from the new head down to the slot's parent
+TEST(FlatCombinerTest, ThreadsComeAndGo) {
+    struct Operation {
+        int delta;
+        bool operator<(const Operation &other) const { return delta < other.delta; }
+    };
+    typedef FlatCombiner<Operation> Combiner;
+
+    const int waves = 20, threads_count = 8, per_thread = 200;
+    std::atomic<long long> sum(0);
+    Combiner combiner(
+        [&sum](Combiner::FlatCombinerShotArrayType &shot) {
+            for (Combiner::OperationWrapperPtr operation : shot) {
+                if (operation == nullptr) {
+                    break;
+                }
+                sum += operation->GetData().delta;
+                operation->OnExecutionComplete(nullptr);
+            }
+        },
+        0, false);
+
+    for (int wave = 0; wave < waves; wave++) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threads_count; t++) {
+            threads.emplace_back([&combiner, t, per_thread]() {
+                Combiner::OperationWrapperPtr slot = combiner.GetThreadSlotOperation();
+                // Threads leave at different moments, so detached slots are spread over the queue
+                for (int i = 0; i < per_thread * (t + 1); i++) {
+                    Operation operation = {1};
+                    slot->SetOperation(operation);
+                    combiner.ApplyThreadSlot();
+                }
+                combiner.DetachThread();
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+
+    ASSERT_EQ((long long)waves * per_thread * threads_count * (threads_count + 1) / 2, sum.load());
+}
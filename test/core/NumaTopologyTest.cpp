@@ -0,0 +1,36 @@
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <core/NumaTopology.h>
+
+using namespace Afina::Core;
+
+TEST(NumaTopologyTest, ParseRanges) {
+    std::vector<int> expected = {0, 1, 2, 3, 8, 9, 10, 11};
+    ASSERT_EQ(expected, NumaTopology::ParseList("0-3,8-11"));
+
+    expected = {0, 2, 4, 5};
+    ASSERT_EQ(expected, NumaTopology::ParseList("0,2,4-5"));
+}
+
+TEST(NumaTopologyTest, ParseEmptyList) {
+    ASSERT_TRUE(NumaTopology::ParseList("").empty());
+    ASSERT_TRUE(NumaTopology::ParseList("\n").empty());
+}
+
+TEST(NumaTopologyTest, ParseTrailingNewline) {
+    // Lists are read from sysfs files, which end with a newline
+    std::vector<int> expected = {0, 1, 2, 3, 8, 9, 10, 11};
+    ASSERT_EQ(expected, NumaTopology::ParseList("0-3,8-11\n"));
+    ASSERT_EQ(expected, NumaTopology::ParseList("0-3,8-11,\n"));
+
+    expected = {5};
+    ASSERT_EQ(expected, NumaTopology::ParseList("5\n"));
+}
+
+TEST(NumaTopologyTest, ParseMalformedList) {
+    ASSERT_THROW(NumaTopology::ParseList("a-b"), std::invalid_argument);
+}
@@ -0,0 +1,536 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <new>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <afina/core/MPMCQueue.h>
+#include <core/multithreading/Future.h>
+#include <core/multithreading/Task.h>
+#include <core/multithreading/ThreadPool.h>
+#include <core/multithreading/WorkStealingThreadPool.h>
+
+using namespace Afina::Core;
+
+// Allocations made by the current thread are counted while the flag is set
+static thread_local bool count_allocations = false;
+static std::atomic<int> allocations(0);
+
+void *operator new(size_t size) {
+    if (count_allocations) {
+        allocations++;
+    }
+    void *result = std::malloc(size == 0 ? 1 : size);
+    if (result == nullptr) {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+
+TEST(MPMCQueueTest, FullAndEmpty) {
+    MPMCQueue<int> queue(3);
+    ASSERT_EQ(4, queue.Capacity());
+
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(queue.TryPush(i));
+    }
+    int value = 10;
+    ASSERT_FALSE(queue.TryPush(value));
+    ASSERT_EQ(10, value);
+
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(queue.TryPop(value));
+        ASSERT_EQ(i, value);
+    }
+    ASSERT_FALSE(queue.TryPop(value));
+}
+
+TEST(MPMCQueueTest, ManyProducersAndConsumers) {
+    const int producers = 4, consumers = 4, per_producer = 100000;
+    MPMCQueue<int> queue(64);
+    std::atomic<long long> sum(0);
+    std::atomic<int> received(0);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, p]() {
+            for (int i = 0; i < per_producer; i++) {
+                int value = p * per_producer + i;
+                while (!queue.TryPush(value)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < consumers; c++) {
+        threads.emplace_back([&]() {
+            int value;
+            while (received.load() < producers * per_producer) {
+                if (queue.TryPop(value)) {
+                    sum += value;
+                    received++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    long long total = (long long)producers * per_producer;
+    ASSERT_EQ(total * (total - 1) / 2, sum.load());
+}
+
+TEST(WorkStealingThreadPoolTest, ExecutesAllTasks) {
+    WorkStealingThreadPool pool;
+    pool.Start(4, 1 << 16);
+
+    std::atomic<int> counter(0);
+    for (int i = 0; i < 50000; i++) {
+        while (!pool.Execute([&counter](int add) { counter += add; }, 1)) {
+            std::this_thread::yield();
+        }
+    }
+    pool.Stop(true);
+    ASSERT_EQ(50000, counter.load());
+    ASSERT_EQ(WorkStealingThreadPool::State::kStopped, pool.GetState());
+}
+
+void _spread(WorkStealingThreadPool &pool, std::atomic<int> &counter, std::set<std::thread::id> &threads,
+             std::mutex &lock, int depth) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        threads.insert(std::this_thread::get_id());
+    }
+    counter++;
+    if (depth == 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        return;
+    }
+    // Tasks go to the deque of this worker, the others should steal them
+    pool.Execute(_spread, std::ref(pool), std::ref(counter), std::ref(threads), std::ref(lock), depth - 1);
+    pool.Execute(_spread, std::ref(pool), std::ref(counter), std::ref(threads), std::ref(lock), depth - 1);
+}
+
+TEST(WorkStealingThreadPoolTest, TasksFromWorkersAreStolen) {
+    WorkStealingThreadPool pool;
+    pool.Start(4, 1 << 16);
+
+    std::atomic<int> counter(0);
+    std::set<std::thread::id> threads;
+    std::mutex lock;
+    ASSERT_TRUE(pool.Execute(_spread, std::ref(pool), std::ref(counter), std::ref(threads), std::ref(lock), 10));
+    while (counter.load() < (1 << 11) - 1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    pool.Stop(true);
+
+    ASSERT_EQ((1 << 11) - 1, counter.load());
+    ASSERT_GT(threads.size(), 1);
+}
+
+TEST(WorkStealingThreadPoolTest, QueueLimit) {
+    WorkStealingThreadPool pool;
+    pool.Start(1, 2);
+
+    std::atomic<bool> release(false);
+    std::atomic<int> started(0);
+    auto blocker = [&release, &started]() {
+        started++;
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    };
+
+    // The first task occupies the only thread, two more wait in the queue
+    ASSERT_TRUE(pool.Execute(blocker));
+    while (started.load() == 0) {
+        std::this_thread::yield();
+    }
+    ASSERT_TRUE(pool.Execute(blocker));
+    ASSERT_TRUE(pool.Execute(blocker));
+    ASSERT_FALSE(pool.Execute(blocker));
+
+    release.store(true);
+    pool.Stop(true);
+    ASSERT_FALSE(pool.Execute(blocker));
+    ASSERT_EQ(3, started.load());
+}
+
+TEST(WorkStealingThreadPoolTest, StopRunsQueuedTasks) {
+    WorkStealingThreadPool pool;
+    pool.Start(2, 1024);
+
+    std::atomic<int> counter(0);
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(pool.Execute([&counter]() {
+            std::this_thread::sleep_for(std::chrono::microseconds(10));
+            counter++;
+        }));
+    }
+    pool.Stop(true);
+    ASSERT_EQ(1000, counter.load());
+}
+
+TEST(TaskTest, InlineAndHeapCallables) {
+    int counter = 0;
+    auto small = [&counter]() { counter++; };
+    char big_data[Task::inline_size * 2] = {1};
+    auto big = [&counter, big_data]() { counter += big_data[0]; };
+    ASSERT_TRUE(Task::IsInline<decltype(small)>());
+    ASSERT_FALSE(Task::IsInline<decltype(big)>());
+
+    Task task(small), other(big);
+    task();
+    other();
+    ASSERT_EQ(2, counter);
+
+    // Moved task keeps the callable, source is empty
+    Task moved(std::move(other));
+    ASSERT_FALSE(other);
+    ASSERT_TRUE(moved);
+    moved();
+    task = std::move(moved);
+    task();
+    ASSERT_EQ(4, counter);
+
+    task.Reset();
+    ASSERT_FALSE(task);
+}
+
+TEST(TaskTest, MoveOnlyArguments) {
+    std::shared_ptr<int> owner = std::make_shared<int>(10);
+    std::weak_ptr<int> observer = owner;
+    int result = 0;
+
+    std::unique_ptr<std::shared_ptr<int>> moved_in(new std::shared_ptr<int>(std::move(owner)));
+    Task task = Task::Bind([&result](std::unique_ptr<std::shared_ptr<int>> &value) { result = **value; },
+                           std::move(moved_in));
+    task();
+    ASSERT_EQ(10, result);
+
+    // Arguments are destroyed with the task
+    ASSERT_FALSE(observer.expired());
+    task.Reset();
+    ASSERT_TRUE(observer.expired());
+}
+
+class _Handler {
+public:
+    _Handler() : last(0) {}
+    void Handle(int value) { last = value; }
+    int last;
+};
+
+TEST(TaskTest, MemberFunction) {
+    _Handler handler;
+    Task task = Task::Bind(&_Handler::Handle, &handler, 42);
+    task();
+    ASSERT_EQ(42, handler.last);
+}
+
+TEST(ThreadPoolTest, ExecuteDoesNotAllocate) {
+    ThreadPool pool;
+    pool.Start(2, 2, 1000);
+
+    _Handler handler;
+    std::atomic<int> counter(0);
+    auto task = [&counter, &handler](int value) {
+        handler.Handle(value);
+        counter++;
+    };
+    // The first round allocates queue nodes, the next one reuses them
+    for (int round = 0; round < 2; round++) {
+        count_allocations = (round == 1);
+        for (int i = 0; i < 100; i++) {
+            while (!pool.Execute(task, i)) {
+                std::this_thread::yield();
+            }
+        }
+        count_allocations = false;
+        while (counter.load() < 100 * (round + 1)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    pool.Stop(true);
+    ASSERT_EQ(0, allocations.load());
+}
+
+TEST(WorkStealingThreadPoolTest, ExecuteDoesNotAllocate) {
+    WorkStealingThreadPool pool;
+    pool.Start(2, 1024);
+
+    _Handler handler;
+    std::atomic<int> counter(0);
+    auto task = [&counter, &handler](int value) {
+        handler.Handle(value);
+        counter++;
+    };
+    // Nodes go back to the free list right after the task, so the first round leaves more of them then needed
+    const int rounds[] = {500, 100};
+    int total = 0;
+    for (int round = 0; round < 2; round++) {
+        count_allocations = (round == 1);
+        for (int i = 0; i < rounds[round]; i++) {
+            while (!pool.Execute(task, i)) {
+                std::this_thread::yield();
+            }
+        }
+        count_allocations = false;
+        total += rounds[round];
+        while (counter.load() < total) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    pool.Stop(true);
+    ASSERT_EQ(0, allocations.load());
+}
+
+TEST(FutureTest, ValueAndException) {
+    Promise<std::string> promise;
+    Future<std::string> future = promise.GetFuture();
+    ASSERT_TRUE(future.Valid());
+    ASSERT_FALSE(future.Ready());
+    promise.SetValue("value");
+    ASSERT_TRUE(future.Ready());
+    ASSERT_EQ("value", future.Get());
+    ASSERT_FALSE(future.Valid());
+
+    Promise<void> failing;
+    Future<void> failed = failing.GetFuture();
+    failing.SetException(std::make_exception_ptr(std::runtime_error("failed")));
+    ASSERT_THROW(failed.Get(), std::runtime_error);
+
+    // Promise destroyed without result breaks the future
+    Future<int> broken;
+    {
+        Promise<int> lost;
+        broken = lost.GetFuture();
+    }
+    ASSERT_THROW(broken.Get(), std::future_error);
+}
+
+TEST(FutureTest, ContinuationsChain) {
+    Promise<int> promise;
+    std::thread::id continuation_thread;
+    Future<std::string> chained = promise.GetFuture()
+                                      .Then([&continuation_thread](Future<int> ready) {
+                                          continuation_thread = std::this_thread::get_id();
+                                          return ready.Get() * 2;
+                                      })
+                                      .Then([](Future<int> ready) { return std::to_string(ready.Get()); });
+    ASSERT_FALSE(chained.Ready());
+
+    std::thread producer([&promise]() { promise.SetValue(21); });
+    std::thread::id producer_thread = producer.get_id();
+    producer.join();
+    ASSERT_EQ("42", chained.Get());
+    ASSERT_EQ(producer_thread, continuation_thread);
+
+    // Continuation attached to the ready future runs immediately, exceptions go down the chain
+    Promise<int> failing;
+    failing.SetException(std::make_exception_ptr(std::runtime_error("failed")));
+    bool called = false;
+    Future<void> result = failing.GetFuture().Then([&called](Future<int> ready) {
+        called = true;
+        ready.Get();
+    });
+    ASSERT_TRUE(called);
+    ASSERT_THROW(result.Get(), std::runtime_error);
+}
+
+TEST(ThreadPoolTest, SubmitReturnsResults) {
+    ThreadPool pool;
+    pool.Start(2, 4, 1000);
+
+    std::vector<Future<int>> results;
+    for (int i = 0; i < 100; i++) {
+        results.push_back(pool.Submit([](int value) { return value * value; }, i));
+    }
+    std::atomic<int> sum(0);
+    Future<void> last = pool.Submit([]() -> int { throw std::runtime_error("failed"); }).Then([&sum](Future<int> ready) {
+        try {
+            ready.Get();
+        } catch (std::runtime_error &) {
+            sum += 1;
+        }
+    });
+    last.Wait();
+
+    for (int i = 0; i < 100; i++) {
+        sum += results[i].Get();
+    }
+    ASSERT_EQ(1 + 99 * 100 * 199 / 6, sum.load());
+
+    // Rejected task breaks the promise
+    pool.Stop(true);
+    Future<int> rejected = pool.Submit([]() { return 1; });
+    ASSERT_THROW(rejected.Get(), std::future_error);
+}
+
+TEST(ThreadPoolTest, PriorityLanes) {
+    ThreadPool pool;
+    pool.Start(1, 1, 100);
+
+    std::atomic<bool> release(false);
+    std::atomic<bool> started(false);
+    ASSERT_TRUE(pool.Execute([&release, &started]() {
+        started = true;
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    }));
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+
+    // Only thread is busy, so tasks are taken by lanes once it is released
+    std::mutex lock;
+    std::string order;
+    auto record = [&lock, &order](char name) {
+        std::lock_guard<std::mutex> guard(lock);
+        order += name;
+    };
+    ASSERT_TRUE(pool.ExecuteWithPriority(ThreadPool::Priority::kLow, record, 'l'));
+    ASSERT_TRUE(pool.Execute(record, 'n'));
+    ASSERT_TRUE(pool.ExecuteWithPriority(ThreadPool::Priority::kHigh, record, 'h'));
+    ASSERT_TRUE(pool.ExecuteWithPriority(ThreadPool::Priority::kLow, record, 'L'));
+    ASSERT_TRUE(pool.ExecuteWithPriority(ThreadPool::Priority::kHigh, record, 'H'));
+
+    release = true;
+    pool.Stop(true);
+    ASSERT_EQ("hHnlL", order);
+}
+
+TEST(ThreadPoolTest, AdmissionControl) {
+    ThreadPool pool;
+    pool.SetAdmissionControl(std::chrono::milliseconds(1), std::chrono::milliseconds(5));
+    pool.Start(1, 1, 100);
+
+    std::atomic<bool> release(false);
+    std::atomic<int> started(0);
+    auto slow = [&release, &started]() {
+        started++;
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    };
+
+    // Tasks wait behind the blocked one far longer then target
+    ASSERT_TRUE(pool.Execute(slow));
+    while (started.load() == 0) {
+        std::this_thread::yield();
+    }
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(pool.Execute(slow));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    release = true;
+
+    // The first interval has the blocker taken right away, the next one has only long waits: lane is overloaded
+    // while it isn't drained
+    while (started.load() < 3) {
+        std::this_thread::yield();
+    }
+    ASSERT_FALSE(pool.Execute(slow));
+    ASSERT_TRUE(pool.ExecuteWithPriority(ThreadPool::Priority::kHigh, []() {}));
+
+    while (started.load() < 5) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_TRUE(pool.Execute([]() {}));
+    pool.Stop(true);
+}
+
+TEST(ThreadPoolTest, AdmissionControlAllThreadsBusy) {
+    ThreadPool pool;
+    pool.SetAdmissionControl(std::chrono::milliseconds(1), std::chrono::milliseconds(5));
+    pool.Start(1, 1, 100);
+
+    std::atomic<bool> release(false);
+    std::atomic<int> started(0);
+    auto blocker = [&release, &started]() {
+        started++;
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    };
+
+    // Nothing is taken from the queue while the only thread is blocked, still the queue stops growing
+    ASSERT_TRUE(pool.Execute(blocker));
+    while (started.load() == 0) {
+        std::this_thread::yield();
+    }
+    ASSERT_TRUE(pool.Execute([]() {}));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_FALSE(pool.Execute([]() {}));
+    ASSERT_TRUE(pool.ExecuteWithPriority(ThreadPool::Priority::kHigh, []() {}));
+    ASSERT_EQ(2, pool.GetMetrics().queue_depth);
+
+    release = true;
+    while (pool.GetMetrics().queue_depth != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_TRUE(pool.Execute([]() {}));
+    pool.Stop(true);
+}
+
+TEST(ThreadPoolTest, AdaptiveSizing) {
+    ThreadPool::SizingPolicy policy;
+    policy.period = std::chrono::milliseconds(10);
+    policy.shrink_periods = 5;
+
+    ThreadPool pool;
+    pool.SetAdaptiveSizing(policy);
+    pool.Start(0, 8, 1000);
+
+    // Tasks wait for the single thread far longer then grow_wait
+    std::atomic<int> done(0);
+    for (int i = 0; i < 200; i++) {
+        ASSERT_TRUE(pool.Execute([&done]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            done++;
+        }));
+    }
+    size_t max_threads = 0;
+    while (done.load() < 200) {
+        max_threads = std::max(max_threads, pool.GetMetrics().threads);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_GT(max_threads, 1);
+    ASSERT_LE(max_threads, 8);
+
+    // Idle pool shrinks back
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (pool.GetMetrics().threads > 1 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_EQ(1, pool.GetMetrics().threads);
+
+    ThreadPool::Metrics metrics = pool.GetMetrics();
+    ASSERT_EQ(200, metrics.executed);
+    ASSERT_EQ(0, metrics.rejected);
+    ASSERT_EQ(0, metrics.queue_depth);
+    ASSERT_LE(metrics.wait_p50, metrics.wait_p90);
+    ASSERT_LE(metrics.wait_p90, metrics.wait_p99);
+    ASSERT_GT(metrics.wait_p99.count(), 1000);
+
+    std::map<std::string, std::string> stats;
+    metrics.Append(stats, "pool_");
+    ASSERT_EQ("200", stats["pool_executed"]);
+    pool.Stop(true);
+}
@@ -0,0 +1,324 @@
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cxxopts.hpp>
+
+#include <afina/coroutine/Channel.h>
+#include <afina/coroutine/Engine.h>
+
+/**
+ * # Coroutine engine benchmark
+ * Measures switch latency, create/destroy cost, ping-pong throughput and memory taken by a suspended coroutine
+ * for each stack mode. Every measurement runs on top of the given amount of live stack: copy mode saves and
+ * restores it on each switch, so its costs depend on the depth, while separate mode should stay flat
+ */
+
+using namespace Afina;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Engine = Coroutine::Engine;
+
+// Approximate stack taken by one Deep() frame
+const size_t frame_size = 1024;
+
+struct Bench {
+    Engine *engine = nullptr;
+    size_t depth = 0;
+    size_t iterations = 0;
+    size_t coroutines = 0;
+
+    Clock::time_point start;
+    Clock::duration elapsed = Clock::duration::zero();
+
+    // Ping-pong in copy mode: routines pass control to each other directly
+    void *ping = nullptr;
+    void *pong = nullptr;
+    size_t ball = 0;
+
+    // Ping-pong in separate mode goes through channels
+    std::unique_ptr<Coroutine::Channel<size_t>> requests;
+    std::unique_ptr<Coroutine::Channel<size_t>> responses;
+
+    void *main = nullptr;
+    size_t suspended = 0;
+    size_t rss_before = 0;
+    size_t rss_after = 0;
+    bool finished = false;
+};
+
+// Puts about depth * frame_size bytes of frames on the stack and calls body on top of them
+__attribute__((noinline)) void Deep(size_t depth, const std::function<void()> &body) {
+    if (depth == 0) {
+        body();
+        return;
+    }
+
+    volatile char frame[frame_size];
+    frame[0] = char(depth);
+    Deep(depth - 1, body);
+    frame[frame_size - 1] = frame[0]; // frame is alive during the call, so it isn't optimized out
+}
+
+size_t CurrentRSS() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) {
+            return std::stoull(line.substr(6)) * 1024;
+        }
+    }
+    return 0;
+}
+
+// Switch: two routines yield to each other
+void Switcher(Bench &bench) {
+    Deep(bench.depth, [&bench]() {
+        for (size_t i = 0; i < bench.iterations; i++) {
+            bench.engine->yield();
+        }
+    });
+    bench.elapsed = Clock::now() - bench.start;
+}
+
+void SwitchMain(Bench &bench) {
+    bench.engine->run(Switcher, bench);
+    bench.engine->run(Switcher, bench);
+    bench.start = Clock::now();
+}
+
+// Create/destroy: routine is created, runs to the end and gets back to the creator
+void Noop() {}
+
+void CreateMain(Bench &bench) {
+    Deep(bench.depth, [&bench]() {
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < bench.iterations; i++) {
+            bench.engine->run(Noop);
+            bench.engine->yield();
+        }
+        bench.elapsed = Clock::now() - start;
+    });
+}
+
+// Ping-pong in copy mode: the ball is passed by explicit switch
+void DirectPing(Bench &bench) {
+    Deep(bench.depth, [&bench]() {
+        for (size_t i = 0; i < bench.iterations; i++) {
+            bench.ball++;
+            bench.engine->sched(bench.pong);
+        }
+    });
+    bench.finished = true;
+    bench.elapsed = Clock::now() - bench.start;
+}
+
+void DirectPong(Bench &bench) {
+    Deep(bench.depth, [&bench]() {
+        while (!bench.finished) {
+            bench.ball++;
+            bench.engine->sched(bench.ping);
+        }
+    });
+}
+
+void DirectMain(Bench &bench) {
+    bench.ping = bench.engine->run(DirectPing, bench);
+    bench.pong = bench.engine->run(DirectPong, bench);
+    bench.start = Clock::now();
+}
+
+// Ping-pong in separate mode: request and response go through channels, as it would be between two routines
+// which don't know about each other
+void ChannelPing(Bench &bench) {
+    Deep(bench.depth, [&bench]() {
+        size_t value = 0;
+        for (size_t i = 0; i < bench.iterations; i++) {
+            bench.requests->send(i);
+            bench.responses->receive(value);
+        }
+    });
+    bench.requests->close();
+    bench.elapsed = Clock::now() - bench.start;
+}
+
+void ChannelPong(Bench &bench) {
+    Deep(bench.depth, [&bench]() {
+        size_t value = 0;
+        while (bench.requests->receive(value)) {
+            bench.responses->send(value);
+        }
+    });
+}
+
+void ChannelMain(Bench &bench) {
+    bench.requests.reset(new Coroutine::Channel<size_t>(1));
+    bench.responses.reset(new Coroutine::Channel<size_t>(1));
+    bench.engine->run(ChannelPing, bench);
+    bench.engine->run(ChannelPong, bench);
+    bench.start = Clock::now();
+}
+
+// Memory: routines are suspended at the given depth and the main one looks at RSS
+void Suspended(Bench &bench) {
+    Deep(bench.depth, [&bench]() {
+        bench.suspended++;
+        while (!bench.finished) {
+            bench.engine->sched(bench.main);
+        }
+    });
+}
+
+void MemoryMain(Bench &bench) {
+    bench.main = bench.engine->current_routine();
+    bench.rss_before = CurrentRSS();
+
+    std::vector<void *> routines;
+    for (size_t i = 0; i < bench.coroutines; i++) {
+        routines.push_back(bench.engine->run(Suspended, bench));
+    }
+    for (void *routine : routines) {
+        bench.engine->sched(routine);
+    }
+
+    bench.rss_after = CurrentRSS();
+    bench.finished = true;
+}
+
+struct Result {
+    double switch_ns = 0;
+    double create_ns = 0;
+    double roundtrips_per_sec = 0;
+    double bytes_per_coroutine = 0;
+};
+
+double NanosecondsPer(Clock::duration elapsed, size_t count) {
+    return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+}
+
+// Every measurement gets a new engine, so stacks pooled by the previous one don't hide memory of the next
+void Measure(Bench &bench, Engine::StackMode mode, size_t stack_size, void (*main)(Bench &)) {
+    Engine engine(mode, stack_size);
+    bench.engine = &engine;
+    engine.start(main, bench);
+    bench.engine = nullptr;
+}
+
+// Timed measurements are preceded by a short run, so the first one doesn't pay for cold caches and CPU frequency
+Clock::duration MeasureTime(Engine::StackMode mode, size_t stack_size, void (*main)(Bench &), size_t depth,
+                            size_t iterations) {
+    Bench warmup;
+    warmup.depth = depth;
+    warmup.iterations = iterations / 10 + 1;
+    Measure(warmup, mode, stack_size, main);
+
+    Bench bench;
+    bench.depth = depth;
+    bench.iterations = iterations;
+    Measure(bench, mode, stack_size, main);
+    return bench.elapsed;
+}
+
+Result Run(Engine::StackMode mode, size_t stack_size, size_t depth, size_t iterations, size_t coroutines) {
+    Result result;
+    result.switch_ns = NanosecondsPer(MeasureTime(mode, stack_size, SwitchMain, depth, iterations), 2 * iterations);
+    result.create_ns = NanosecondsPer(MeasureTime(mode, stack_size, CreateMain, depth, iterations), iterations);
+
+    void (*pingpong_main)(Bench &) = (mode == Engine::StackMode::Copy) ? DirectMain : ChannelMain;
+    Clock::duration pingpong = MeasureTime(mode, stack_size, pingpong_main, depth, iterations);
+    result.roundtrips_per_sec = iterations / std::chrono::duration<double>(pingpong).count();
+
+    Bench bench;
+    bench.depth = depth;
+    bench.coroutines = coroutines;
+    Measure(bench, mode, stack_size, MemoryMain);
+    size_t grown = (bench.rss_after > bench.rss_before) ? bench.rss_after - bench.rss_before : 0;
+    result.bytes_per_coroutine = double(grown) / coroutines;
+    return result;
+}
+
+std::vector<std::string> Split(const std::string &list) {
+    std::vector<std::string> result;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            result.push_back(item);
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    cxxopts::Options options("runCoroutineBench", "Switch, creation, ping-pong and memory costs of coroutines");
+    options.add_options()("m,modes", "Stack modes: copy, separate",
+                          cxxopts::value<std::string>()->default_value("copy,separate"));
+    options.add_options()("d,depths", "Live stack under each measurement, KB",
+                          cxxopts::value<std::string>()->default_value("0,1,4,16,64"));
+    options.add_options()("i,iterations", "Switches, creations and round trips to measure",
+                          cxxopts::value<size_t>()->default_value("100000"));
+    options.add_options()("c,coroutines", "Suspended coroutines to measure memory on",
+                          cxxopts::value<size_t>()->default_value("1000"));
+    options.add_options()("stack-size", "Stack size in separate mode, KB",
+                          cxxopts::value<size_t>()->default_value(std::to_string(Engine::default_stack_size / 1024)));
+    options.add_options()("h,help", "Print usage info");
+
+    try {
+        options.parse(argc, argv);
+        if (options.count("help") > 0) {
+            std::cerr << options.help() << std::endl;
+            return 0;
+        }
+
+        size_t iterations = options["iterations"].as<size_t>();
+        size_t coroutines = options["coroutines"].as<size_t>();
+        size_t stack_size = options["stack-size"].as<size_t>() * 1024;
+
+        std::cout << std::left << std::setw(10) << "mode" << std::right << std::setw(10) << "depth_kb"
+                  << std::setw(12) << "switch_ns" << std::setw(12) << "create_ns" << std::setw(16)
+                  << "roundtrips/sec" << std::setw(16) << "bytes/coroutine" << std::endl;
+
+        for (const std::string &mode_name : Split(options["modes"].as<std::string>())) {
+            Engine::StackMode mode;
+            if (mode_name == "copy") {
+                mode = Engine::StackMode::Copy;
+            } else if (mode_name == "separate") {
+                mode = Engine::StackMode::Separate;
+            } else {
+                throw std::invalid_argument("Unknown mode: " + mode_name);
+            }
+
+            for (const std::string &depth_name : Split(options["depths"].as<std::string>())) {
+                size_t depth = std::stoull(depth_name) * 1024 / frame_size;
+
+                // Frames are a bit bigger than frame_size, a half of the stack is left for them and the engine
+                if (mode == Engine::StackMode::Separate && 2 * depth * frame_size > stack_size) {
+                    std::cout << std::left << std::setw(10) << mode_name << std::right << std::setw(10)
+                              << depth_name << "  doesn't fit into stack, see --stack-size" << std::endl;
+                    continue;
+                }
+
+                Result r = Run(mode, stack_size, depth, iterations, coroutines);
+                std::cout << std::left << std::setw(10) << mode_name << std::right << std::setw(10) << depth_name
+                          << std::fixed << std::setprecision(1) << std::setw(12) << r.switch_ns << std::setw(12)
+                          << r.create_ns << std::setprecision(0) << std::setw(16) << r.roundtrips_per_sec
+                          << std::setw(16) << r.bytes_per_coroutine << std::endl;
+            }
+        }
+    } catch (std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,9 +1,24 @@
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <thread>
+#include <vector>
 
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <afina/coroutine/Channel.h>
 #include <afina/coroutine/Engine.h>
+#include <afina/coroutine/Scheduler.h>
+#include <afina/coroutine/StackPool.h>
+#include <afina/coroutine/Sync.h>
 
 void _calculator_add(int &result, int left, int right) { result = left + right; }
 
@@ -69,3 +84,500 @@ TEST(CoroutineTest, Printer) {
     engine.start(_printer, engine, result);
     ASSERT_STREQ("A1 B1 A2 B2 A3 B3 END", result.c_str());
 }
+
+TEST(CoroutineTest, SeparateStackSimpleStart) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate);
+
+    int result = -1;
+    engine.start(_calculator_add, result, 1, 2);
+
+    ASSERT_EQ(3, result);
+}
+
+TEST(CoroutineTest, SeparateStackPrinter) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate);
+
+    out.str("");
+    std::string result;
+    engine.start(_printer, engine, result);
+    ASSERT_STREQ("A1 B1 A2 B2 A3 B3 END", result.c_str());
+}
+
+void _counter(Afina::Coroutine::Engine &pe, int &counter, std::string name) {
+    for (int i = 0; i < 100; i++) {
+        counter++;
+        pe.yield();
+    }
+    ASSERT_EQ("worker", name); // value arguments are kept alive until the coroutine ends
+}
+
+void _spawner(Afina::Coroutine::Engine &pe, int &counter) {
+    for (int i = 0; i < 1000; i++) {
+        pe.run(_counter, pe, counter, std::string("worker"));
+    }
+}
+
+TEST(CoroutineTest, SeparateStackManyCoroutines) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate, 16 * 1024);
+
+    int counter = 0;
+    engine.start(_spawner, engine, counter);
+    ASSERT_EQ(100 * 1000, counter);
+}
+
+TEST(CoroutineTest, SeparateStackYieldAlone) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate);
+
+    int counter = 0;
+    engine.start(_counter, engine, counter, std::string("worker"));
+    ASSERT_EQ(100, counter);
+}
+
+void _noop(int &counter) { counter++; }
+
+void _churner(Afina::Coroutine::Engine &pe, int &counter) {
+    for (int i = 0; i < 10000; i++) {
+        pe.run(_noop, counter);
+        pe.yield(); // let new coroutine finish, so its stack goes back to the pool
+    }
+}
+
+TEST(CoroutineTest, SeparateStackPoolReuse) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate, 32 * 1024);
+
+    int counter = 0;
+    engine.start(_churner, engine, counter);
+    ASSERT_EQ(10000, counter);
+
+    // Each coroutine finished before the next one was created: stacks were recycled, not mapped again
+    ASSERT_LE(engine.stack_pool().Mapped(), 3);
+    ASSERT_EQ(engine.stack_pool().Mapped(), engine.stack_pool().Idle());
+}
+
+TEST(CoroutineTest, StackPoolDiscardsColdStacksOnce) {
+    Afina::Coroutine::StackPool pool(16 * 1024, 2);
+    std::vector<char *> stacks;
+    for (int i = 0; i < 4; i++) {
+        stacks.push_back(pool.Acquire());
+    }
+    for (char *stack : stacks) {
+        pool.Release(stack);
+    }
+    ASSERT_EQ(2, pool.Discarded());
+
+    // Hot stack goes back and forth, cold ones are not touched again
+    for (int i = 0; i < 10; i++) {
+        pool.Release(pool.Acquire());
+        ASSERT_EQ(2, pool.Discarded());
+    }
+
+    // Cold stack taken back is discarded again once it leaves the hot part
+    char *hot[3] = {pool.Acquire(), pool.Acquire(), pool.Acquire()};
+    ASSERT_EQ(1, pool.Discarded());
+    for (char *stack : hot) {
+        pool.Release(stack);
+    }
+    ASSERT_EQ(2, pool.Discarded());
+    ASSERT_EQ(4, pool.Idle());
+}
+
+void _pipe_reader(Afina::Coroutine::Engine &pe, int &fd, std::string &result) {
+    char buffer[16];
+    while (true) {
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        if (count > 0) {
+            result.append(buffer, count);
+        } else if (count == 0) {
+            return;
+        } else {
+            ASSERT_EQ(EAGAIN, errno);
+            ASSERT_NE(0, pe.wait_fd(fd, EPOLLIN) & (EPOLLIN | EPOLLHUP));
+        }
+    }
+}
+
+void _pipe_writer(Afina::Coroutine::Engine &pe, int &fd) {
+    for (const char *part : {"ab", "cd", "ef"}) {
+        ASSERT_EQ(2, write(fd, part, 2));
+        for (int i = 0; i < 100; i++) {
+            pe.yield(); // blocked reader gets data while writer is still busy
+        }
+    }
+    close(fd);
+}
+
+void _pipe_main(Afina::Coroutine::Engine &pe, int &read_fd, int &write_fd, std::string &result) {
+    pe.run(_pipe_reader, pe, read_fd, result);
+    pe.run(_pipe_writer, pe, write_fd);
+}
+
+TEST(CoroutineTest, SeparateStackWaitFd) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate);
+
+    int fds[2];
+    ASSERT_EQ(0, pipe2(fds, O_NONBLOCK));
+
+    std::string result;
+    engine.start(_pipe_main, engine, fds[0], fds[1], result);
+    close(fds[0]);
+    ASSERT_EQ("abcdef", result);
+}
+
+void _interrupted_waiter(Afina::Coroutine::Engine &pe, int &fd, int &result) { result = pe.wait_fd(fd, EPOLLIN); }
+
+void _interrupter(Afina::Coroutine::Engine &pe, int &fd, int &result) {
+    pe.run(_interrupted_waiter, pe, fd, result);
+    pe.yield();
+    pe.interrupt();
+}
+
+TEST(CoroutineTest, SeparateStackWaitInterrupt) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate);
+
+    int fds[2];
+    ASSERT_EQ(0, pipe2(fds, O_NONBLOCK));
+
+    int result = -1;
+    engine.start(_interrupter, engine, fds[0], result);
+    close(fds[0]);
+    close(fds[1]);
+    ASSERT_EQ(0, result);
+}
+
+void _sleeper(Afina::Coroutine::Engine &pe, std::string &result, int &milliseconds, char &name) {
+    pe.sleep_for(std::chrono::milliseconds(milliseconds));
+    result += name;
+}
+
+void _sleepers_main(Afina::Coroutine::Engine &pe, std::string &result, std::vector<int> &delays, std::string &names) {
+    for (size_t i = 0; i < delays.size(); i++) {
+        pe.run(_sleeper, pe, result, delays[i], names[i]);
+    }
+}
+
+TEST(CoroutineTest, SeparateStackSleep) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate);
+
+    std::string result;
+    std::vector<int> delays = {30, 10, 0, 20};
+    std::string names = "dbac";
+    auto begin = std::chrono::steady_clock::now();
+    engine.start(_sleepers_main, engine, result, delays, names);
+    ASSERT_EQ("abcd", result);
+    ASSERT_GE(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(30));
+}
+
+void _timed_reader(Afina::Coroutine::Engine &pe, int &read_fd, int &write_fd, std::vector<uint32_t> &results) {
+    auto begin = std::chrono::steady_clock::now();
+    results.push_back(pe.wait_fd(read_fd, EPOLLIN, std::chrono::milliseconds(20)));
+    results.push_back(std::chrono::steady_clock::now() - begin >= std::chrono::milliseconds(20));
+
+    // Registration is removed on timeout, the next wait registers descriptor again
+    ASSERT_EQ(1, write(write_fd, "x", 1));
+    results.push_back(pe.wait_fd(read_fd, EPOLLIN, std::chrono::seconds(10)));
+}
+
+TEST(CoroutineTest, SeparateStackWaitFdTimeout) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate);
+
+    int fds[2];
+    ASSERT_EQ(0, pipe2(fds, O_NONBLOCK));
+
+    std::vector<uint32_t> results;
+    auto begin = std::chrono::steady_clock::now();
+    engine.start(_timed_reader, engine, fds[0], fds[1], results);
+    close(fds[0]);
+    close(fds[1]);
+    ASSERT_EQ(std::vector<uint32_t>({0, 1, EPOLLIN}), results);
+    ASSERT_LT(std::chrono::steady_clock::now() - begin, std::chrono::seconds(5));
+}
+
+void _long_sleeper(Afina::Coroutine::Engine &pe, int &result) {
+    pe.sleep_for(std::chrono::hours(1));
+    result = 1;
+}
+
+void _sleep_interrupter(Afina::Coroutine::Engine &pe, int &result) {
+    pe.run(_long_sleeper, pe, result);
+    pe.yield();
+    pe.interrupt();
+}
+
+TEST(CoroutineTest, SeparateStackSleepInterrupt) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate);
+
+    int result = 0;
+    engine.start(_sleep_interrupter, engine, result);
+    ASSERT_EQ(1, result);
+}
+
+struct _SchedulerState {
+    std::atomic<int> counter{0};
+    std::mutex lock;
+    std::set<std::thread::id> threads;
+};
+
+void _scheduled_counter(Afina::Coroutine::Engine &pe, _SchedulerState &state) {
+    for (int i = 0; i < 100; i++) {
+        state.counter++;
+        {
+            std::lock_guard<std::mutex> guard(state.lock);
+            state.threads.insert(std::this_thread::get_id());
+        }
+        pe.yield(); // could continue on another thread
+    }
+}
+
+void _scheduled_spawner(Afina::Coroutine::Engine &pe, _SchedulerState &state) {
+    // All coroutines are created on one engine, others have to steal them
+    for (int i = 0; i < 1000; i++) {
+        pe.run(_scheduled_counter, pe, state);
+    }
+}
+
+TEST(CoroutineTest, SchedulerWorkStealing) {
+    Afina::Coroutine::Scheduler scheduler(4, 32 * 1024);
+
+    _SchedulerState state;
+    scheduler.start(_scheduled_spawner, scheduler.engine(0), state);
+    ASSERT_EQ(100 * 1000, state.counter.load());
+    ASSERT_GT(state.threads.size(), 1);
+}
+
+TEST(CoroutineTest, SchedulerWaitFd) {
+    Afina::Coroutine::Scheduler scheduler(2);
+
+    int fds[2];
+    ASSERT_EQ(0, pipe2(fds, O_NONBLOCK));
+
+    // Reader and writer could run on different threads
+    std::string result;
+    scheduler.start(_pipe_main, scheduler.engine(0), fds[0], fds[1], result);
+    close(fds[0]);
+    ASSERT_EQ("abcdef", result);
+}
+
+void _scheduled_sleeper(Afina::Coroutine::Engine &pe, _SchedulerState &state) {
+    for (int i = 0; i < 5; i++) {
+        pe.sleep_for(std::chrono::milliseconds(1));
+        state.counter++;
+    }
+}
+
+void _scheduled_sleepers(Afina::Coroutine::Engine &pe, _SchedulerState &state) {
+    for (int i = 0; i < 100; i++) {
+        pe.run(_scheduled_sleeper, pe, state);
+    }
+}
+
+TEST(CoroutineTest, SchedulerSleep) {
+    Afina::Coroutine::Scheduler scheduler(4);
+
+    _SchedulerState state;
+    scheduler.start(_scheduled_sleepers, scheduler.engine(0), state);
+    ASSERT_EQ(500, state.counter.load());
+}
+
+struct _MutexState {
+    Afina::Coroutine::Mutex mutex;
+    int counter = 0;
+};
+
+void _mutex_incrementer(Afina::Coroutine::Engine &pe, _MutexState &state) {
+    for (int i = 0; i < 100; i++) {
+        std::lock_guard<Afina::Coroutine::Mutex> guard(state.mutex);
+        int value = state.counter;
+        pe.yield(); // others are parked on the mutex meanwhile
+        state.counter = value + 1;
+    }
+}
+
+void _mutex_spawner(Afina::Coroutine::Engine &pe, _MutexState &state) {
+    for (int i = 0; i < 100; i++) {
+        pe.run(_mutex_incrementer, pe, state);
+    }
+}
+
+TEST(CoroutineTest, SchedulerMutex) {
+    Afina::Coroutine::Scheduler scheduler(4, 32 * 1024);
+
+    _MutexState state;
+    scheduler.start(_mutex_spawner, scheduler.engine(0), state);
+    ASSERT_EQ(100 * 100, state.counter);
+}
+
+struct _ConditionState {
+    Afina::Coroutine::Mutex mutex;
+    Afina::Coroutine::ConditionVariable condition;
+    int stage = 0;
+    std::string log;
+};
+
+void _condition_waiter(Afina::Coroutine::Engine & /* pe */, _ConditionState &state) {
+    std::lock_guard<Afina::Coroutine::Mutex> guard(state.mutex);
+    state.condition.wait(state.mutex, [&state] { return state.stage == 1; });
+    state.log += "W";
+}
+
+void _condition_main(Afina::Coroutine::Engine &pe, _ConditionState &state) {
+    pe.run(_condition_waiter, pe, state);
+    pe.run(_condition_waiter, pe, state);
+    pe.yield();
+    pe.yield();
+
+    std::lock_guard<Afina::Coroutine::Mutex> guard(state.mutex);
+    state.log += "N";
+    state.stage = 1;
+    state.condition.notify_all();
+}
+
+TEST(CoroutineTest, SeparateStackConditionVariable) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate);
+
+    _ConditionState state;
+    engine.start(_condition_main, engine, state);
+    ASSERT_EQ("NWW", state.log);
+}
+
+struct _SemaphoreState {
+    Afina::Coroutine::Semaphore semaphore{3};
+    std::atomic<int> active{0};
+    std::atomic<int> max_active{0};
+    std::atomic<int> done{0};
+};
+
+void _semaphore_user(Afina::Coroutine::Engine &pe, _SemaphoreState &state) {
+    state.semaphore.acquire();
+    int active = ++state.active;
+    int max_active = state.max_active.load();
+    while (active > max_active && !state.max_active.compare_exchange_weak(max_active, active)) {
+    }
+    for (int i = 0; i < 10; i++) {
+        pe.yield();
+    }
+    state.active--;
+    state.done++;
+    state.semaphore.release();
+}
+
+void _semaphore_spawner(Afina::Coroutine::Engine &pe, _SemaphoreState &state) {
+    for (int i = 0; i < 50; i++) {
+        pe.run(_semaphore_user, pe, state);
+    }
+}
+
+TEST(CoroutineTest, SchedulerSemaphore) {
+    Afina::Coroutine::Scheduler scheduler(4, 32 * 1024);
+
+    _SemaphoreState state;
+    scheduler.start(_semaphore_spawner, scheduler.engine(0), state);
+    ASSERT_EQ(50, state.done.load());
+    ASSERT_LE(state.max_active.load(), 3);
+}
+
+void _waiting_for_thread(Afina::Coroutine::Engine & /* pe */, Afina::Coroutine::Semaphore &semaphore, int &result) {
+    semaphore.acquire();
+    result = 1;
+}
+
+TEST(CoroutineTest, SeparateStackUnparkFromThread) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate);
+
+    // Engine has nothing to run, but doesn't stop while routine is parked
+    Afina::Coroutine::Semaphore semaphore;
+    std::thread releaser([&semaphore] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        semaphore.release();
+    });
+
+    int result = 0;
+    engine.start(_waiting_for_thread, engine, semaphore, result);
+    releaser.join();
+    ASSERT_EQ(1, result);
+}
+
+void _ping_pong(Afina::Coroutine::Engine & /* pe */, Afina::Coroutine::Semaphore &give,
+                Afina::Coroutine::Semaphore &take, int &rounds) {
+    for (int i = 0; i < rounds; i++) {
+        give.release();
+        take.acquire();
+    }
+}
+
+// Routines park on one engine and are unparked by routines of another one. Engine must not go to sleep when its
+// last routine is done while the remote unpark hasn't finished yet, nothing would wake it up then
+TEST(CoroutineTest, SeparateStackUnparkFromOtherEngine) {
+    for (int attempt = 0; attempt < 200; attempt++) {
+        Afina::Coroutine::Semaphore first, second;
+        int rounds = 50;
+        std::thread other([&first, &second, &rounds] {
+            Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate);
+            engine.start(_ping_pong, engine, second, first, rounds);
+        });
+
+        Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate);
+        engine.start(_ping_pong, engine, first, second, rounds);
+        other.join();
+    }
+}
+
+typedef Afina::Coroutine::Channel<int> _IntChannel;
+
+struct _ChannelState {
+    _IntChannel channel{4};
+    std::atomic<long> sum{0};
+    std::atomic<int> received{0};
+    std::atomic<int> producers{0};
+};
+
+void _channel_producer(Afina::Coroutine::Engine & /* pe */, _ChannelState &state, int &from) {
+    for (int i = from; i < from + 1000; i++) {
+        ASSERT_TRUE(state.channel.send(i));
+    }
+    if (--state.producers == 0) {
+        state.channel.close();
+    }
+}
+
+void _channel_consumer(Afina::Coroutine::Engine & /* pe */, _ChannelState &state) {
+    int value;
+    while (state.channel.receive(value)) {
+        state.sum += value;
+        state.received++;
+    }
+}
+
+void _channel_main(Afina::Coroutine::Engine &pe, _ChannelState &state, std::vector<int> &starts, int &consumers) {
+    state.producers = starts.size();
+    for (int &from : starts) {
+        pe.run(_channel_producer, pe, state, from);
+    }
+    for (int i = 0; i < consumers; i++) {
+        pe.run(_channel_consumer, pe, state);
+    }
+}
+
+TEST(CoroutineTest, SeparateStackChannel) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::StackMode::Separate);
+
+    _ChannelState state;
+    std::vector<int> starts = {0};
+    int consumers = 1;
+    engine.start(_channel_main, engine, state, starts, consumers);
+    ASSERT_EQ(1000, state.received.load());
+    ASSERT_EQ(999 * 1000 / 2, state.sum.load());
+}
+
+TEST(CoroutineTest, SchedulerChannelManyToMany) {
+    Afina::Coroutine::Scheduler scheduler(4, 32 * 1024);
+
+    _ChannelState state;
+    std::vector<int> starts = {0, 1000, 2000, 3000};
+    int consumers = 4;
+    scheduler.start(_channel_main, scheduler.engine(0), state, starts, consumers);
+    ASSERT_EQ(4000, state.received.load());
+    ASSERT_EQ(3999 * 4000 / 2, state.sum.load());
+
+    int value = 0;
+    ASSERT_FALSE(state.channel.try_send(value)); // closed
+}
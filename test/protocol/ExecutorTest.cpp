@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include <protocol/Executor.h>
+#include <protocol/InputBuffer.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina;
+
+namespace {
+
+// Writes data through the free space of the input buffer in portions of the given size, as a socket would
+bool Receive(Protocol::Executor &executor, const std::string &data, size_t portion) {
+    bool was_output = false;
+    size_t offset = 0;
+    while (offset < data.size()) {
+        size_t size = 0;
+        char *space = executor.GetInputSpace(size);
+        size_t received = std::min(std::min(portion, size), data.size() - offset);
+        std::memcpy(space, data.data() + offset, received);
+        was_output |= executor.CommitAndTryExecute(received);
+        offset += received;
+    }
+    return was_output;
+}
+
+} // namespace
+
+TEST(InputBufferTest, ConsumedSpaceIsReused) {
+    Protocol::InputBuffer buffer(16);
+    buffer.Append("0123456789", 10);
+    buffer.Consume(8);
+    ASSERT_EQ("89", std::string(buffer.Data(), buffer.Size()));
+
+    // Tail is shorter than a quarter of capacity, the rest is moved to the beginning
+    size_t size = 0;
+    char *space = buffer.Space(size, 10);
+    ASSERT_EQ(14, size);
+    ASSERT_EQ("89", std::string(buffer.Data(), buffer.Size()));
+    std::memcpy(space, "ab", 2);
+    buffer.Commit(2);
+    ASSERT_EQ("89ab", std::string(buffer.Data(), buffer.Size()));
+
+    buffer.Consume(4);
+    ASSERT_EQ(0, buffer.Size());
+    buffer.Space(size);
+    ASSERT_EQ(16, size);
+}
+
+TEST(InputBufferTest, GrowsForLongCommand) {
+    Protocol::InputBuffer buffer(16);
+    std::string data(100, 'x');
+    buffer.Append(data.data(), data.size());
+    ASSERT_EQ(data, std::string(buffer.Data(), buffer.Size()));
+    ASSERT_LE(100, buffer.Capacity());
+
+    // Once the long command is consumed buffer returns to the initial capacity
+    buffer.Consume(99);
+    ASSERT_LE(100, buffer.Capacity());
+    buffer.Consume(1);
+    ASSERT_EQ(16, buffer.Capacity());
+
+    size_t size = 0;
+    buffer.Space(size);
+    ASSERT_EQ(16, size);
+}
+
+TEST(InputBufferTest, GrowsForFullReadsOnly) {
+    Protocol::InputBuffer buffer(64, 16);
+    size_t size = 0;
+    char *space = buffer.Space(size);
+    ASSERT_EQ(16, size);
+
+    // Read filled the buffer but all of it is consumed: no need for more memory
+    std::memcpy(space, "0123456789abcdef", 16);
+    buffer.Commit(16);
+    buffer.Consume(16);
+    buffer.Space(size);
+    ASSERT_EQ(16, size);
+
+    // Read filled the buffer and left a partial command: next read gets full capacity
+    space = buffer.Space(size);
+    std::memcpy(space, "0123456789abcdef", 16);
+    buffer.Commit(16);
+    buffer.Consume(10);
+    buffer.Space(size);
+    ASSERT_EQ(64, buffer.Capacity());
+    ASSERT_EQ(58, size);
+    ASSERT_EQ("abcdef", std::string(buffer.Data(), buffer.Size()));
+
+    // Drained buffer goes back to the idle capacity
+    buffer.Consume(6);
+    ASSERT_EQ(16, buffer.Capacity());
+    buffer.Space(size);
+    ASSERT_EQ(16, size);
+}
+
+TEST(ExecutorTest, BinaryValueSplitByBytes) {
+    std::shared_ptr<Storage> storage = std::make_shared<Backend::MapBasedGlobalLockImpl>();
+    Protocol::Executor executor(storage);
+
+    std::string value("a\0b\r\nc", 6);
+    ASSERT_TRUE(Receive(executor, "set foo 0 0 6\r\n" + value + "\r\nget foo\r\n", 1));
+    ASSERT_EQ("STORED\r\nVALUE foo 0 6\r\n" + value + "\r\nEND\r\n", executor.GetWholeOutputAsString(true));
+}
+
+TEST(ExecutorTest, ValueLongerThanBuffer) {
+    std::shared_ptr<Storage> storage = std::make_shared<Backend::MapBasedGlobalLockImpl>();
+    Protocol::Executor executor(storage);
+
+    std::string value(3 * Protocol::InputBuffer::default_capacity, 'v');
+    std::string input = "set big 0 0 " + std::to_string(value.size()) + "\r\n" + value + "\r\nget big\r\n";
+    ASSERT_TRUE(Receive(executor, input, 4096));
+    ASSERT_EQ("STORED\r\nVALUE big 0 " + std::to_string(value.size()) + "\r\n" + value + "\r\nEND\r\n",
+              executor.GetWholeOutputAsString(true));
+}
+
+TEST(ExecutorTest, PipelinedCommands) {
+    std::shared_ptr<Storage> storage = std::make_shared<Backend::MapBasedGlobalLockImpl>();
+    Protocol::Executor executor(storage);
+
+    std::string input, output;
+    for (int i = 0; i < 1000; i++) {
+        std::string key = "k" + std::to_string(i);
+        input += "set " + key + " 0 0 1\r\n" + std::to_string(i % 10) + "\r\nget " + key + "\r\n";
+        output += "STORED\r\nVALUE " + key + " 0 1\r\n" + std::to_string(i % 10) + "\r\nEND\r\n";
+    }
+    ASSERT_TRUE(Receive(executor, input, 1000));
+    ASSERT_EQ(output, executor.GetWholeOutputAsString(true));
+}
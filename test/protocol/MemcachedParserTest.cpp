@@ -4,6 +4,7 @@
 #include <string>
 
 #include <afina/execute/Add.h>
+#include <afina/execute/CacheMemlimit.h>
 #include <afina/execute/Get.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Stats.h>
@@ -98,3 +99,24 @@ TEST(MemcachedParserTest, Stats) {
     Execute::Stats *tmp = reinterpret_cast<Execute::Stats *>(cmd.get());
     ASSERT_FALSE(tmp == nullptr);
 }
+
+TEST(MemcachedParserTest, CacheMemlimit) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("cache_memlimit 64 noreply\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(27, consumed);
+    ASSERT_EQ("cache_memlimit", parser.Name());
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(0, value_size);
+
+    Execute::CacheMemlimit *tmp = reinterpret_cast<Execute::CacheMemlimit *>(cmd.get());
+    ASSERT_EQ(64, tmp->megabytes());
+
+    parser.Reset();
+    ASSERT_THROW(parser.Parse("cache_memlimit -1\r\n", consumed), std::runtime_error);
+}
@@ -1,15 +1,24 @@
 #include "gtest/gtest.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <set>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include <afina/execute/Add.h>
 #include <afina/execute/AppendPrepend.h>
+#include <afina/execute/CacheMemlimit.h>
 #include <afina/execute/Delete.h>
 #include <afina/execute/Get.h>
 #include <afina/execute/Set.h>
+#include <storage/MapBasedFCImpl.h>
 #include <storage/MapBasedGlobalLockImpl.h>
+#include <storage/MapBasedShardedFCImpl.h>
+#include <storage/MapBasedSharedNothingImpl.h>
+#include <storage/MemoryPressureMonitor.h>
 
 using namespace Afina::Backend;
 using namespace Afina::Execute;
@@ -136,3 +145,305 @@ TEST(StorageTest, OverheadTest) {
     CheckRange(storage, OverheadSize, sum_size, sum_size, len);
     CheckRange(storage, 0, OverheadSize, sum_size, false, len);
 }
+
+TEST(StorageTest, HugePagesStatistics) {
+    // Kernel could have no huge pages at all, storage must fall back and still work
+    MapBasedGlobalLockImpl storage(std::numeric_limits<int>::max(), Afina::Core::HugePagesMode::Explicit2MB);
+
+    PutCount(storage, OverheadTestSize, 10);
+    CheckRange(storage, 0, OverheadTestSize, OverheadTestSize, 10);
+
+    std::map<std::string, std::string> stats;
+    storage.GetStatistics(stats);
+    EXPECT_EQ(std::to_string(OverheadTestSize), stats["curr_items"]);
+    EXPECT_EQ(std::to_string(OverheadTestSize * 10 * 2), stats["bytes"]);
+    EXPECT_NE(stats.end(), stats.find("hugepages_mode"));
+    EXPECT_LE(std::stoull(stats["hugepages_bytes"]), std::stoull(stats["slab_mapped_bytes"]));
+}
+
+// Single pass over kernel statistics counts the same as asking each region
+TEST(StorageTest, HugePageUsage) {
+    using Afina::Core::HugePageRegion;
+    using Afina::Core::HugePagesMode;
+
+    std::vector<HugePageRegion> regions;
+    for (int i = 0; i < 3; i++) {
+        regions.emplace_back(4 << 20, HugePagesMode::Transparent);
+        std::memset(regions.back().Get(), 1, regions.back().Size());
+    }
+    regions.emplace_back(2 << 20, HugePagesMode::Explicit2MB);
+    regions.emplace_back(2 << 20, HugePagesMode::None);
+
+    // Kernel may collapse pages meanwhile, so result is compared with counts before and after
+    auto separately = [&regions]() {
+        size_t result = 0;
+        for (auto &region : regions) {
+            result += region.HugeBytes();
+        }
+        return result;
+    };
+
+    Afina::Core::HugePageUsage usage;
+    for (auto &region : regions) {
+        usage.Add(region);
+    }
+
+    size_t before = separately();
+    size_t together = usage.Bytes();
+    size_t after = separately();
+    EXPECT_LE(std::min(before, after), together);
+    EXPECT_GE(std::max(before, after), together);
+}
+
+TEST(StorageTest, MemoryLimitShrinkInBackground) {
+    MapBasedGlobalLockImpl storage(OverheadTestSize * 10 * 2);
+    storage.Start();
+    PutCount(storage, OverheadTestSize, 10);
+
+    ASSERT_TRUE(storage.SetMemoryLimit(OverheadTestSize * 10));
+    EXPECT_EQ(OverheadTestSize * 10, storage.GetMemoryLimit());
+
+    for (int i = 0; i < 1000 && storage.GetMemoryUsage() > OverheadTestSize * 10; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(OverheadTestSize * 10, storage.GetMemoryUsage());
+    CheckRange(storage, 0, OverheadTestSize / 2, OverheadTestSize, 10, false);
+    CheckRange(storage, OverheadTestSize / 2, OverheadTestSize, OverheadTestSize, 10);
+
+    // Growing takes effect immediately
+    ASSERT_TRUE(storage.SetMemoryLimit(OverheadTestSize * 10 * 2));
+    PutCount(storage, OverheadTestSize, 10);
+    CheckRange(storage, 0, OverheadTestSize, OverheadTestSize, 10);
+    storage.Stop();
+}
+
+void WriteCgroupFile(const std::string &dir, const std::string &name, const std::string &content) {
+    std::ofstream file(dir + "/" + name);
+    file << content << std::endl;
+}
+
+void RemoveCgroupDir(const std::string &dir) {
+    for (auto name : {"memory.max", "memory.high", "memory.stat", "memory.current", "memory.pressure"}) {
+        unlink((dir + "/" + name).c_str());
+    }
+    rmdir(dir.c_str());
+}
+
+TEST(StorageTest, MemoryPressureMonitor) {
+    char dir_template[] = "/tmp/afina_cgroup_XXXXXX";
+    std::string dir = mkdtemp(dir_template);
+    const size_t mb = 1 << 20;
+    WriteCgroupFile(dir, "memory.max", std::to_string(100 * mb));
+    WriteCgroupFile(dir, "memory.high", "max");
+    WriteCgroupFile(dir, "memory.stat", "anon 0\ninactive_file " + std::to_string(10 * mb));
+
+    size_t max_size = 8 * mb;
+    auto storage = std::make_shared<MapBasedGlobalLockImpl>(max_size);
+    PutCount(*storage, 40000, 50); // 4MB
+    size_t stored = storage->GetMemoryUsage();
+
+    // Usage is below watermarks, but tasks are stalled: shrink by 10%
+    WriteCgroupFile(dir, "memory.current", std::to_string(85 * mb));
+    WriteCgroupFile(dir, "memory.pressure", "some avg10=50.00 avg60=10.00 avg300=1.00 total=100");
+    MemoryPressureMonitor monitor(storage, Afina::Core::CgroupMemory(dir));
+    monitor.Check();
+    EXPECT_EQ(stored - stored / 10, storage->GetMemoryLimit());
+    EXPECT_LE(storage->GetMemoryUsage(), storage->GetMemoryLimit());
+
+    // Pressure is gone, budget goes back after cooldown
+    WriteCgroupFile(dir, "memory.current", std::to_string(50 * mb));
+    WriteCgroupFile(dir, "memory.pressure", "some avg10=0.00 avg60=0.00 avg300=0.00 total=100");
+    for (int i = 0; i < 10; i++) {
+        monitor.Check();
+    }
+    EXPECT_EQ(max_size, storage->GetMemoryLimit());
+
+    RemoveCgroupDir(dir);
+}
+
+// Limit set by cache_memlimit is the one monitor brings budget back to, not the limit storage was started with
+TEST(StorageTest, MemoryPressureMonitorKeepsCacheMemlimit) {
+    char dir_template[] = "/tmp/afina_cgroup_XXXXXX";
+    std::string dir = mkdtemp(dir_template);
+    const size_t mb = 1 << 20;
+    WriteCgroupFile(dir, "memory.max", std::to_string(100 * mb));
+    WriteCgroupFile(dir, "memory.high", "max");
+    WriteCgroupFile(dir, "memory.stat", "anon 0\ninactive_file 0");
+    WriteCgroupFile(dir, "memory.current", std::to_string(50 * mb));
+    WriteCgroupFile(dir, "memory.pressure", "some avg10=0.00 avg60=0.00 avg300=0.00 total=100");
+
+    auto storage = std::make_shared<MapBasedGlobalLockImpl>(8 * mb);
+    PutCount(*storage, 40000, 50); // 4MB
+    MemoryPressureMonitor monitor(storage, Afina::Core::CgroupMemory(dir), std::chrono::milliseconds(1));
+    monitor.Start();
+
+    CacheMemlimit command;
+    std::string args = "2", out;
+    ASSERT_TRUE(command.ExtractArguments(args));
+    command.Execute(*storage, "", out);
+    EXPECT_EQ("OK", out);
+
+    // Memory is calm, so monitor would have grown budget back long before
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(2 * mb, storage->GetMaxMemoryLimit());
+    EXPECT_EQ(2 * mb, storage->GetMemoryLimit());
+    EXPECT_LE(storage->GetMemoryUsage(), 2 * mb);
+
+    std::map<std::string, std::string> stats;
+    storage->GetStatistics(stats);
+    EXPECT_EQ(std::to_string(2 * mb), stats["limit_maxbytes"]);
+
+    // Budget lowered under pressure grows back to the new limit only
+    WriteCgroupFile(dir, "memory.pressure", "some avg10=50.00 avg60=10.00 avg300=1.00 total=100");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_LT(storage->GetMemoryLimit(), 2 * mb);
+    WriteCgroupFile(dir, "memory.pressure", "some avg10=0.00 avg60=0.00 avg300=0.00 total=100");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(2 * mb, storage->GetMemoryLimit());
+
+    monitor.Stop();
+    RemoveCgroupDir(dir);
+}
+
+TEST(StorageTest, CacheMemlimitTooBig) {
+    MapBasedGlobalLockImpl storage(1 << 20);
+    CacheMemlimit command;
+    std::string args = std::to_string((SIZE_MAX >> 20) + 1), out;
+    ASSERT_TRUE(command.ExtractArguments(args));
+    command.Execute(storage, "", out);
+    EXPECT_EQ(0, out.find("CLIENT_ERROR"));
+    EXPECT_EQ(1 << 20, storage.GetMaxMemoryLimit());
+}
+
+// Results of operations come back from the combining thread through the slot
+TEST(StorageTest, FlatCombiningResults) {
+    MapBasedFCImpl storage;
+    std::string value;
+
+    EXPECT_TRUE(storage.Put("KEY1", "val1"));
+    EXPECT_FALSE(storage.PutIfAbsent("KEY1", "val2"));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("val1", value);
+    EXPECT_FALSE(storage.Set("KEY2", "val2"));
+    EXPECT_TRUE(storage.Set("KEY1", "val3"));
+    EXPECT_TRUE(storage.Get("KEY1", value));
+    EXPECT_EQ("val3", value);
+    EXPECT_TRUE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Delete("KEY1"));
+    EXPECT_FALSE(storage.Get("KEY1", value));
+}
+
+TEST(StorageTest, ShardedFlatCombining) {
+    const int threads_count = 8, keys = 2000;
+    MapBasedShardedFCImpl storage(std::numeric_limits<int>::max(), Afina::Core::MemoryPlacement(), 4);
+    ASSERT_EQ(4, storage.GetShardsCount());
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threads_count; t++) {
+        threads.emplace_back([&storage, t, keys]() {
+            for (int i = t; i < keys; i += threads_count) {
+                storage.Put("key" + std::to_string(i), "value" + std::to_string(i));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    std::string value;
+    for (int i = 0; i < keys; i++) {
+        ASSERT_TRUE(storage.Get("key" + std::to_string(i), value));
+        ASSERT_EQ("value" + std::to_string(i), value);
+    }
+    ASSERT_TRUE(storage.Delete("key0"));
+    ASSERT_FALSE(storage.Get("key0", value));
+
+    std::map<std::string, std::string> stats;
+    storage.GetStatistics(stats);
+    EXPECT_EQ(std::to_string(keys - 1), stats["curr_items"]);
+    EXPECT_EQ("4", stats["storage_shards"]);
+}
+
+TEST(StorageTest, MergeShardStatistics) {
+    std::map<std::string, std::string> stats;
+    for (int shard = 0; shard < 3; shard++) {
+        MergeShardStatistics(stats, {{"bytes", "100"}, {"curr_items", "2"}, {"numa_interleave", "1"},
+                                     {"hugepages_mode", "off"}});
+    }
+    EXPECT_EQ("300", stats["bytes"]);
+    EXPECT_EQ("6", stats["curr_items"]);
+    EXPECT_EQ("1", stats["numa_interleave"]);
+    EXPECT_EQ("off", stats["hugepages_mode"]);
+}
+
+TEST(StorageTest, ShardedMemoryLimit) {
+    MapBasedShardedFCImpl storage(OverheadTestSize * 10 * 2, Afina::Core::MemoryPlacement(), 4);
+    EXPECT_EQ(OverheadTestSize * 10 * 2, storage.GetMemoryLimit());
+    for (size_t i = 0; i < OverheadTestSize; i++) {
+        storage.Put(std::to_string(i), std::string(10, 'v'));
+    }
+    EXPECT_LE(storage.GetMemoryUsage(), storage.GetMemoryLimit());
+
+    // Each shard is shrunk to its part of the new limit
+    ASSERT_TRUE(storage.SetMemoryLimit(OverheadTestSize * 10 + 3));
+    EXPECT_EQ(OverheadTestSize * 10 + 3, storage.GetMemoryLimit());
+    EXPECT_LE(storage.GetMemoryUsage(), storage.GetMemoryLimit());
+    EXPECT_EQ(OverheadTestSize * 10 * 2, storage.GetMaxMemoryLimit());
+
+    // Configured limit is split the same way and moves budget along
+    ASSERT_TRUE(storage.SetMaxMemoryLimit(OverheadTestSize * 10 + 1));
+    EXPECT_EQ(OverheadTestSize * 10 + 1, storage.GetMaxMemoryLimit());
+    EXPECT_EQ(OverheadTestSize * 10 + 1, storage.GetMemoryLimit());
+}
+
+TEST(StorageTest, SharedNothing) {
+    const int threads_count = 8, keys = 2000;
+    MapBasedSharedNothingImpl storage(std::numeric_limits<int>::max(), Afina::Core::MemoryPlacement(), 3);
+    ASSERT_EQ(3, storage.GetShardsCount());
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threads_count; t++) {
+        threads.emplace_back([&storage, t, keys]() {
+            for (int i = t; i < keys; i += threads_count) {
+                storage.Put("key" + std::to_string(i), "value" + std::to_string(i));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    std::string value;
+    for (int i = 0; i < keys; i++) {
+        ASSERT_TRUE(storage.Get("key" + std::to_string(i), value));
+        ASSERT_EQ("value" + std::to_string(i), value);
+    }
+    ASSERT_FALSE(storage.PutIfAbsent("key1", "other"));
+    ASSERT_TRUE(storage.Delete("key0"));
+    ASSERT_FALSE(storage.Get("key0", value));
+
+    std::map<std::string, std::string> stats;
+    storage.GetStatistics(stats);
+    EXPECT_EQ(std::to_string(keys - 1), stats["curr_items"]);
+    EXPECT_EQ("3", stats["storage_shards"]);
+}
+
+TEST(StorageTest, SharedNothingMemoryLimit) {
+    MapBasedSharedNothingImpl storage(OverheadTestSize * 10 * 2, Afina::Core::MemoryPlacement(), 3);
+    for (size_t i = 0; i < OverheadTestSize; i++) {
+        storage.Put(std::to_string(i), std::string(10, 'v'));
+    }
+    EXPECT_LE(storage.GetMemoryUsage(), storage.GetMemoryLimit());
+
+    // Owners evict in background
+    ASSERT_TRUE(storage.SetMemoryLimit(OverheadTestSize * 10));
+    EXPECT_EQ(OverheadTestSize * 10, storage.GetMemoryLimit());
+    for (int i = 0; i < 1000 && storage.GetMemoryUsage() > OverheadTestSize * 10; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_LE(storage.GetMemoryUsage(), OverheadTestSize * 10);
+
+    ASSERT_TRUE(storage.SetMaxMemoryLimit(OverheadTestSize * 5));
+    EXPECT_EQ(OverheadTestSize * 5, storage.GetMaxMemoryLimit());
+    EXPECT_EQ(OverheadTestSize * 5, storage.GetMemoryLimit());
+}